@@ -0,0 +1,261 @@
+"""
+Golden-output check of the C++ post-processing of the target application
+(target_app/yolact) against Detect of layers/functions/detection.py with is_quant=True.
+
+Both implementations are fed the same output tensors, recorded on the board with
+    ./yolact.exe --image_dir data/images --no_display --dump_tensors tensors
+The C++ side runs on the host through detect_tensors.exe (built by target_app/yolact/build.sh
+without Vitis AI), the Python side on the CPU, so no DPU or GPU is needed:
+    python golden_detect.py --tensors tensors --cpp_exe target_app/yolact/detect_tensors.exe
+
+Detections are matched by class & box, then the scores, boxes, mask coefficients and the
+masks drawn by the C++ code (label mask at --image size) are compared with tolerances.
+Mismatching frames are reported & the exit code is 1 if any frame mismatches.
+"""
+
+import argparse
+import glob
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+import numpy as np
+import torch
+
+from data import cfg, set_cfg
+from layers import Detect
+from layers.output_utils import postprocess
+
+
+def parse_args(argv=None):
+    parser = argparse.ArgumentParser(description='Compares the C++ post-processing with layers/functions/detection.py')
+    parser.add_argument('--tensors', required=True, type=str,
+                        help='Output tensors recorded with yolact.exe --dump_tensors.')
+    parser.add_argument('--cpp_exe', default='target_app/yolact/detect_tensors.exe', type=str,
+                        help='detect_tensors.exe that runs the C++ post-processing on the tensors.')
+    parser.add_argument('--cpp_results', default=None, type=str,
+                        help='Results of an earlier detect_tensors.exe run, instead of running --cpp_exe.')
+    parser.add_argument('--config', default='yolact_resnet50_config', type=str,
+                        help='The config of the quantized model.')
+    parser.add_argument('--max_frames', default=0, type=int,
+                        help='Only compares the first N frames (0 = all).')
+    parser.add_argument('--image', default='550x550', type=str,
+                        help='Size of the masks that are compared (WxH).')
+    parser.add_argument('--nms_conf_thresh', default=0.05, type=float,
+                        help='Confidence threshold of the candidates, the C++ NMS_CONF_THRESH.')
+    parser.add_argument('--nms_thresh', default=0.5, type=float,
+                        help='IoU threshold of the NMS, the C++ NMS_THRESH.')
+    parser.add_argument('--keep_top_k', default=5, type=int,
+                        help='Detections kept per frame, the C++ KEEP_TOP_K.')
+    parser.add_argument('--score_thresh', default=0.5, type=float,
+                        help='Only the masks of detections scoring at least this are drawn & compared.')
+    parser.add_argument('--score_tol', default=1e-5, type=float,
+                        help='Largest absolute score difference.')
+    parser.add_argument('--box_tol', default=1e-4, type=float,
+                        help='Largest absolute difference of a normalized box coordinate.')
+    parser.add_argument('--coef_tol', default=1e-5, type=float,
+                        help='Largest absolute difference of a mask coefficient.')
+    parser.add_argument('--mask_iou', default=0.9, type=float,
+                        help='Smallest IoU of the C++ & Python masks of a detection.')
+    parser.add_argument('--report', default=None, type=str,
+                        help='Saves the comparison of every frame as JSON.')
+    parser.add_argument('--verbose', action='store_true',
+                        help='Prints every mismatch instead of the first one per frame.')
+
+    return parser.parse_args(argv)
+
+
+def make_priors():
+    """ Same prior boxes as eval.py (which needs CUDA to import) & create_priors of yolact.hpp. """
+
+    fmap_dims     = [69, 35, 18, 9, 5]
+    scales        = [24, 48, 96, 192, 384]
+    aspect_ratios = [1, 0.5, 2]
+
+    prior_boxes = []
+
+    for fmap, scale in zip(fmap_dims, scales):
+        for j in range(fmap):
+            for i in range(fmap):
+                x = (i + 0.5) / fmap
+                y = (j + 0.5) / fmap
+
+                for ar in aspect_ratios:
+                    if not cfg.backbone.preapply_sqrt:
+                        ar = np.sqrt(ar)
+
+                    w = scale * ar / cfg.max_size
+                    h = w if cfg.backbone.use_square_anchors else scale / ar / cfg.max_size
+                    prior_boxes += [x, y, w, h]
+
+    return torch.Tensor(prior_boxes).view(-1, 4)
+
+
+def python_detect(detect, priors, base, w, h, keep_top_k):
+    """
+    Runs Detect & postprocess on the recorded tensors of a frame.
+    Returns the labels (1-based like the C++ code), scores, normalized boxes (point form,
+    clamped like decode_bbox), mask coefficients and binarized [n, h, w] masks.
+    """
+    preds = [torch.from_numpy(np.load(base + suffix)) for suffix in ('_loc.npy', '_conf.npy', '_mask.npy', '_proto.npy')]
+
+    with torch.no_grad():
+        out = detect(preds, priors, is_quant=True)
+        dets = out[0]['detection']
+
+        if dets is None:
+            return np.zeros(0), np.zeros(0), np.zeros((0, 4)), np.zeros((0, preds[2].shape[2])), np.zeros((0, h, w), bool)
+
+        # postprocess sanitizes the boxes in place
+        labels = dets['class'].numpy() + 1
+        scores = dets['score'].numpy().copy()
+        boxes  = dets['box'].clamp(0, 1).numpy().copy()
+        coefs  = dets['mask'].numpy().copy()
+
+        _, _, _, masks = postprocess(out, w, h, crop_masks=True, score_threshold=0)
+        masks = masks.numpy() > 0.5
+
+    n = min(len(scores), keep_top_k)
+    return labels[:n], scores[:n], boxes[:n], coefs[:n], masks[:n]
+
+
+def compare_frame(cpp, py, args):
+    """
+    Matches the C++ detections to the Python ones with the same label & the closest box,
+    returns the list of mismatch messages & the largest errors.
+    """
+    cpp_det, cpp_coef, cpp_labels = cpp
+    py_labels, py_scores, py_boxes, py_coefs, py_masks = py
+
+    errors = []
+    worst = {'score': 0.0, 'box': 0.0, 'coef': 0.0, 'mask_iou': 1.0}
+    unmatched = list(range(len(py_scores)))
+    py_label_mask = np.zeros(cpp_labels.shape, np.int32)
+    pairs = []
+
+    for i, det in enumerate(cpp_det):
+        label, score, box = int(det[0]), float(det[1]), det[2:6]
+
+        candidates = [j for j in unmatched if py_labels[j] == label]
+        if not candidates:
+            errors.append('C++ detection %d (class %d, score %.4f) has no Python match' % (i, label, score))
+            continue
+
+        j = min(candidates, key=lambda k: np.abs(py_boxes[k] - box).max())
+        box_err = float(np.abs(py_boxes[j] - box).max())
+        if box_err > args.box_tol:
+            errors.append('C++ detection %d (class %d, score %.4f) has no Python match, closest box differs by %.5f'
+                          % (i, label, score, box_err))
+            continue
+
+        unmatched.remove(j)
+        pairs.append((i, j))
+
+        score_err = abs(float(py_scores[j]) - score)
+        coef_err = float(np.abs(py_coefs[j] - cpp_coef[i]).max()) if cpp_coef.shape[1] > 0 else 0.0
+        worst['score'] = max(worst['score'], score_err)
+        worst['box'] = max(worst['box'], box_err)
+        worst['coef'] = max(worst['coef'], coef_err)
+
+        if score_err > args.score_tol:
+            errors.append('detection %d: score %.6f vs %.6f' % (i, score, py_scores[j]))
+        if coef_err > args.coef_tol:
+            errors.append('detection %d: mask coefficients differ by %.6f' % (i, coef_err))
+
+        # Later detections are drawn over earlier ones, like draw_masks
+        if score >= args.score_thresh:
+            py_label_mask[py_masks[j]] = i + 1
+
+    for j in unmatched:
+        errors.append('Python detection (class %d, score %.4f) is missing in the C++ results' % (py_labels[j], py_scores[j]))
+
+    for i, j in pairs:
+        if cpp_det[i][1] < args.score_thresh:
+            continue
+
+        a = cpp_labels == i + 1
+        b = py_label_mask == i + 1
+        union = np.logical_or(a, b).sum()
+        iou = 1.0 if union == 0 else float(np.logical_and(a, b).sum()) / float(union)
+        worst['mask_iou'] = min(worst['mask_iou'], iou)
+
+        if iou < args.mask_iou:
+            errors.append('detection %d: mask IoU %.3f' % (i, iou))
+
+    return errors, worst
+
+
+def main(args):
+    set_cfg(args.config)
+    w, h = [int(x) for x in args.image.split('x')]
+
+    bases = sorted(path[:-len('_loc.npy')] for path in glob.glob(os.path.join(args.tensors, '*_loc.npy')))
+    if args.max_frames > 0:
+        bases = bases[:args.max_frames]
+    if not bases:
+        print('ERROR: no *_loc.npy recordings in %s' % args.tensors)
+        return 1
+
+    # Runs the C++ post-processing with the same settings
+    tmp_dir = None
+    cpp_dir = args.cpp_results
+    if cpp_dir is None:
+        tmp_dir = tempfile.TemporaryDirectory()
+        cpp_dir = tmp_dir.name
+        cmd = [args.cpp_exe, '--tensors', args.tensors, '--output', cpp_dir, '--image', args.image,
+               '--score_thresh', str(args.score_thresh), '--nms_conf_thresh', str(args.nms_conf_thresh),
+               '--nms_thresh', str(args.nms_thresh), '--max_frames', str(args.max_frames)]
+        if subprocess.run(cmd).returncode != 0:
+            print('ERROR: %s failed' % ' '.join(cmd))
+            return 1
+
+    detect = Detect(cfg.num_classes, bkg_label=0, top_k=cfg.nms_top_k,
+                    conf_thresh=args.nms_conf_thresh, nms_thresh=args.nms_thresh)
+    priors = make_priors()
+
+    report = []
+    failed = 0
+    num_det = 0
+    worst = {'score': 0.0, 'box': 0.0, 'coef': 0.0, 'mask_iou': 1.0}
+
+    for base in bases:
+        name = os.path.basename(base)
+        cpp_base = os.path.join(cpp_dir, name)
+        cpp = (np.load(cpp_base + '_cpp_det.npy'), np.load(cpp_base + '_cpp_coef.npy'),
+               np.load(cpp_base + '_cpp_labels.npy').astype(np.int32))
+        py = python_detect(detect, priors, base, w, h, args.keep_top_k)
+
+        errors, frame_worst = compare_frame(cpp, py, args)
+        num_det += len(cpp[0])
+        for key in ('score', 'box', 'coef'):
+            worst[key] = max(worst[key], frame_worst[key])
+        worst['mask_iou'] = min(worst['mask_iou'], frame_worst['mask_iou'])
+
+        if errors:
+            failed += 1
+            for error in (errors if args.verbose else errors[:1]):
+                print('%s: %s' % (name, error))
+            if not args.verbose and len(errors) > 1:
+                print('%s: ... %d more mismatches' % (name, len(errors) - 1))
+
+        report.append({'frame': name, 'cpp_detections': len(cpp[0]), 'python_detections': len(py[1]),
+                       'errors': errors, 'worst': frame_worst})
+
+    print('Compared %d frames, %d C++ detections: %d frames mismatch' % (len(bases), num_det, failed))
+    print('Largest differences: score %.2e, box %.2e, mask coefficient %.2e, smallest mask IoU %.3f'
+          % (worst['score'], worst['box'], worst['coef'], worst['mask_iou']))
+
+    if args.report is not None:
+        with open(args.report, 'w') as f:
+            json.dump({'frames': len(bases), 'failed': failed, 'worst': worst, 'results': report}, f, indent=2)
+
+    if tmp_dir is not None:
+        tmp_dir.cleanup()
+
+    return 1 if failed > 0 else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(parse_args()))
@@ -0,0 +1,237 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Per-request overhead of the inference daemon against a cold process start.
+ *
+ * Runs the same image through:
+ *   - warm:    requests on one connection to a running yolact.exe --daemon
+ *   - connect: a new connection per request, like a script calling the client
+ *   - cold:    a new yolact.exe process per image, which loads the xmodel &
+ *              creates the runners every time
+ * and reports the round-trip times and the share of a daemon request that is
+ * spent outside inference (socket & protocol overhead).
+ *
+ * Only depends on the C++ standard library & POSIX, build with build.sh or:
+ *   g++ -std=c++17 -O3 -I../src daemon_bench.cpp -o daemon_bench.exe
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "daemon_protocol.hpp"
+
+using namespace std;
+
+extern char **environ;
+
+static uint64_t now_ns()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static void print_times( const char *name, vector<uint64_t> &samples )
+{
+  if (samples.empty()) return;
+
+  sort(samples.begin(), samples.end());
+  size_t n = samples.size();
+  double sum = 0.0;
+  for (auto s : samples) sum += s;
+
+  printf("  %-10s %6zu runs   avg %10.2f ms   p50 %10.2f ms   p99 %10.2f ms\n", name, n,
+         sum / n * 1e-6, samples[n * 50 / 100] * 1e-6, samples[n * 99 / 100] * 1e-6);
+}
+
+/* Sends one request, returns false on failure */
+static bool request( int sock, const string &image, uint64_t &server_ns )
+{
+  daemon_request_t req;
+  daemon_response_t resp;
+  string payload;
+
+  memset(&req, 0, sizeof(req));
+  req.type = REQ_IMAGE_PATH;
+  req.format = RESULT_BINARY;
+  req.score_thresh = 0.5f;
+
+  if (!daemon_send_request(sock, req, image) || !daemon_recv_response(sock, resp, payload)) return false;
+
+  server_ns = resp.server_ns;
+  return resp.status == STATUS_OK;
+}
+
+/* Runs a command with its output discarded, returns false if it failed */
+static bool run_process( vector<string> &args )
+{
+  vector<char *> argv;
+  for (auto &arg : args) argv.push_back(&arg[0]);
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+  pid_t pid;
+  int status = -1;
+  bool spawned = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ) == 0;
+  posix_spawn_file_actions_destroy(&actions);
+
+  if (!spawned || waitpid(pid, &status, 0) < 0) return false;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main( int argc, char *argv[] )
+{
+  string socket_path = DAEMON_DEFAULT_SOCKET;
+  string exe = "./yolact.exe";
+  string image;
+  int iterations = 200;
+  int cold_runs = 5;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--socket") && i+1 < argc)
+    {
+      socket_path = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--image") && i+1 < argc)
+    {
+      char path[PATH_MAX];
+      if (realpath(argv[++i], path) == nullptr)
+      {
+        printf("ERROR: input file %s does not exist\n", argv[i]);
+        return -1;
+      }
+      image = path;
+    }
+    else if (!strcmp(argv[i], "--iter") && i+1 < argc)
+    {
+      iterations = std::max(atoi(argv[++i]), 1);
+    }
+    else if (!strcmp(argv[i], "--cold") && i+1 < argc)
+    {
+      cold_runs = std::max(atoi(argv[++i]), 0);
+    }
+    else if (!strcmp(argv[i], "--exe") && i+1 < argc)
+    {
+      exe = argv[++i];
+    }
+    else
+    {
+      image.clear();
+      break;
+    }
+  }
+
+  if (image.empty())
+  {
+    printf("Usage: ./daemon_bench.exe --image <image-file> [--socket <path>] [--iter N] [--cold N] [--exe <yolact.exe>]\n");
+    printf("       Start the daemon first: ./yolact.exe --daemon %s\n", DAEMON_DEFAULT_SOCKET);
+    return -1;
+  }
+
+  vector<uint64_t> warm, service, connect_each, cold;
+
+  /* One persistent connection */
+  int sock = daemon_connect(socket_path);
+  if (sock < 0)
+  {
+    printf("ERROR: no daemon is serving %s\n", socket_path.c_str());
+    return -1;
+  }
+
+  uint64_t server_ns;
+  request(sock, image, server_ns);   // warm-up
+  for (int i = 0; i < iterations; i++)
+  {
+    uint64_t t0 = now_ns();
+    if (!request(sock, image, server_ns))
+    {
+      printf("ERROR: request failed\n");
+      return -1;
+    }
+    warm.push_back(now_ns() - t0);
+    service.push_back(server_ns);
+  }
+  close(sock);
+
+  /* A connection per request */
+  for (int i = 0; i < iterations; i++)
+  {
+    uint64_t t0 = now_ns();
+    sock = daemon_connect(socket_path);
+    bool valid = (sock >= 0) && request(sock, image, server_ns);
+    if (sock >= 0) close(sock);
+    if (!valid)
+    {
+      printf("ERROR: request failed\n");
+      return -1;
+    }
+    connect_each.push_back(now_ns() - t0);
+  }
+
+  /* A new process per image */
+  for (int i = 0; i < cold_runs; i++)
+  {
+    vector<string> args = { exe, "--image", image, "--no_display" };
+    uint64_t t0 = now_ns();
+    if (!run_process(args))
+    {
+      printf("ERROR: %s failed, set the executable with --exe\n", exe.c_str());
+      return -1;
+    }
+    cold.push_back(now_ns() - t0);
+  }
+
+  printf("Round trip per image (%s):\n", image.c_str());
+  print_times("warm", warm);
+  print_times("connect", connect_each);
+  print_times("cold", cold);
+  print_times("service", service);
+
+  /* Overhead = round trip - time spent inside the daemon */
+  double warm_sum = 0.0, service_sum = 0.0;
+  for (size_t i = 0; i < warm.size(); i++)
+  {
+    warm_sum += warm[i];
+    service_sum += service[i];
+  }
+  printf("Socket & protocol overhead per warm request: %.3f ms\n", (warm_sum - service_sum) / warm.size() * 1e-6);
+
+  if (!cold.empty())
+  {
+    double cold_sum = 0.0;
+    for (auto c : cold) cold_sum += c;
+    printf("Cold start / warm request: %.1fx\n", (cold_sum / cold.size()) / (warm_sum / warm.size()));
+  }
+
+  return 0;
+}
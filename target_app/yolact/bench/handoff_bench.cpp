@@ -0,0 +1,157 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Microbenchmark of the inter-stage hand-off cost of the pipeline queues.
+ *
+ * Compares the mutex/condition-variable bounded_queue against the lock-free
+ * spsc_ring:
+ *   - ping-pong: one item bounces between two threads, half of the round
+ *     trip is the hand-off latency seen by an idle stage
+ *   - stream:    the producer pushes back-to-back, measuring the sustained
+ *     cost per hand-off
+ *
+ * Only depends on the C++ standard library, build with build.sh or:
+ *   g++ -std=c++17 -O3 -I../src handoff_bench.cpp -o handoff_bench.exe -lpthread
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+#include "spsc_ring.hpp"
+
+using namespace std;
+
+static uint64_t now_ns()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static void print_latency( const char *name, vector<uint64_t> &samples )
+{
+  sort(samples.begin(), samples.end());
+  size_t n = samples.size();
+  printf("  %-14s p50 %8.0f ns   p90 %8.0f ns   p99 %8.0f ns   max %8.0f ns\n", name,
+         samples[n * 50 / 100] / 2.0, samples[n * 90 / 100] / 2.0,
+         samples[n * 99 / 100] / 2.0, samples[n - 1] / 2.0);
+}
+
+/* Round trips through a pair of queues, returns the round-trip times */
+static vector<uint64_t> ping_pong( blocking_queue<void*> &ping, blocking_queue<void*> &pong, int iterations )
+{
+  vector<uint64_t> samples(iterations);
+
+  thread echo([&]
+  {
+    void *item;
+    while (ping.pop(item))
+    {
+      pong.push(item);
+    }
+  });
+
+  void *item = &samples;
+  for (int i = 0; i < iterations; i++)
+  {
+    uint64_t t0 = now_ns();
+    ping.push(item);
+    pong.pop(item);
+    samples[i] = now_ns() - t0;
+  }
+
+  ping.close();
+  echo.join();
+  return samples;
+}
+
+/* Streams items from one thread to another, returns ns per hand-off */
+static double stream( blocking_queue<void*> &queue, int iterations )
+{
+  thread consumer([&]
+  {
+    void *item;
+    while (queue.pop(item))
+    {
+    }
+  });
+
+  uint64_t t0 = now_ns();
+  for (int i = 0; i < iterations; i++)
+  {
+    queue.push((void *)(uintptr_t)(i + 1));
+  }
+  queue.close();
+  consumer.join();
+
+  return (double)(now_ns() - t0) / (double)iterations;
+}
+
+int main( int argc, char *argv[] )
+{
+  int iterations = 100000;
+  int capacity = 4;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--iter") && i+1 < argc)
+    {
+      iterations = atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--capacity") && i+1 < argc)
+    {
+      capacity = atoi(argv[++i]);
+    }
+    else
+    {
+      printf("Usage: ./handoff_bench.exe [--iter N] [--capacity N]\n");
+      return -1;
+    }
+  }
+
+  printf("Hand-off latency (ping-pong, one way), %d iterations:\n", iterations);
+  {
+    bounded_queue<void*> ping(capacity), pong(capacity);
+    auto samples = ping_pong(ping, pong, iterations);
+    print_latency("mutex queue", samples);
+  }
+  {
+    spsc_ring<void*> ping(capacity), pong(capacity);
+    auto samples = ping_pong(ping, pong, iterations);
+    print_latency("spsc ring", samples);
+  }
+
+  printf("Streaming hand-off cost, capacity %d:\n", capacity);
+  {
+    bounded_queue<void*> queue(capacity);
+    printf("  %-14s %8.1f ns/item\n", "mutex queue", stream(queue, iterations));
+  }
+  {
+    spsc_ring<void*> queue(capacity);
+    printf("  %-14s %8.1f ns/item\n", "spsc ring", stream(queue, iterations));
+  }
+
+  return 0;
+}
@@ -0,0 +1,585 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Microbenchmark of the CPU kernels of the YOLACT processing.
+ *
+ * Times each kernel in isolation on synthetic output tensors with a
+ * controlled number of objects per frame, and optionally on output tensors
+ * recorded on the board with yolact.exe --dump_tensors:
+ *   - set_input_image:  quantization of a frame into the input tensor
+ *   - scan:             get_multi_class_max_score_index (candidates per class)
+ *   - decode_bbox:      decoding of one candidate box (ns per box)
+ *   - nms:              apply_one_class_nms over all classes
+ *   - detect:           the complete post-processing of a frame
+ *   - draw_masks:       mask assembly & blending of the detections
+ *   - draw_boxes:       boxes & labels of the detections
+ *
+ * Every kernel & input is measured in --reps repetitions of at least
+ * --min_time_ms each; the median, min, mean & standard deviation of the
+ * time per operation are reported along with the throughput.  --json saves
+ * the results (one per line) and --baseline compares against a saved run.
+ *
+ * The masks & boxes are drawn on noise images of --image size, recordings
+ * only hold the output tensors.
+ *
+ * Builds with yolact.hpp's YOLACT_NO_VITIS, so it only needs OpenCV (no
+ * Vitis AI libraries or DPU), build with build.sh or:
+ *   g++ -std=c++17 -O3 -DYOLACT_NO_VITIS -I../src kernel_bench.cpp -o kernel_bench.exe \
+ *       -lopencv_core -lopencv_imgproc -lpthread
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "yolact.hpp"
+#include "tensor_recording.hpp"
+
+using namespace std;
+
+static uint64_t now_ns()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+/* Calls the private kernels of the model (friend of yolact) */
+class kernel_bench
+{
+  public:
+
+    kernel_bench( yolact &model ) : model(model) {}
+
+    void set_input_image( const cv::Mat &image, vector<int8_t> &input )
+    {
+      model.set_input_image(image, (void*)input.data(), model.input_fixed_scale);
+    }
+
+    void scan( const frame_t &frame, vector<vector<pair<float, int>>> &score_index_vec )
+    {
+      score_index_vec.assign(NUM_CLASSES, vector<pair<float, int>>());
+      model.get_multi_class_max_score_index(frame.conf.data(), 1, NUM_CLASSES-1, score_index_vec);
+    }
+
+    void decode_bbox( frame_t &frame, int idx, map<int, vector<float>> &decoded_bboxes )
+    {
+      model.decode_bbox(&frame.loc[idx*4], idx, decoded_bboxes);
+    }
+
+    /* Returns the number of boxes kept */
+    int nms( frame_t &frame, vector<vector<pair<float, int>>> &score_index_vec )
+    {
+      map<int, vector<float>> decoded_bboxes, masks;
+      vector<int> indices;
+      int kept = 0;
+
+      for (int c = 1; c < NUM_CLASSES; c++)
+      {
+        model.apply_one_class_nms(frame.loc.data(), frame.mask.data(), c, score_index_vec[c], &indices,
+                                  decoded_bboxes, masks);
+        kept += indices.size();
+      }
+      return kept;
+    }
+
+    void draw_masks( cv::Mat &image, frame_t &frame, float score_thresh )
+    {
+      model.draw_masks(image, frame.boxes, frame.masks, 0, frame.boxes.size(), frame.proto.data(), score_thresh);
+    }
+
+    void draw_boxes( cv::Mat &image, frame_t &frame, float score_thresh )
+    {
+      model.draw_boxes(image, frame.boxes, 0, frame.boxes.size(), score_thresh);
+    }
+
+    /* Prior boxes of the model (center x, center y, size) */
+    vector<box_t> priors()
+    {
+      return vector<box_t>(model.prior_data, model.prior_data + NUM_PRIORS);
+    }
+
+  private:
+
+    yolact &model;
+};
+
+/* Output tensors of a set of frames */
+typedef struct
+{
+  string          name;        // synthetic:<objects> or the recording directory
+  vector<frame_t> frames;
+  double          candidates;  // Average scores above the NMS confidence threshold per frame
+} input_set_t;
+
+/* Fills an image with uniform noise */
+static void fill_noise( cv::Mat &image, mt19937 &rng )
+{
+  for (size_t i = 0; i < image.total() * image.elemSize(); i++)
+  {
+    image.data[i] = (uchar)(rng() & 0xff);
+  }
+}
+
+/*
+ * Synthetic output tensors: background dominates every prior, a share of the priors gets a
+ * low-confidence clutter score and each object is detected by the priors whose center lies in it &
+ * whose size is close to it, with box offsets pointing at the object so NMS has overlaps to suppress.
+ */
+static void make_synthetic_frame( frame_t &frame, int objects, float clutter, const vector<box_t> &priors,
+                                  mt19937 &rng )
+{
+  uniform_real_distribution<float> unit(0.0f, 1.0f);
+  normal_distribution<float> gauss(0.0f, 1.0f);
+
+  frame.loc.assign(NUM_PRIORS * 4, 0.0f);
+  frame.conf.assign(NUM_PRIORS * NUM_CLASSES, 0.0f);
+  frame.mask.resize(NUM_PRIORS * PROTO_C);
+  frame.proto.resize(PROTO_SIZE);
+
+  for (int p = 0; p < NUM_PRIORS; p++)
+  {
+    float *conf = &frame.conf[p * NUM_CLASSES];
+    for (int c = 1; c < NUM_CLASSES; c++)
+    {
+      conf[c] = unit(rng) * 0.002f;
+    }
+    if (unit(rng) < clutter)
+    {
+      conf[1 + rng() % (NUM_CLASSES - 1)] = NMS_CONF_THRESH + unit(rng) * 0.15f;
+    }
+    for (int i = 0; i < 4; i++)
+    {
+      frame.loc[p * 4 + i] = gauss(rng) * 0.5f;
+    }
+  }
+
+  for (int o = 0; o < objects; o++)
+  {
+    int label = 1 + rng() % (NUM_CLASSES - 1);
+    float size = 0.08f + unit(rng) * 0.4f;
+    float cx = size / 2 + unit(rng) * (1.0f - size);
+    float cy = size / 2 + unit(rng) * (1.0f - size);
+
+    for (int p = 0; p < NUM_PRIORS; p++)
+    {
+      const box_t &prior = priors[p];
+      if (fabsf(prior.x - cx) > size / 2 || fabsf(prior.y - cy) > size / 2) continue;
+      if (prior.w < size * 0.5f || prior.w > size * 2.0f) continue;
+
+      frame.conf[p * NUM_CLASSES + label] = std::max(frame.conf[p * NUM_CLASSES + label], 0.3f + unit(rng) * 0.65f);
+
+      /* Inverse of decode_bbox with a little jitter */
+      frame.loc[p * 4 + 0] = (cx - prior.x) / (0.1f * prior.w) + gauss(rng) * 0.2f;
+      frame.loc[p * 4 + 1] = (cy - prior.y) / (0.1f * prior.h) + gauss(rng) * 0.2f;
+      frame.loc[p * 4 + 2] = logf(size / prior.w) / 0.2f + gauss(rng) * 0.1f;
+      frame.loc[p * 4 + 3] = logf(size / prior.h) / 0.2f + gauss(rng) * 0.1f;
+    }
+  }
+
+  /* The softmax puts the remaining probability on the background */
+  for (int p = 0; p < NUM_PRIORS; p++)
+  {
+    float *conf = &frame.conf[p * NUM_CLASSES];
+    float sum = 0.0f;
+    for (int c = 1; c < NUM_CLASSES; c++) sum += conf[c];
+    conf[0] = std::max(1.0f - sum, 0.0f);
+  }
+
+  for (auto &m : frame.mask) m = gauss(rng) * 0.5f;
+  for (auto &m : frame.proto) m = gauss(rng);
+}
+
+/* Loads the frames recorded with --dump_tensors from a directory */
+static bool load_recorded( const string &dir, int max_frames, input_set_t &set )
+{
+  vector<string> bases;
+  string error;
+  if (!list_frame_tensors(dir, bases, error))
+  {
+    printf("ERROR: %s\n", error.c_str());
+    return false;
+  }
+  if (max_frames > 0 && (int)bases.size() > max_frames) bases.resize(max_frames);
+
+  set.name = dir;
+  set.frames.resize(bases.size());
+  for (size_t f = 0; f < bases.size(); f++)
+  {
+    if (!load_frame_tensors(bases[f], set.frames[f], error))
+    {
+      printf("ERROR: %s\n", error.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Time per operation of the repetitions of a kernel & input */
+typedef struct
+{
+  string kernel;
+  string input;
+  double items;       // Items per operation (pixels, scores, boxes, detections)
+  const char *unit;
+  uint64_t ops;
+  double median_ns, min_ns, mean_ns, stddev_ns;
+} result_t;
+
+/*
+ * Runs op(i) for i = 0, 1, ... until min_ns has passed, reps times after a warm-up repetition.
+ * op returns the number of operations it performed (0 = nothing to measure).
+ */
+static bool measure( const function<int(uint64_t)> &op, int reps, uint64_t min_ns, result_t &result )
+{
+  vector<double> samples;
+  result.ops = 0;
+
+  for (int r = -1; r < reps; r++)
+  {
+    uint64_t ops = 0, calls = 0;
+    uint64_t t0 = now_ns(), t1 = t0;
+    while (t1 - t0 < min_ns)
+    {
+      ops += op(calls++);
+      t1 = now_ns();
+      if (ops == 0) return false;
+    }
+    if (r < 0) continue;
+
+    samples.push_back((double)(t1 - t0) / (double)ops);
+    result.ops += ops;
+  }
+
+  sort(samples.begin(), samples.end());
+  double sum = 0.0, sum_sq = 0.0;
+  for (double s : samples)
+  {
+    sum += s;
+    sum_sq += s * s;
+  }
+  size_t n = samples.size();
+  result.median_ns = (n % 2) ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+  result.min_ns = samples.front();
+  result.mean_ns = sum / n;
+  result.stddev_ns = sqrt(std::max(sum_sq / n - result.mean_ns * result.mean_ns, 0.0));
+  return true;
+}
+
+/* Median ns/op per "kernel input" of a saved --json file */
+static map<string, double> load_baseline( const string &path )
+{
+  map<string, double> baseline;
+  ifstream in(path);
+  string line;
+
+  while (getline(in, line))
+  {
+    char kernel[64], input[512];
+    double median;
+    size_t pos = line.find("\"kernel\"");
+    if (pos == string::npos) continue;
+    if (sscanf(line.c_str() + pos, "\"kernel\": \"%63[^\"]\", \"input\": \"%511[^\"]\"", kernel, input) != 2) continue;
+    pos = line.find("\"median_ns\"");
+    if (pos == string::npos || sscanf(line.c_str() + pos, "\"median_ns\": %lf", &median) != 1) continue;
+    baseline[string(kernel) + " " + input] = median;
+  }
+  return baseline;
+}
+
+static void print_usage()
+{
+  printf("Usage: ./kernel_bench.exe [options]\n");
+  printf("  --objects N,N,...   Objects per synthetic frame, one input set per count (default = 0,1,5,20)\n");
+  printf("  --clutter F         Share of the priors with a low-confidence score (default = 0.01)\n");
+  printf("  --frames N          Synthetic frames per input set (default = 4)\n");
+  printf("  --tensors <dir>     Also runs on the tensors recorded with yolact.exe --dump_tensors <dir>\n");
+  printf("  --max_frames N      Recorded frames loaded from --tensors (default = 32)\n");
+  printf("  --kernels k,k,...   Kernels to run (default = all)\n");
+  printf("  --reps N            Measured repetitions per kernel & input (default = 10)\n");
+  printf("  --min_time_ms N     Minimum duration of a repetition (default = 50)\n");
+  printf("  --image WxH         Size of the image drawn on (default = 640x480)\n");
+  printf("  --json <file>       Saves the results as JSON\n");
+  printf("  --baseline <file>   Compares the medians against a saved --json file\n");
+}
+
+int main( int argc, char *argv[] )
+{
+  vector<int> object_counts = { 0, 1, 5, 20 };
+  float clutter = 0.01f;
+  int num_frames = 4;
+  string tensor_dir;
+  int max_frames = 32;
+  set<string> kernels;
+  int reps = 10;
+  float min_time_ms = 50.0f;
+  cv::Size image_size(640, 480);
+  string json_file, baseline_file;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    const char *value = (i+1 < argc) ? argv[i+1] : nullptr;
+    if (value == nullptr)
+    {
+      print_usage();
+      return -1;
+    }
+    i++;
+
+    if (!strcmp(arg, "--objects") || !strcmp(arg, "--kernels"))
+    {
+      string list = value;
+      if (!strcmp(arg, "--objects")) object_counts.clear();
+      size_t pos = 0;
+      while (pos <= list.size())
+      {
+        size_t end = std::min(list.find(',', pos), list.size());
+        string item = list.substr(pos, end - pos);
+        if (!item.empty())
+        {
+          if (!strcmp(arg, "--objects")) object_counts.push_back(std::max(atoi(item.c_str()), 0));
+          else kernels.insert(item);
+        }
+        pos = end + 1;
+      }
+    }
+    else if (!strcmp(arg, "--clutter"))     clutter = atof(value);
+    else if (!strcmp(arg, "--frames"))      num_frames = std::max(atoi(value), 1);
+    else if (!strcmp(arg, "--tensors"))     tensor_dir = value;
+    else if (!strcmp(arg, "--max_frames"))  max_frames = atoi(value);
+    else if (!strcmp(arg, "--reps"))        reps = std::max(atoi(value), 1);
+    else if (!strcmp(arg, "--min_time_ms")) min_time_ms = std::max((float)atof(value), 1.0f);
+    else if (!strcmp(arg, "--json"))        json_file = value;
+    else if (!strcmp(arg, "--baseline"))    baseline_file = value;
+    else if (!strcmp(arg, "--image"))
+    {
+      if (sscanf(value, "%dx%d", &image_size.width, &image_size.height) != 2 || image_size.width < 1 ||
+          image_size.height < 1)
+      {
+        print_usage();
+        return -1;
+      }
+    }
+    else
+    {
+      print_usage();
+      return -1;
+    }
+  }
+
+  /* The model constants without a DPU, 550x550 input */
+  yolact model;
+  model.create_host(1, cv::Size(550, 550), 6);
+  kernel_bench bench(model);
+  const float score_thresh = 0.5f;
+
+  /* Input sets */
+  vector<input_set_t> sets;
+  vector<box_t> priors = bench.priors();
+  mt19937 rng(1);
+  for (int objects : object_counts)
+  {
+    /* Seeded by the object count, so a set has the same frames in every run */
+    mt19937 set_rng(1 + objects);
+    input_set_t set;
+    set.name = "synthetic:" + to_string(objects);
+    set.frames.resize(num_frames);
+    for (auto &frame : set.frames)
+    {
+      make_synthetic_frame(frame, objects, clutter, priors, set_rng);
+    }
+    sets.push_back(std::move(set));
+  }
+  if (!tensor_dir.empty())
+  {
+    input_set_t set;
+    if (!load_recorded(tensor_dir, max_frames, set)) return -1;
+    sets.push_back(std::move(set));
+  }
+
+  /* Per-frame state: scan results, candidate priors, detections & the images drawn on */
+  for (auto &set : sets)
+  {
+    double candidates = 0.0;
+    for (auto &frame : set.frames)
+    {
+      frame.image.create(image_size, CV_8UC3);
+      fill_noise(frame.image, rng);
+      model.postprocess(frame);
+
+      vector<vector<pair<float, int>>> score_index_vec;
+      bench.scan(frame, score_index_vec);
+      for (auto &class_vec : score_index_vec) candidates += class_vec.size();
+    }
+    set.candidates = candidates / set.frames.size();
+  }
+
+  map<string, double> baseline;
+  if (!baseline_file.empty()) baseline = load_baseline(baseline_file);
+
+  vector<result_t> results;
+  uint64_t min_ns = (uint64_t)(min_time_ms * 1e6f);
+  long checksum = 0;
+
+  cv::Mat input_image(550, 550, CV_8UC3);
+  fill_noise(input_image, rng);
+  vector<int8_t> input(550 * 550 * 3);
+
+  printf("%-16s %-24s %10s %12s %12s %8s %12s %14s", "Kernel", "Input", "Items/op", "Median", "Min", "Stddev",
+         "Ops/sec", "Items/sec");
+  if (!baseline.empty()) printf(" %9s", "Speedup");
+  printf("\n");
+
+  auto run = [&](const char *kernel, const string &input_name, double items, const char *unit,
+                 const function<int(uint64_t)> &op)
+  {
+    if (!kernels.empty() && !kernels.count(kernel)) return;
+
+    result_t result;
+    result.kernel = kernel;
+    result.input = input_name;
+    result.items = items;
+    result.unit = unit;
+    if (!measure(op, reps, min_ns, result))
+    {
+      printf("%-16s %-24s %10s\n", kernel, input_name.c_str(), "(no work)");
+      return;
+    }
+    results.push_back(result);
+
+    printf("%-16s %-24s %10.0f %9.1f us %9.1f us %7.1f%% %12.1f %12.3g %s", kernel, input_name.c_str(), items,
+           result.median_ns * 1e-3, result.min_ns * 1e-3, 100.0 * result.stddev_ns / result.mean_ns,
+           1e9 / result.median_ns, items * 1e9 / result.median_ns, unit);
+    auto base = baseline.find(result.kernel + " " + result.input);
+    if (base != baseline.end()) printf(" %8.2fx", base->second / result.median_ns);
+    printf("\n");
+  };
+
+  run("set_input_image", "550x550", 550.0 * 550.0, "px", [&](uint64_t)
+  {
+    bench.set_input_image(input_image, input);
+    checksum += input[0];
+    return 1;
+  });
+
+  for (auto &set : sets)
+  {
+    vector<frame_t> &frames = set.frames;
+    size_t n = frames.size();
+    double detections = 0.0;
+    for (auto &frame : frames)
+    {
+      for (auto &box : frame.boxes) detections += (box.score >= score_thresh) ? 1.0 : 0.0;
+    }
+    detections /= n;
+
+    run("scan", set.name, (double)NUM_PRIORS * (NUM_CLASSES - 1), "scores", [&](uint64_t i)
+    {
+      vector<vector<pair<float, int>>> score_index_vec;
+      bench.scan(frames[i % n], score_index_vec);
+      checksum += score_index_vec[1].size();
+      return 1;
+    });
+
+    /* Decoding & NMS consume the scan results of the frame, prepared once per input set */
+    vector<vector<vector<pair<float, int>>>> scans(n);
+    for (size_t f = 0; f < n; f++) bench.scan(frames[f], scans[f]);
+
+    /* One operation per decoded candidate box */
+    run("decode_bbox", set.name, 1.0, "boxes", [&](uint64_t i)
+    {
+      map<int, vector<float>> decoded_bboxes;
+      int decoded = 0;
+      for (auto &class_vec : scans[i % n])
+      {
+        for (auto &score_index : class_vec)
+        {
+          bench.decode_bbox(frames[i % n], score_index.second, decoded_bboxes);
+          decoded++;
+        }
+      }
+      checksum += decoded_bboxes.size();
+      return decoded;
+    });
+
+    run("nms", set.name, set.candidates, "candidates", [&](uint64_t i)
+    {
+      checksum += bench.nms(frames[i % n], scans[i % n]);
+      return 1;
+    });
+
+    run("detect", set.name, set.candidates, "candidates", [&](uint64_t i)
+    {
+      model.postprocess(frames[i % n]);
+      checksum += frames[i % n].boxes.size();
+      return 1;
+    });
+
+    run("draw_masks", set.name, detections, "detections", [&](uint64_t i)
+    {
+      bench.draw_masks(frames[i % n].image, frames[i % n], score_thresh);
+      return 1;
+    });
+
+    run("draw_boxes", set.name, detections, "detections", [&](uint64_t i)
+    {
+      bench.draw_boxes(frames[i % n].image, frames[i % n], score_thresh);
+      return 1;
+    });
+  }
+
+  if (!json_file.empty())
+  {
+    FILE *file = fopen(json_file.c_str(), "w");
+    if (file == nullptr)
+    {
+      printf("ERROR: unable to write %s\n", json_file.c_str());
+      return -1;
+    }
+
+    fprintf(file, "{\n  \"reps\": %d,\n  \"min_time_ms\": %.1f,\n  \"image\": \"%dx%d\",\n  \"results\": [\n", reps,
+            min_time_ms, image_size.width, image_size.height);
+    for (size_t r = 0; r < results.size(); r++)
+    {
+      const result_t &res = results[r];
+      fprintf(file, "    { \"kernel\": \"%s\", \"input\": \"%s\", \"items_per_op\": %.1f, \"unit\": \"%s\", "
+              "\"ops\": %llu, \"median_ns\": %.1f, \"min_ns\": %.1f, \"mean_ns\": %.1f, \"stddev_ns\": %.1f, "
+              "\"ops_per_sec\": %.1f, \"items_per_sec\": %.1f }%s\n",
+              res.kernel.c_str(), res.input.c_str(), res.items, res.unit, (unsigned long long)res.ops, res.median_ns,
+              res.min_ns, res.mean_ns, res.stddev_ns, 1e9 / res.median_ns, res.items * 1e9 / res.median_ns,
+              (r + 1 < results.size()) ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+  }
+
+  /* Keeps the kernel results alive */
+  if (checksum == 1) printf("\n");
+  return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+/*
+ * Check of the outputs of a reduced-resolution JPEG decode.
+ *
+ * Encodes a synthetic high resolution image, decodes it like the image
+ * sources do with --reduced_decode and draws a detection on it with
+ * yolact::create_overlays.  The annotated image must stay at the decoded
+ * size, or come back at the original size with full size output, and the
+ * label mask must be at the original size.  The drawn detection must be at
+ * the coordinates of box_to_source_rect (within one decode scale step).
+ * Prints the mismatches & returns 1 if any check fails.
+ *
+ * Builds with yolact.hpp's YOLACT_NO_VITIS, so it only needs OpenCV, build
+ * with build.sh or:
+ *   g++ -std=c++17 -O3 -DYOLACT_NO_VITIS -I../src reduced_decode_check.cpp -o reduced_decode_check.exe \
+ *       -lopencv_core -lopencv_imgproc -lopencv_imgcodecs -lpthread
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "yolact.hpp"
+#include "decode.hpp"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check( bool ok, const char *what, int value, int expected )
+{
+  if (!ok)
+  {
+    printf("FAIL: %s is %d, expected %d\n", what, value, expected);
+    failures++;
+  }
+}
+
+/* The box outline is drawn on the left edge of rect, in neither the background nor the mask color */
+static void check_outline( const cv::Mat &image, const cv::Rect &rect, int step )
+{
+  int y = rect.y + rect.height / 2;
+  cv::Vec3b background = image.at<cv::Vec3b>(y, rect.x - 4 * step);
+  cv::Vec3b mask = image.at<cv::Vec3b>(y, rect.x + rect.width / 2);
+  int outline = 0;
+  for (int x = rect.x - step; x <= rect.x + step; x++)
+  {
+    cv::Vec3b pixel = image.at<cv::Vec3b>(y, x);
+    int diff_background = 0, diff_mask = 0;
+    for (int c = 0; c < 3; c++)
+    {
+      diff_background = max(diff_background, abs((int)pixel[c] - (int)background[c]));
+      diff_mask = max(diff_mask, abs((int)pixel[c] - (int)mask[c]));
+    }
+    if (diff_background > 16 && diff_mask > 16) outline++;
+  }
+  check(outline > 0, "Outline pixels around the left edge", outline, 1);
+  check(abs((int)background[0] - 96) <= 8, "Background left of the box", (int)background[0], 96);
+}
+
+int main( int argc, char *argv[] )
+{
+  /* 2200x1760 is decoded at 1/4 scale for the 550x440 minimum size */
+  const cv::Size src_size(2200, 1760);
+  const cv::Size min_size(550, 440);
+  const int scale = 4;
+
+  cv::Mat original(src_size.height, src_size.width, CV_8UC3, cv::Scalar(96, 96, 96));
+  vector<uchar> file_data;
+  if (!cv::imencode(".jpg", original, file_data))
+  {
+    printf("FAIL: cannot encode the test image\n");
+    return 1;
+  }
+
+  frame_t frame;
+  frame.seq = 0;
+  if (!decode_image_data(file_data, frame.image, min_size, frame.src_size))
+  {
+    printf("FAIL: cannot decode the test image\n");
+    return 1;
+  }
+
+  check(frame.image.cols == src_size.width / scale, "Decoded width", frame.image.cols, src_size.width / scale);
+  check(frame.image.rows == src_size.height / scale, "Decoded height", frame.image.rows, src_size.height / scale);
+  check(frame.src_size == src_size, "Source width", frame.src_size.width, src_size.width);
+
+  /* A single detection whose mask covers its whole box */
+  box_t box = { 1, 0.9f, 0.3f, 0.2f, 0.4f, 0.5f };
+  frame.boxes.push_back(box);
+  frame.masks.push_back(vector<float>(PROTO_C, 1.0f));
+  frame.proto.assign(PROTO_SIZE, 1.0f);
+
+  yolact model;
+  model.create_host(1, cv::Size(550, 550), 6);
+  frame_t full_frame = frame;
+  full_frame.image = frame.image.clone();
+  model.create_overlays(frame, 0.5f, true);
+
+  const cv::Size decoded_size(src_size.width / scale, src_size.height / scale);
+  check(frame.image.size() == decoded_size, "Annotated image width", frame.image.cols, decoded_size.width);
+  check(frame.image.rows == decoded_size.height, "Annotated image height", frame.image.rows, decoded_size.height);
+  check(frame.label_mask.size() == src_size, "Label mask width", frame.label_mask.cols, src_size.width);
+  check(frame.label_mask.rows == src_size.height, "Label mask height", frame.label_mask.rows, src_size.height);
+
+  cv::Rect expected = box_to_source_rect(frame, box);
+  if (frame.label_mask.size() == src_size)
+  {
+    /* The labelled pixels must span the box in original image coordinates */
+    int xmin = src_size.width, ymin = src_size.height, xmax = -1, ymax = -1;
+    for (int y = 0; y < frame.label_mask.rows; y++)
+    {
+      for (int x = 0; x < frame.label_mask.cols; x++)
+      {
+        if (frame.label_mask.at<uchar>(y, x) == 0) continue;
+        xmin = min(xmin, x);
+        ymin = min(ymin, y);
+        xmax = max(xmax, x + 1);
+        ymax = max(ymax, y + 1);
+      }
+    }
+
+    check(abs(xmin - expected.x) <= scale, "Mask left edge", xmin, expected.x);
+    check(abs(ymin - expected.y) <= scale, "Mask top edge", ymin, expected.y);
+    check(abs(xmax - (expected.x + expected.width)) <= scale, "Mask right edge", xmax, expected.x + expected.width);
+    check(abs(ymax - (expected.y + expected.height)) <= scale, "Mask bottom edge", ymax, expected.y + expected.height);
+  }
+  if (frame.image.size() == decoded_size)
+  {
+    cv::Rect decoded(expected.x / scale, expected.y / scale, expected.width / scale, expected.height / scale);
+    check_outline(frame.image, decoded, 1);
+  }
+
+  /* Full size output scales the annotated image back to the original image */
+  model.create_overlays(full_frame, 0.5f, false, true);
+  check(full_frame.image.size() == src_size, "Full size image width", full_frame.image.cols, src_size.width);
+  check(full_frame.image.rows == src_size.height, "Full size image height", full_frame.image.rows, src_size.height);
+  if (full_frame.image.size() == src_size)
+  {
+    check_outline(full_frame.image, expected, scale);
+  }
+
+  if (failures)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+
+  printf("Reduced decode outputs match the original image coordinates\n");
+  return 0;
+}
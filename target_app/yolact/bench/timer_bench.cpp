@@ -0,0 +1,130 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Microbenchmark of the timing overhead of the pipeline instrumentation.
+ *
+ * Measures the cost of a latency_timer start()/stop() pair (counter reads &
+ * histogram update), of a bare latency_histogram::record() and, for
+ * comparison, of the clock_gettime() pair the timers used before.  The
+ * histogram percentiles are checked against the exact percentiles of the
+ * same samples.
+ *
+ * Only depends on the C++ standard library, build with build.sh or:
+ *   g++ -std=c++17 -O3 -I../src timer_bench.cpp -o timer_bench.exe
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <vector>
+
+#include "latency_timer.hpp"
+
+using namespace std;
+
+static uint64_t now_ns()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+int main( int argc, char *argv[] )
+{
+  int iterations = 10000000;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--iter") && i+1 < argc)
+    {
+      iterations = atoi(argv[++i]);
+    }
+    else
+    {
+      printf("Usage: ./timer_bench.exe [--iter N]\n");
+      return -1;
+    }
+  }
+
+  /* Calibrate outside of the measurements */
+  printf("Counter tick = %.3f ns\n", fast_clock_ns_per_tick());
+  printf("Cost per call, %d iterations:\n", iterations);
+
+  {
+    latency_timer timer;
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < iterations; i++)
+    {
+      timer.start();
+      timer.stop();
+    }
+    printf("  %-24s %6.1f ns\n", "latency_timer start+stop", (double)(now_ns() - t0) / iterations);
+  }
+  {
+    latency_histogram hist;
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < iterations; i++)
+    {
+      hist.record((uint64_t)i & 0xfffff);
+    }
+    printf("  %-24s %6.1f ns\n", "histogram record", (double)(now_ns() - t0) / iterations);
+  }
+  {
+    timespec a, b;
+    uint64_t sum = 0;
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < iterations; i++)
+    {
+      clock_gettime(CLOCK_MONOTONIC, &a);
+      clock_gettime(CLOCK_MONOTONIC, &b);
+      sum += b.tv_nsec - a.tv_nsec;
+    }
+    printf("  %-24s %6.1f ns\n", "clock_gettime pair", (double)(now_ns() - t0) / iterations);
+    if (sum == 1) printf("\n");
+  }
+
+  /* Log-normal service times around 0.5 ms */
+  printf("Histogram accuracy (1M log-normal samples):\n");
+  {
+    latency_histogram hist;
+    vector<uint64_t> samples;
+    mt19937_64 rng(1);
+    lognormal_distribution<double> dist(13.0, 1.0);
+
+    for (int i = 0; i < 1000000; i++)
+    {
+      uint64_t ns = (uint64_t)dist(rng);
+      samples.push_back(ns);
+      hist.record(ns);
+    }
+    sort(samples.begin(), samples.end());
+
+    for (double pct : { 50.0, 90.0, 99.0, 99.9 })
+    {
+      uint64_t exact = samples[(size_t)(pct / 100.0 * samples.size()) - 1];
+      uint64_t approx = hist.get_percentile(pct);
+      printf("  p%-5.1f exact %10.3f ms   histogram %10.3f ms   error %+.2f%%\n", pct, exact * 1e-6, approx * 1e-6,
+             100.0 * ((double)approx - (double)exact) / (double)exact);
+    }
+  }
+
+  return 0;
+}
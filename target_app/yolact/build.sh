@@ -28,6 +28,7 @@ $CXX -std=c++17 -O3 -o yolact.exe src/main.cpp \
 	-I./src \
 	${OPENCV_FLAGS} \
 	-lpthread \
+	-lrt \
 	-lopencv_core \
 	-lopencv_video \
 	-lopencv_videoio \
@@ -40,3 +41,64 @@ $CXX -std=c++17 -O3 -o yolact.exe src/main.cpp \
 	-lvitis_ai_library-graph_runner \
 	-lvitis_ai_library-xnnpp
 
+
+# Shared library with the C interface of yolact_c.h
+$CXX -std=c++17 -O3 -shared -fPIC -fvisibility=hidden -o libyolact.so src/yolact_c.cpp \
+	-I./src \
+	${OPENCV_FLAGS} \
+	-lpthread \
+	-lopencv_core \
+	-lopencv_imgproc \
+	-lopencv_imgcodecs \
+	-lopencv_videoio \
+	-lopencv_highgui \
+	-lglog \
+	-lxir \
+	-lvart-runner \
+	-lvitis_ai_library-graph_runner \
+	-lvitis_ai_library-xnnpp
+
+# Queue hand-off microbenchmark (standard library only)
+$CXX -std=c++17 -O3 -o handoff_bench.exe bench/handoff_bench.cpp \
+	-I./src \
+	-lpthread
+
+# CPU kernel microbenchmark, builds the processing without Vitis AI (OpenCV only)
+$CXX -std=c++17 -O3 -DYOLACT_NO_VITIS -o kernel_bench.exe bench/kernel_bench.cpp \
+	-I./src \
+	${OPENCV_FLAGS} \
+	-lpthread \
+	-lopencv_core \
+	-lopencv_imgproc
+
+# C++ post-processing of recorded tensors for golden_detect.py, builds without Vitis AI (OpenCV only)
+$CXX -std=c++17 -O3 -DYOLACT_NO_VITIS -o detect_tensors.exe src/detect_tensors.cpp \
+	-I./src \
+	${OPENCV_FLAGS} \
+	-lpthread \
+	-lopencv_core \
+	-lopencv_imgproc
+
+# Check that the outputs of a reduced JPEG decode are in original image coordinates, builds without Vitis AI (OpenCV only)
+$CXX -std=c++17 -O3 -DYOLACT_NO_VITIS -o reduced_decode_check.exe bench/reduced_decode_check.cpp \
+	-I./src \
+	${OPENCV_FLAGS} \
+	-lpthread \
+	-lopencv_core \
+	-lopencv_imgproc \
+	-lopencv_imgcodecs
+
+# Timing overhead & histogram accuracy microbenchmark (standard library only)
+$CXX -std=c++17 -O3 -o timer_bench.exe bench/timer_bench.cpp \
+	-I./src
+
+# Client of the inference daemon & its overhead benchmark (standard library & POSIX only)
+$CXX -std=c++17 -O3 -o yolact_client.exe src/yolact_client.cpp \
+	-I./src
+$CXX -std=c++17 -O3 -o daemon_bench.exe bench/daemon_bench.cpp \
+	-I./src
+
+# Reference producer of the shared-memory frame ring (standard library & Linux only)
+$CXX -std=c++17 -O3 -o shm_producer.exe src/shm_producer.cpp \
+	-I./src \
+	-lrt
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _AFFINITY_HPP_
+#define _AFFINITY_HPP_
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * Thread placement helpers
+ *
+ * CPU sets are kept as bit masks (bit N = CPU N), which covers the cores of
+ * the MPSoC devices with room to spare.  A mask of 0 means "no pinning".
+ */
+
+/* Parses a taskset style CPU list, e.g. "1" or "0,2-3" */
+static inline bool parse_cpu_list( const std::string &list, uint64_t &mask )
+{
+  size_t pos = 0;
+  mask = 0;
+
+  while (pos < list.size())
+  {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) end = list.size();
+
+    std::string item = list.substr(pos, end - pos);
+    size_t dash = item.find('-');
+    char *stop;
+
+    long first = strtol(item.c_str(), &stop, 10);
+    long last = first;
+    if (stop == item.c_str()) return false;
+    if (dash != std::string::npos)
+    {
+      const char *second = item.c_str() + dash + 1;
+      last = strtol(second, &stop, 10);
+      if (stop == second) return false;
+    }
+    if (*stop != '\0' || first < 0 || last < first || last >= 64) return false;
+
+    for (long cpu = first; cpu <= last; cpu++)
+    {
+      mask |= 1ull << cpu;
+    }
+    pos = end + 1;
+  }
+
+  return mask != 0;
+}
+
+/* Formats a CPU mask as a CPU list */
+static inline std::string cpu_list_string( uint64_t mask )
+{
+  std::string list;
+
+  for (int cpu = 0; cpu < 64; cpu++)
+  {
+    if (!(mask & (1ull << cpu))) continue;
+
+    int last = cpu;
+    while (last < 63 && (mask & (1ull << (last + 1)))) last++;
+
+    if (!list.empty()) list += ",";
+    list += std::to_string(cpu);
+    if (last > cpu) list += "-" + std::to_string(last);
+    cpu = last;
+  }
+
+  return list;
+}
+
+/* Restricts the calling thread to the CPUs of the mask, returns false on failure */
+static inline bool pin_current_thread( uint64_t mask )
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu = 0; cpu < 64; cpu++)
+  {
+    if (mask & (1ull << cpu)) CPU_SET(cpu, &set);
+  }
+
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+/* Runs the calling thread with SCHED_FIFO at the given priority (needs CAP_SYS_NICE) */
+static inline bool set_current_thread_fifo( int priority )
+{
+  sched_param param;
+  param.sched_priority = priority;
+
+  return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+#endif
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _AUTOTUNE_HPP_
+#define _AUTOTUNE_HPP_
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "pipeline.hpp"
+#include "source.hpp"
+#include "bench_stats.hpp"
+
+/* Measured performance of a pipeline configuration */
+typedef struct
+{
+  pipeline_config_t config;
+  float             fps;       // Steady-state frames per second
+  float             p99_ms;    // 99th percentile of the end-to-end latency
+  float             util[NUM_STAGES];   // Stage utilization
+  size_t            pool_frames;        // Frames allocated by the pipeline
+} tune_result_t;
+
+/*
+ * Pipeline auto-tuner
+ *
+ * Runs short calibration passes over a ring of preloaded frames and searches
+ * the pipeline configuration with the highest steady-state FPS whose p99
+ * latency stays under the latency cap:
+ *
+ *   1. for every model context count up to max_threads, CPU stage workers
+ *      are added one at a time to the busiest stage for as long as that
+ *      raises the FPS,
+ *   2. for the best of these, the in-flight frame limit is lowered as far as
+ *      it goes without costing FPS, which shortens the queues & the latency.
+ *
+ * Results within 2% FPS are treated as equal and the lower latency wins.
+ * When no configuration meets the cap the lowest latency is chosen.
+ */
+class autotuner
+{
+  public:
+
+    autotuner( yolact            *models,
+               int                max_threads,
+               pipeline_config_t &base,
+               ring_source       &frames,
+               float              latency_cap_ms ) : models(models), max_threads(max_threads), base(base),
+                                                     frames(frames), latency_cap_ms(latency_cap_ms)
+    {
+      this->base.report_interval = 0.0f;
+      this->base.inflight = 0;
+    }
+
+    /* Searches the configuration space, returns the best measured configuration */
+    tune_result_t run()
+    {
+      int batch_size = models[0].get_batch_size();
+      int max_cpu_workers = std::max((int)std::thread::hardware_concurrency(), 2);
+      tune_result_t best;
+      bool have_best = false;
+
+      for (int threads = 1; threads <= max_threads; threads++)
+      {
+        pipeline_config_t config = base;
+        config.workers[STAGE_INFER] = threads;
+        for (int s : cpu_stages)
+        {
+          config.workers[s] = 1;
+        }
+
+        tune_result_t current = trial(config);
+
+        /* Give the busiest CPU stage another worker until that stops paying off */
+        for (int added = 0; added < max_cpu_workers; added++)
+        {
+          int busiest = -1;
+          for (int s : cpu_stages)
+          {
+            if (current.config.workers[s] < max_cpu_workers &&
+                (busiest < 0 || current.util[s] > current.util[busiest])) busiest = s;
+          }
+          if (busiest < 0) break;
+
+          config = current.config;
+          config.workers[busiest]++;
+
+          tune_result_t candidate = trial(config);
+          if (!better(candidate, current)) break;
+          current = candidate;
+        }
+
+        if (!have_best || better(current, best))
+        {
+          best = current;
+          have_best = true;
+        }
+      }
+
+      /* Smallest in-flight window that keeps the FPS, from one batch per context up to the full pool */
+      pipeline_config_t unlimited = best.config;
+      size_t pool_frames = best.pool_frames;
+      size_t min_frames = unlimited.workers[STAGE_INFER] * batch_size;
+      for (size_t inflight = min_frames; inflight < pool_frames; inflight = inflight * 3 / 2 + 1)
+      {
+        pipeline_config_t config = unlimited;
+        config.inflight = inflight;
+
+        tune_result_t candidate = trial(config);
+        if (better(candidate, best))
+        {
+          best = candidate;
+        }
+      }
+
+      return best;
+    }
+
+    /* Writes the configuration as an options file for --config */
+    bool save( const std::string &path, const tune_result_t &result )
+    {
+      std::ofstream out(path);
+      char line[160];
+
+      sprintf(line, "# Generated by --autotune: %.1f FPS, p99 latency %.1f ms", result.fps, result.p99_ms);
+      out << line;
+      if (latency_cap_ms > 0.0f) out << " (latency cap " << latency_cap_ms << " ms)";
+      out << std::endl;
+
+      out << "--pipeline" << std::endl;
+      out << "--threads " << result.config.workers[STAGE_INFER] << std::endl;
+      out << "--stage_workers ";
+      for (size_t i = 0; i < sizeof(cpu_stages) / sizeof(cpu_stages[0]); i++)
+      {
+        if (i > 0) out << ",";
+        out << stage_names[cpu_stages[i]] << "=" << result.config.workers[cpu_stages[i]];
+      }
+      out << std::endl;
+      if (result.config.inflight > 0)
+      {
+        out << "--inflight " << result.config.inflight << std::endl;
+      }
+
+      return (bool)out;
+    }
+
+    static void print_result( const char *label, const tune_result_t &result )
+    {
+      char line[192];
+      sprintf(line, "%-10s threads=%d decode=%d preprocess=%d postprocess=%d render=%d inflight=",
+              label, result.config.workers[STAGE_INFER], result.config.workers[STAGE_DECODE],
+              result.config.workers[STAGE_PREPROCESS], result.config.workers[STAGE_POSTPROCESS],
+              result.config.workers[STAGE_RENDER]);
+      std::cout << line;
+      if (result.config.inflight > 0) std::cout << result.config.inflight;
+      else std::cout << "all";
+
+      sprintf(line, ": %.1f FPS, p99 latency %.1f ms", result.fps, result.p99_ms);
+      std::cout << line << std::endl;
+    }
+
+  private:
+
+    /* Stages whose worker count is tuned, the infer stage is sized by the thread count */
+    const int          cpu_stages[4] = { STAGE_DECODE, STAGE_PREPROCESS, STAGE_POSTPROCESS, STAGE_RENDER };
+
+    yolact            *models;
+    int                max_threads;
+    pipeline_config_t  base;
+    ring_source       &frames;
+    float              latency_cap_ms;
+
+    bool meets_cap( const tune_result_t &r ) { return latency_cap_ms <= 0.0f || r.p99_ms <= latency_cap_ms; }
+
+    /* True if a is a better configuration than b */
+    bool better( const tune_result_t &a, const tune_result_t &b )
+    {
+      if (meets_cap(a) != meets_cap(b)) return meets_cap(a);
+      if (!meets_cap(a)) return a.p99_ms < b.p99_ms;
+
+      if (a.fps > b.fps * 1.02f) return true;
+      if (b.fps > a.fps * 1.02f) return false;
+      return a.p99_ms < b.p99_ms * 0.95f;
+    }
+
+    /* Runs one calibration pass over the frame ring */
+    tune_result_t trial( const pipeline_config_t &config )
+    {
+      tune_result_t result;
+      result.config = config;
+
+      int warmup = config.workers[STAGE_INFER] * models[0].get_batch_size();
+      bench_stats bench(warmup);
+
+      frames.rewind();
+      pipeline pipe(models, result.config);
+      bench.start();
+      pipe.run([&](frame_t &frame) { return frames.read(frame); },
+               [&](frame_t &frame) { bench.record(frame.t_start, frame_clock_ns()); });
+
+      result.fps = bench.get_fps();
+      result.p99_ms = bench.get_latency(99);
+      for (int s = 0; s < NUM_STAGES; s++)
+      {
+        result.util[s] = pipe.get_utilization(s);
+      }
+      result.pool_frames = pipe.get_pool_size();
+
+      print_result("  trial", result);
+      return result;
+    }
+};
+
+#endif
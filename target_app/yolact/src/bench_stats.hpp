@@ -0,0 +1,124 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BENCH_STATS_HPP_
+#define _BENCH_STATS_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+
+#include "frame.hpp"
+#include "latency_timer.hpp"
+
+/*
+ * Steady-state benchmark statistics
+ *
+ * The first `warmup` completed frames are discarded (DPU & cache warm-up,
+ * thread start-up).  For the remaining frames the throughput is measured
+ * from the completion of the last warm-up frame and the per-frame latencies
+ * are recorded into a log-linear histogram, so memory use is constant
+ * however many frames are measured.
+ */
+class bench_stats
+{
+  public:
+
+    bench_stats( uint64_t warmup ) : warmup(warmup)
+    {
+      completed = 0;
+      warm_ns = 0;
+      end_ns = 0;
+    }
+
+    /* Marks the start of the run, the measurement window opens here without warm-up */
+    void start()
+    {
+      if (warmup == 0) warm_ns = frame_clock_ns();
+    }
+
+    /* Records `frames` frames that were processed between start_ns and end_ns */
+    void record( uint64_t start_ns, uint64_t end_ns, int frames = 1 )
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+
+      bool warm = (completed >= warmup);
+      completed += frames;
+
+      if (!warm)
+      {
+        if (completed >= warmup) warm_ns = end_ns;
+        return;
+      }
+
+      for (int f = 0; f < frames; f++)
+      {
+        latency.record(end_ns - start_ns);
+      }
+      this->end_ns = std::max(this->end_ns, end_ns);
+    }
+
+    /* Steady-state frames per second */
+    float get_fps()
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      float secs = (float)(end_ns - warm_ns) * 1e-9f;
+      return (secs > 0.0f) ? (float)latency.get_count() / secs : 0.0f;
+    }
+
+    /* Latency percentile in milliseconds, e.g. 99 for p99 */
+    float get_latency( int percentile )
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      return (float)latency.get_percentile(percentile) * 1e-6f;
+    }
+
+    void print()
+    {
+      char line[160];
+      uint64_t n = latency.get_count();
+
+      if (n == 0)
+      {
+        std::cout << "Benchmark: no frames completed after " << warmup << " warm-up frames" << std::endl;
+        return;
+      }
+
+      float secs = (float)(end_ns - warm_ns) * 1e-9f;
+
+      sprintf(line, "Steady-state FPS = %.1f (%llu frames after %llu warm-up frames)",
+              (secs > 0.0f) ? (float)n / secs : 0.0f, (unsigned long long)n, (unsigned long long)warmup);
+      std::cout << line << std::endl;
+
+      sprintf(line, "Per-frame latency: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms",
+              latency.get_percentile(50) * 1e-6, latency.get_percentile(90) * 1e-6, latency.get_percentile(99) * 1e-6,
+              latency.get_max() * 1e-6);
+      std::cout << line << std::endl;
+    }
+
+  private:
+
+    std::mutex         mtx;
+    uint64_t           warmup;
+    uint64_t           completed;
+    uint64_t           warm_ns;
+    uint64_t           end_ns;
+    latency_histogram  latency;
+};
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BOUNDED_QUEUE_HPP_
+#define _BOUNDED_QUEUE_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+/*
+ * Interface of the queues used to connect pipeline stages
+ */
+template <typename T>
+class blocking_queue
+{
+  public:
+
+    virtual ~blocking_queue() {}
+
+    virtual bool push( T item ) = 0;
+    virtual bool pop( T &item ) = 0;
+    virtual bool try_push( const T &item ) = 0;
+    virtual bool try_pop( T &item ) = 0;
+    virtual bool pop_until( T &item, std::chrono::steady_clock::time_point deadline ) = 0;
+    virtual void close() = 0;
+
+    virtual size_t get_capacity() = 0;
+    virtual uint64_t get_pushes() = 0;
+    virtual size_t get_max_depth() = 0;
+    virtual float avg_depth() = 0;
+};
+
+/*
+ * Blocking FIFO with a fixed capacity used to connect pipeline stages.
+ *
+ * push() blocks while the queue is full and pop() blocks while it is empty.
+ * Once close() has been called push() fails and pop() drains the remaining
+ * items before failing, which lets the end-of-stream ripple through the
+ * pipeline one stage at a time.
+ */
+template <typename T>
+class bounded_queue : public blocking_queue<T>
+{
+  public:
+
+    bounded_queue( size_t capacity ) : capacity(capacity), closed(false)
+    {
+      pushes = 0;
+      depth_sum = 0;
+      max_depth = 0;
+    }
+
+    bool push( T item )
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+
+      if (closed)
+      {
+        return false;
+      }
+
+      items.push_back(item);
+
+      /* Sample the queue depth on every push */
+      pushes++;
+      depth_sum += items.size();
+      if (items.size() > max_depth) max_depth = items.size();
+
+      lock.unlock();
+      not_empty.notify_one();
+      return true;
+    }
+
+    bool pop( T &item )
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      not_empty.wait(lock, [this] { return closed || !items.empty(); });
+
+      if (items.empty())
+      {
+        return false;
+      }
+
+      item = items.front();
+      items.pop_front();
+
+      lock.unlock();
+      not_full.notify_one();
+      return true;
+    }
+
+    /* Blocking pop with a deadline, fails on time-out or once the queue is closed & drained */
+    bool pop_until( T &item, std::chrono::steady_clock::time_point deadline )
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      not_empty.wait_until(lock, deadline, [this] { return closed || !items.empty(); });
+
+      if (items.empty())
+      {
+        return false;
+      }
+
+      item = items.front();
+      items.pop_front();
+
+      lock.unlock();
+      not_full.notify_one();
+      return true;
+    }
+
+    /* Non-blocking push, fails if the queue is full or closed */
+    bool try_push( const T &item )
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      if (closed || items.size() >= capacity)
+      {
+        return false;
+      }
+
+      items.push_back(item);
+
+      pushes++;
+      depth_sum += items.size();
+      if (items.size() > max_depth) max_depth = items.size();
+
+      lock.unlock();
+      not_empty.notify_one();
+      return true;
+    }
+
+    /* Non-blocking pop, fails if the queue is empty */
+    bool try_pop( T &item )
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      if (items.empty())
+      {
+        return false;
+      }
+
+      item = items.front();
+      items.pop_front();
+
+      lock.unlock();
+      not_full.notify_one();
+      return true;
+    }
+
+    void close()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+      }
+      not_full.notify_all();
+      not_empty.notify_all();
+    }
+
+    size_t get_capacity() { return capacity; }
+    uint64_t get_pushes() { return pushes; }
+    size_t get_max_depth() { return max_depth; }
+    float avg_depth() { return (pushes == 0) ? 0.0f : (float)depth_sum / (float)pushes; }
+
+  private:
+
+    std::mutex              mtx;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<T>           items;
+    size_t                  capacity;
+    bool                    closed;
+
+    uint64_t                pushes;
+    uint64_t                depth_sum;
+    size_t                  max_depth;
+};
+
+#endif
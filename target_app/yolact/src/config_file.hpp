@@ -0,0 +1,87 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _CONFIG_FILE_HPP_
+#define _CONFIG_FILE_HPP_
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Options files
+ *
+ * An options file holds command line options separated by white space, a
+ * '#' starts a comment that runs to the end of the line.  --config <file>
+ * inserts the options of the file in place, so options given after it on
+ * the command line override the file.
+ */
+
+/* Appends the options of a file to args */
+static inline bool read_config_file( const std::string &path, std::vector<std::string> &args )
+{
+  std::ifstream in(path);
+  if (!in)
+  {
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(in, line))
+  {
+    size_t comment = line.find('#');
+    if (comment != std::string::npos) line.erase(comment);
+
+    std::istringstream words(line);
+    std::string word;
+    while (words >> word)
+    {
+      args.push_back(word);
+    }
+  }
+
+  return true;
+}
+
+/* Copies the command line to args, replacing every --config <file> by the options of the file */
+static inline bool expand_config_args( int argc, char *argv[], std::vector<std::string> &args )
+{
+  for (int i = 0; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--config") != 0)
+    {
+      args.push_back(argv[i]);
+    }
+    else if (i+1 >= argc)
+    {
+      std::cout << "ERROR: please provide a configuration file as argument" << std::endl;
+      return false;
+    }
+    else if (!read_config_file(argv[++i], args))
+    {
+      std::cout << "ERROR: unable to read configuration file " << argv[i] << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _DAEMON_PROTOCOL_HPP_
+#define _DAEMON_PROTOCOL_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Wire protocol of the inference daemon (--daemon)
+ *
+ * Clients connect to a Unix stream socket and send any number of requests
+ * on the connection, each answered in order.  A request is a fixed header
+ * followed by `payload` bytes:
+ *
+ *   REQ_IMAGE_PATH  payload is the path of an image file readable by the daemon
+ *   REQ_RAW_FD      a BGR8 frame of width x height (row stride in bytes) at
+ *                   `offset` of a file descriptor passed with SCM_RIGHTS
+ *                   along with the header (e.g. a memfd or a raw file)
+ *   REQ_SHM         the same for a POSIX shared memory object, payload is its name
+ *
+ * The response is a fixed header followed by `payload` bytes: `count`
+ * daemon_detection_t records, or a JSON document for RESULT_JSON.
+ * Only the C++ standard library & POSIX are used, so clients don't need
+ * OpenCV or Vitis AI.
+ */
+
+#define DAEMON_MAGIC          0x59414c59u     // "YLAY"
+#define DAEMON_DEFAULT_SOCKET "/tmp/yolact.sock"
+#define DAEMON_MAX_PAYLOAD    4096
+#define DAEMON_MAX_DIM        16384           // Largest width & height of a raw frame
+
+/* Request types */
+enum
+{
+  REQ_IMAGE_PATH = 1,
+  REQ_RAW_FD,
+  REQ_SHM
+};
+
+/* Result formats */
+enum
+{
+  RESULT_BINARY = 0,
+  RESULT_JSON
+};
+
+/* Response status */
+enum
+{
+  STATUS_OK = 0,
+  STATUS_BAD_REQUEST,     // Malformed header or unknown request type
+  STATUS_INPUT_FAILED,    // Image file, fd or shared memory object can't be read
+  STATUS_SHUTTING_DOWN    // The daemon is stopping
+};
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t type;          // REQ_*
+  uint32_t format;        // RESULT_*
+  uint32_t width;         // Raw frames: image size in pixels
+  uint32_t height;
+  uint32_t stride;        // Raw frames: bytes per row (0 = width * 3)
+  uint64_t offset;        // Raw frames: byte offset of the first row
+  float    score_thresh;  // Detections below this score are not returned
+  uint32_t payload;       // Bytes following the header (path or shm name)
+} daemon_request_t;
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t status;        // STATUS_*
+  uint32_t count;         // Number of detections
+  uint32_t payload;       // Bytes following the header
+  uint64_t server_ns;     // Time from receiving the request to sending the response
+} daemon_response_t;
+
+/* Detection in pixels of the submitted image */
+typedef struct
+{
+  int32_t label;          // COCO class index (1 = person)
+  float   score;
+  int32_t x;
+  int32_t y;
+  int32_t w;
+  int32_t h;
+} daemon_detection_t;
+
+static inline bool daemon_write( int fd, const void *data, size_t size )
+{
+  const char *p = (const char *)data;
+  while (size > 0)
+  {
+    ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static inline bool daemon_read( int fd, void *data, size_t size )
+{
+  char *p = (char *)data;
+  while (size > 0)
+  {
+    ssize_t n = recv(fd, p, size, 0);
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+/* Connects to the daemon socket, returns the socket or -1 */
+static inline int daemon_connect( const std::string &path )
+{
+  sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path)) return -1;
+
+  int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock < 0) return -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+
+  if (connect(sock, (sockaddr *)&addr, sizeof(addr)) != 0)
+  {
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+/* Sends a request, pass_fd (if >= 0) is passed to the daemon with the header */
+static inline bool daemon_send_request( int sock, daemon_request_t req, const std::string &payload, int pass_fd = -1 )
+{
+  req.magic = DAEMON_MAGIC;
+  req.payload = payload.size();
+
+  iovec iov;
+  iov.iov_base = &req;
+  iov.iov_len = sizeof(req);
+
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  char control[CMSG_SPACE(sizeof(int))];
+  if (pass_fd >= 0)
+  {
+    memset(control, 0, sizeof(control));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &pass_fd, sizeof(int));
+  }
+
+  if (sendmsg(sock, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(req)) return false;
+  return daemon_write(sock, payload.data(), payload.size());
+}
+
+/* Receives a request header & payload, a passed file descriptor is returned in recv_fd (else -1) */
+static inline bool daemon_recv_request( int sock, daemon_request_t &req, std::string &payload, int &recv_fd )
+{
+  iovec iov;
+  iov.iov_base = &req;
+  iov.iov_len = sizeof(req);
+
+  char control[CMSG_SPACE(sizeof(int))];
+  msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  recv_fd = -1;
+  ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  if (n <= 0) return false;
+
+  for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+  {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    {
+      memcpy(&recv_fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+  }
+
+  /* The rest of a partially received header */
+  bool valid = daemon_read(sock, (char *)&req + n, sizeof(req) - n) &&
+               req.magic == DAEMON_MAGIC && req.payload <= DAEMON_MAX_PAYLOAD;
+  if (valid)
+  {
+    payload.resize(req.payload);
+    valid = daemon_read(sock, &payload[0], payload.size());
+  }
+
+  if (!valid && recv_fd >= 0)
+  {
+    close(recv_fd);
+    recv_fd = -1;
+  }
+  return valid;
+}
+
+static inline bool daemon_send_response( int sock, daemon_response_t resp, const void *payload )
+{
+  resp.magic = DAEMON_MAGIC;
+  return daemon_write(sock, &resp, sizeof(resp)) && daemon_write(sock, payload, resp.payload);
+}
+
+static inline bool daemon_recv_response( int sock, daemon_response_t &resp, std::string &payload )
+{
+  if (!daemon_read(sock, &resp, sizeof(resp)) || resp.magic != DAEMON_MAGIC) return false;
+
+  payload.resize(resp.payload);
+  return daemon_read(sock, &payload[0], payload.size());
+}
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _DEADLINE_QUEUE_HPP_
+#define _DEADLINE_QUEUE_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <tuple>
+
+#include "frame.hpp"
+#include "bounded_queue.hpp"
+
+/*
+ * Bounded frame queue that pops in priority order
+ *
+ * Frames are served by priority class first and earliest deadline first
+ * within a class; frames without a deadline come after those with one and
+ * equal frames keep their arrival order.  Used in front of the infer stage,
+ * a batch collects the most urgent frames, so higher priority work preempts
+ * bulk work at the next batch boundary.
+ */
+class deadline_queue : public blocking_queue<frame_t*>
+{
+  public:
+
+    deadline_queue( size_t capacity ) : capacity(capacity), closed(false), arrivals(0)
+    {
+      pushes = 0;
+      depth_sum = 0;
+      max_depth = 0;
+    }
+
+    bool push( frame_t *frame )
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+
+      if (closed)
+      {
+        return false;
+      }
+
+      insert(frame);
+
+      lock.unlock();
+      not_empty.notify_one();
+      return true;
+    }
+
+    bool pop( frame_t *&frame )
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      not_empty.wait(lock, [this] { return closed || !items.empty(); });
+      return take(lock, frame);
+    }
+
+    bool pop_until( frame_t *&frame, std::chrono::steady_clock::time_point deadline )
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      not_empty.wait_until(lock, deadline, [this] { return closed || !items.empty(); });
+      return take(lock, frame);
+    }
+
+    bool try_push( frame_t *const &frame )
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      if (closed || items.size() >= capacity)
+      {
+        return false;
+      }
+
+      insert(frame);
+
+      lock.unlock();
+      not_empty.notify_one();
+      return true;
+    }
+
+    bool try_pop( frame_t *&frame )
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      return take(lock, frame);
+    }
+
+    void close()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+      }
+      not_full.notify_all();
+      not_empty.notify_all();
+    }
+
+    size_t get_capacity() { return capacity; }
+    uint64_t get_pushes() { return pushes; }
+    size_t get_max_depth() { return max_depth; }
+    float avg_depth() { return (pushes == 0) ? 0.0f : (float)depth_sum / (float)pushes; }
+
+  private:
+
+    /* (priority, deadline, arrival) - frames without a deadline sort last within their class */
+    typedef std::tuple<int, uint64_t, uint64_t, frame_t*> entry_t;
+
+    std::mutex              mtx;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::set<entry_t>       items;
+    size_t                  capacity;
+    bool                    closed;
+    uint64_t                arrivals;
+
+    uint64_t                pushes;
+    uint64_t                depth_sum;
+    size_t                  max_depth;
+
+    /* Called with the lock held */
+    void insert( frame_t *frame )
+    {
+      uint64_t deadline = (frame->deadline_ns > 0) ? frame->deadline_ns : UINT64_MAX;
+      items.insert(entry_t(frame->priority, deadline, arrivals++, frame));
+
+      pushes++;
+      depth_sum += items.size();
+      if (items.size() > max_depth) max_depth = items.size();
+    }
+
+    /* Removes the most urgent frame, releases the lock */
+    bool take( std::unique_lock<std::mutex> &lock, frame_t *&frame )
+    {
+      if (items.empty())
+      {
+        return false;
+      }
+
+      frame = std::get<3>(*items.begin());
+      items.erase(items.begin());
+
+      lock.unlock();
+      not_full.notify_one();
+      return true;
+    }
+};
+
+#endif
@@ -0,0 +1,305 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _DECODE_HPP_
+#define _DECODE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Header files for OpenCV
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "frame.hpp"
+
+/*
+ * Reads the image dimensions from the SOF header of a JPEG file
+ */
+static inline bool jpeg_size( const uchar *data, size_t size, int &width, int &height )
+{
+  if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+  {
+    return false;
+  }
+
+  size_t pos = 2;
+  while (pos + 9 < size)
+  {
+    if (data[pos] != 0xFF)
+    {
+      pos++;
+      continue;
+    }
+
+    uchar marker = data[pos+1];
+
+    /* Fill bytes & markers without a payload */
+    if (marker == 0xFF || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8))
+    {
+      pos += (marker == 0xFF) ? 1 : 2;
+      continue;
+    }
+
+    /* SOFn markers (excluding DHT, JPG & DAC which share the range) hold the frame size */
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+    {
+      height = (data[pos+5] << 8) | data[pos+6];
+      width  = (data[pos+7] << 8) | data[pos+8];
+      return true;
+    }
+
+    pos += 2 + ((data[pos+2] << 8) | data[pos+3]);
+  }
+
+  return false;
+}
+
+/*
+ * Selects the cv::imdecode flag for the smallest DCT-scaled JPEG decode (1/2, 1/4 or 1/8)
+ * that is still at least min_size.  Returns the scale factor (1 = full decode).
+ */
+static inline int reduced_decode_flag( int width, int height, cv::Size min_size, int &flag )
+{
+  const int scales[3] = {8, 4, 2};
+  const int flags[3]  = {cv::IMREAD_REDUCED_COLOR_8, cv::IMREAD_REDUCED_COLOR_4, cv::IMREAD_REDUCED_COLOR_2};
+
+  for (int i = 0; i < 3; i++)
+  {
+    if (width / scales[i] >= min_size.width && height / scales[i] >= min_size.height)
+    {
+      flag = flags[i];
+      return scales[i];
+    }
+  }
+
+  flag = cv::IMREAD_COLOR;
+  return 1;
+}
+
+/*
+ * Decode time & decoded image memory, shared by the threads decoding a source
+ */
+class decode_stats
+{
+  public:
+
+    decode_stats() : images(0), decode_ns(0), image_bytes(0), full_images(0), reduced_images(0) {}
+
+    void record( uint64_t ns, const cv::Mat &image, int scale )
+    {
+      images++;
+      decode_ns += ns;
+      image_bytes += image.total() * image.elemSize();
+      if (scale > 1) reduced_images++; else full_images++;
+    }
+
+    void print()
+    {
+      char line[128];
+      uint64_t n = images;
+      if (n == 0) return;
+
+      sprintf(line, "Average decode time = %1.4f seconds, decoded image size = %1.2f MB",
+              (float)decode_ns / (float)n * 1e-9f, (float)image_bytes / (float)n / (1024.0f * 1024.0f));
+      std::cout << line << std::endl;
+      sprintf(line, "Decoded images: %llu full resolution, %llu reduced resolution",
+              (unsigned long long)full_images, (unsigned long long)reduced_images);
+      std::cout << line << std::endl;
+    }
+
+  private:
+
+    std::atomic<uint64_t> images;
+    std::atomic<uint64_t> decode_ns;
+    std::atomic<uint64_t> image_bytes;
+    std::atomic<uint64_t> full_images;
+    std::atomic<uint64_t> reduced_images;
+};
+
+/*
+ * Decodes in-memory image data into an existing cv::Mat (no new allocation as long as
+ * consecutive images have the same size).
+ *
+ * If min_size is not empty, JPEG images that are at least twice min_size are decoded at a
+ * reduced resolution by libjpeg's DCT scaling, which is several times faster & smaller than
+ * a full decode followed by a resize.  src_size returns the size of the original image, so
+ * normalized detections can still be mapped to original image coordinates.
+ */
+static inline bool decode_image_data( std::vector<uchar> &file_data,
+                                      cv::Mat            &image,
+                                      cv::Size            min_size,
+                                      cv::Size           &src_size,
+                                      decode_stats       *stats = nullptr )
+{
+  uint64_t t_start = frame_clock_ns();
+  int flag = cv::IMREAD_COLOR;
+  int scale = 1;
+  int width = 0, height = 0;
+
+  bool is_jpeg = jpeg_size(file_data.data(), file_data.size(), width, height);
+  if (is_jpeg && !min_size.empty())
+  {
+    scale = reduced_decode_flag(width, height, min_size, flag);
+  }
+
+  cv::Mat buf(1, (int)file_data.size(), CV_8UC1, file_data.data());
+  cv::imdecode(buf, flag, &image);
+
+  if (image.empty())
+  {
+    return false;
+  }
+
+  if (is_jpeg && scale > 1)
+  {
+    /* The EXIF orientation may have rotated the decoded image */
+    if ((image.cols > image.rows) != (width > height)) std::swap(width, height);
+    src_size = cv::Size(width, height);
+  }
+  else
+  {
+    src_size = image.size();
+  }
+
+  if (stats)
+  {
+    stats->record(frame_clock_ns() - t_start, image, scale);
+  }
+
+  return true;
+}
+
+/*
+ * Reads & decodes an image file into caller owned buffers.  Unlike cv::imread
+ * the decoded image is written into an existing cv::Mat, so no new image is
+ * allocated as long as consecutive images have the same size.
+ */
+static inline bool decode_image_file( const std::string    &file,
+                                      std::vector<uchar>   &file_data,
+                                      cv::Mat              &image,
+                                      cv::Size              min_size,
+                                      cv::Size             &src_size,
+                                      decode_stats         *stats = nullptr )
+{
+  std::ifstream in(file, std::ios::binary | std::ios::ate);
+  if (!in)
+  {
+    return false;
+  }
+
+  size_t size = in.tellg();
+  in.seekg(0);
+  file_data.resize(size);
+  if (!in.read((char *)file_data.data(), size))
+  {
+    return false;
+  }
+
+  return decode_image_data(file_data, image, min_size, src_size, stats);
+}
+
+static inline bool decode_image_file( const std::string    &file,
+                                      std::vector<uchar>   &file_data,
+                                      cv::Mat              &image )
+{
+  cv::Size src_size;
+  return decode_image_file(file, file_data, image, cv::Size(), src_size);
+}
+
+/*
+ * Converts a zero-copy input (RAW_*) into a BGR image owned by the frame
+ */
+static inline void convert_raw_frame( const cv::Mat &raw, int format, cv::Mat &image )
+{
+  switch (format)
+  {
+    case RAW_RGB:  cv::cvtColor(raw, image, cv::COLOR_RGB2BGR);       break;
+    case RAW_GRAY: cv::cvtColor(raw, image, cv::COLOR_GRAY2BGR);      break;
+    case RAW_NV12: cv::cvtColor(raw, image, cv::COLOR_YUV2BGR_NV12);  break;
+    case RAW_I420: cv::cvtColor(raw, image, cv::COLOR_YUV2BGR_I420);  break;
+    case RAW_YUYV: cv::cvtColor(raw, image, cv::COLOR_YUV2BGR_YUYV);  break;
+    default:       raw.copyTo(image);                                  break;
+  }
+}
+
+/*
+ * Scales a zero-copy input straight to a BGR image of the given size.  YUV
+ * inputs are scaled per plane (YUYV per Y0 U Y1 V pixel pair) & converted at
+ * the output size, so the preprocessing never converts the full resolution
+ * frame.  Planar inputs need an even output size, other layouts fall back to
+ * convert_raw_frame & resize.
+ */
+static inline void resize_raw_frame( const cv::Mat &raw, int format, cv::Size size, cv::Mat &image )
+{
+  bool even = (size.width % 2 == 0 && size.height % 2 == 0);
+  int height = (format == RAW_NV12 || format == RAW_I420) ? raw.rows * 2 / 3 : raw.rows;
+
+  if (format == RAW_NV12 && even)
+  {
+    cv::Mat yuv(size.height + size.height / 2, size.width, CV_8UC1);
+    cv::Mat y_out = yuv.rowRange(0, size.height);
+    cv::Mat uv_in(height / 2, raw.cols / 2, CV_8UC2, (void*)raw.ptr(height), raw.step);
+    cv::Mat uv_out(size.height / 2, size.width / 2, CV_8UC2, yuv.ptr(size.height));
+    cv::resize(raw.rowRange(0, height), y_out, size);
+    cv::resize(uv_in, uv_out, uv_out.size());
+    cv::cvtColor(yuv, image, cv::COLOR_YUV2BGR_NV12);
+  }
+  else if (format == RAW_I420 && even && raw.isContinuous())
+  {
+    cv::Mat yuv(size.height + size.height / 2, size.width, CV_8UC1);
+    cv::Mat y_out = yuv.rowRange(0, size.height);
+    cv::resize(raw.rowRange(0, height), y_out, size);
+
+    /* The U & V planes follow the Y plane with half the width & height each */
+    cv::Size chroma_in(raw.cols / 2, height / 2), chroma_out(size.width / 2, size.height / 2);
+    for (int p = 0; p < 2; p++)
+    {
+      cv::Mat plane_in(chroma_in, CV_8UC1, (void*)(raw.ptr(height) + p * chroma_in.area()));
+      cv::Mat plane_out(chroma_out, CV_8UC1, yuv.ptr(size.height) + p * chroma_out.area());
+      cv::resize(plane_in, plane_out, chroma_out);
+    }
+    cv::cvtColor(yuv, image, cv::COLOR_YUV2BGR_I420);
+  }
+  else if (format == RAW_YUYV && size.width % 2 == 0 && raw.cols % 2 == 0)
+  {
+    cv::Mat pairs_in(raw.rows, raw.cols / 2, CV_8UC4, (void*)raw.data, raw.step);
+    cv::Mat pairs_out(size.height, size.width / 2, CV_8UC4);
+    cv::resize(pairs_in, pairs_out, pairs_out.size());
+    cv::cvtColor(cv::Mat(size, CV_8UC2, pairs_out.data), image, cv::COLOR_YUV2BGR_YUYV);
+  }
+  else if (format == RAW_BGR || format == RAW_RGB || format == RAW_GRAY)
+  {
+    cv::Mat scaled;
+    cv::resize(raw, (format == RAW_BGR) ? image : scaled, size);
+    if (format == RAW_RGB) cv::cvtColor(scaled, image, cv::COLOR_RGB2BGR);
+    if (format == RAW_GRAY) cv::cvtColor(scaled, image, cv::COLOR_GRAY2BGR);
+  }
+  else
+  {
+    cv::Mat converted;
+    convert_raw_frame(raw, format, converted);
+    cv::resize(converted, image, size);
+  }
+}
+
+#endif
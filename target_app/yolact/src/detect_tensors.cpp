@@ -0,0 +1,190 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Runs the C++ post-processing on recorded output tensors
+ *
+ * Loads the tensors saved by yolact.exe --dump_tensors, runs the detection &
+ * mask drawing of yolact.hpp on them and saves the results of every frame
+ * next to its name in the output directory:
+ *   <name>_cpp_det.npy     N x 6: label, score, x1, y1, x2, y2 (normalized)
+ *   <name>_cpp_coef.npy    N x PROTO_C mask coefficients
+ *   <name>_cpp_labels.npy  H x W label mask of --image size (detection index + 1, 0 = background)
+ * golden_detect.py (repository root) compares them against Detect of
+ * layers/functions/detection.py on the same tensors.
+ *
+ * Builds with yolact.hpp's YOLACT_NO_VITIS (OpenCV only), build with build.sh or:
+ *   g++ -std=c++17 -O3 -DYOLACT_NO_VITIS -Isrc src/detect_tensors.cpp -o detect_tensors.exe \
+ *       -lopencv_core -lopencv_imgproc -lpthread
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "yolact.hpp"
+#include "tensor_recording.hpp"
+
+using namespace std;
+
+void print_usage()
+{
+  cout << "Usage: ./detect_tensors.exe [options] --tensors <directory> --output <directory>" << endl;
+  cout << endl;
+  cout << "  options:" << endl;
+
+  cout << "  --tensors <directory>" << endl;
+  cout << "      Output tensors recorded with yolact.exe --dump_tensors" << endl;
+
+  cout << "  --output <directory>" << endl;
+  cout << "      Directory the results are saved to" << endl;
+
+  cout << "  --image WxH" << endl;
+  cout << "      Size of the label masks (default = 550x550)" << endl;
+
+  cout << "  --score_thresh N" << endl;
+  cout << "      Only draws the masks of detections scoring at least N (default = 0.5)" << endl;
+
+  cout << "  --nms_conf_thresh N" << endl;
+  cout << "      Confidence threshold of the candidates (default = " << NMS_CONF_THRESH << ")" << endl;
+
+  cout << "  --nms_thresh N" << endl;
+  cout << "      IoU threshold of the NMS (default = " << NMS_THRESH << ")" << endl;
+
+  cout << "  --max_frames N" << endl;
+  cout << "      Only processes the first N recorded frames" << endl;
+  cout << endl;
+}
+
+int main( int argc, char *argv[] )
+{
+  string tensor_dir, output_dir;
+  cv::Size image_size(550, 550);
+  float score_thresh = 0.5f;
+  float nms_conf_thresh = -1.0f;
+  float nms_thresh = -1.0f;
+  int max_frames = 0;
+
+  for (int i = 1; i < argc; i += 2)
+  {
+    if (i+1 >= argc)
+    {
+      print_usage();
+      return -1;
+    }
+
+    if (!strcmp(argv[i], "--tensors"))               tensor_dir = argv[i+1];
+    else if (!strcmp(argv[i], "--output"))           output_dir = argv[i+1];
+    else if (!strcmp(argv[i], "--score_thresh"))     score_thresh = atof(argv[i+1]);
+    else if (!strcmp(argv[i], "--nms_conf_thresh"))  nms_conf_thresh = atof(argv[i+1]);
+    else if (!strcmp(argv[i], "--nms_thresh"))       nms_thresh = atof(argv[i+1]);
+    else if (!strcmp(argv[i], "--max_frames"))       max_frames = atoi(argv[i+1]);
+    else if (!strcmp(argv[i], "--image"))
+    {
+      if (sscanf(argv[i+1], "%dx%d", &image_size.width, &image_size.height) != 2 || image_size.width < 1 ||
+          image_size.height < 1)
+      {
+        cout << "ERROR: the image size must be given as WxH" << endl;
+        return -1;
+      }
+    }
+    else
+    {
+      print_usage();
+      return -1;
+    }
+  }
+
+  if (tensor_dir.empty() || output_dir.empty())
+  {
+    print_usage();
+    return -1;
+  }
+
+  vector<string> bases;
+  string error;
+  if (!list_frame_tensors(tensor_dir, bases, error))
+  {
+    cout << "ERROR: " << error << endl;
+    return -1;
+  }
+  if (max_frames > 0 && (int)bases.size() > max_frames) bases.resize(max_frames);
+
+  std::error_code ec;
+  std::filesystem::create_directories(output_dir, ec);
+  if (!std::filesystem::is_directory(output_dir, ec))
+  {
+    cout << "ERROR: unable to create output directory " << output_dir << endl;
+    return -1;
+  }
+
+  /* The model constants without a DPU */
+  yolact model;
+  model.create_host(1, cv::Size(550, 550), 0);
+  model.set_thresholds(nms_conf_thresh, nms_thresh);
+
+  frame_t frame;
+  uint64_t num_det = 0;
+  for (auto &base : bases)
+  {
+    if (!load_frame_tensors(base, frame, error))
+    {
+      cout << "ERROR: " << error << endl;
+      return -1;
+    }
+
+    model.postprocess(frame);
+
+    frame.image = cv::Mat::zeros(image_size, CV_8UC3);
+    model.create_overlays(frame, score_thresh, true);
+
+    size_t n = frame.boxes.size();
+    vector<float> det, coef, labels(image_size.area());
+    for (size_t d = 0; d < n; d++)
+    {
+      const box_t &box = frame.boxes[d];
+      float values[6] = { (float)box.label, box.score, box.x, box.y, box.x + box.w, box.y + box.h };
+      det.insert(det.end(), values, values + 6);
+      coef.insert(coef.end(), frame.masks[d].begin(), frame.masks[d].end());
+    }
+    for (int y = 0; y < image_size.height; y++)
+    {
+      for (int x = 0; x < image_size.width; x++)
+      {
+        labels[y * image_size.width + x] = frame.label_mask.at<uchar>(y, x);
+      }
+    }
+
+    string name = output_dir + "/" + std::filesystem::path(base).filename().string();
+    if (!npy_write(name + "_cpp_det.npy", det.data(), {n, 6}) ||
+        !npy_write(name + "_cpp_coef.npy", coef.data(), {n, PROTO_C}) ||
+        !npy_write(name + "_cpp_labels.npy", labels.data(), {(size_t)image_size.height, (size_t)image_size.width}))
+    {
+      cout << "ERROR: unable to write the results of " << base << " to " << output_dir << endl;
+      return -1;
+    }
+    num_det += n;
+  }
+
+  cout << "Processed " << bases.size() << " frames, " << num_det << " detections" << endl;
+  return 0;
+}
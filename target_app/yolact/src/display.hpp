@@ -0,0 +1,194 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _DISPLAY_HPP_
+#define _DISPLAY_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Header files for OpenCV
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+#include "frame.hpp"
+
+/*
+ * Real-time display running on its own thread
+ *
+ * The sink hands every completed frame to submit(), which only copies the
+ * image into a single "latest frame" slot, overwriting a frame that hasn't
+ * been shown yet.  The display thread wakes up at the refresh rate and shows
+ * the newest frame with a HUD of the pipeline throughput & end-to-end latency
+ * (taken from the frame time stamps), so a slow display drops stale frames
+ * instead of back-pressuring inference.  All highgui calls are made from the
+ * display thread.  Multiplexed streams get one slot & window per stream.
+ */
+class display_thread
+{
+  public:
+
+    display_thread( const std::string &window, float refresh_hz, int num_streams = 1 ) : running(true), slots(num_streams)
+    {
+      period_ns = (uint64_t)(1e9f / std::max(refresh_hz, 1.0f));
+
+      for (int st = 0; st < num_streams; st++)
+      {
+        slots[st].window = (num_streams > 1) ? window + " " + std::to_string(st) : window;
+      }
+
+      thread = std::thread(&display_thread::display_loop, this);
+    }
+
+    ~display_thread() { stop(); }
+
+    /* Offers a completed frame for display, never blocks on the display */
+    void submit( const frame_t &frame )
+    {
+      uint64_t now = frame_clock_ns();
+      slot_t &slot = slots[(frame.stream < (int)slots.size()) ? frame.stream : 0];
+      std::lock_guard<std::mutex> lock(mtx);
+
+      frame.image.copyTo(slot.latest);
+      slot.fresh = true;
+      slot.submitted++;
+
+      /* Smoothed pipeline output rate & end-to-end latency */
+      if (slot.last_submit_ns > 0 && now > slot.last_submit_ns)
+      {
+        float inst_fps = 1e9f / (float)(now - slot.last_submit_ns);
+        slot.fps = (slot.fps == 0.0f) ? inst_fps : (0.9f * slot.fps + 0.1f * inst_fps);
+      }
+      float inst_latency = (float)(now - frame.t_start) * 1e-6f;
+      slot.latency_ms = (slot.latency_ms == 0.0f) ? inst_latency : (0.9f * slot.latency_ms + 0.1f * inst_latency);
+      slot.last_submit_ns = now;
+    }
+
+    /* Stops the display thread, the last frame stays on screen until the window is closed */
+    void stop()
+    {
+      if (!thread.joinable()) return;
+
+      running = false;
+      thread.join();
+    }
+
+    void print_stats()
+    {
+      char line[128];
+      uint64_t submitted = 0, shown = 0;
+      for (auto &slot : slots)
+      {
+        submitted += slot.submitted;
+        shown += slot.shown;
+      }
+
+      sprintf(line, "Display: %llu frames shown, %llu stale frames dropped",
+              (unsigned long long)shown, (unsigned long long)(submitted - shown));
+      std::cout << line << std::endl;
+    }
+
+  private:
+
+    /* Latest frame of a stream, protected by mtx */
+    typedef struct
+    {
+      std::string     window;
+      cv::Mat         latest;
+      bool            fresh = false;
+      uint64_t        submitted = 0;
+      uint64_t        shown = 0;
+      uint64_t        last_submit_ns = 0;
+      float           fps = 0.0f;
+      float           latency_ms = 0.0f;
+      cv::Mat         showing;   // Owned by the display thread
+    } slot_t;
+
+    std::thread         thread;
+    std::atomic<bool>   running;
+    uint64_t            period_ns;
+    std::mutex          mtx;
+    std::vector<slot_t> slots;
+
+    void display_loop()
+    {
+      auto next_tick = std::chrono::steady_clock::now();
+
+      while (running)
+      {
+        for (auto &slot : slots)
+        {
+          bool show = false;
+          float hud_fps, hud_latency;
+          uint64_t hud_dropped;
+
+          {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (slot.fresh)
+            {
+              cv::swap(slot.latest, slot.showing);
+              slot.fresh = false;
+              show = true;
+              slot.shown++;
+            }
+            hud_fps = slot.fps;
+            hud_latency = slot.latency_ms;
+            hud_dropped = slot.submitted - slot.shown;
+          }
+
+          if (show)
+          {
+            draw_hud(slot.showing, hud_fps, hud_latency, hud_dropped);
+            cv::imshow(slot.window, slot.showing);
+          }
+        }
+
+        /* Services the window events, the frame pacing is done by sleeping until the next refresh */
+        cv::waitKey(1);
+
+        next_tick += std::chrono::nanoseconds(period_ns);
+        auto now = std::chrono::steady_clock::now();
+        if (next_tick < now)
+        {
+          next_tick = now;
+        }
+        std::this_thread::sleep_until(next_tick);
+      }
+    }
+
+    static void draw_hud( cv::Mat &img, float fps, float latency_ms, uint64_t dropped )
+    {
+      char hud[96];
+      sprintf(hud, "%.1f FPS  latency %.0f ms  dropped %llu", fps, latency_ms, (unsigned long long)dropped);
+
+      int baseline = 0;
+      cv::Size txt_size = cv::getTextSize(hud, cv::FONT_HERSHEY_DUPLEX, 0.6, 1, &baseline);
+      cv::rectangle(img, cv::Point(0, 0), cv::Point(txt_size.width + 8, txt_size.height + 10),
+                    cv::Scalar(0, 0, 0), cv::FILLED);
+      cv::putText(img, hud, cv::Point(4, txt_size.height + 4), cv::FONT_HERSHEY_DUPLEX, 0.6,
+                  cv::Scalar(255, 255, 255), 1, cv::LINE_AA);
+    }
+};
+
+#endif
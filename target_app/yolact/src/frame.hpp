@@ -0,0 +1,121 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FRAME_HPP_
+#define _FRAME_HPP_
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// Header files for OpenCV
+#include <opencv2/core.hpp>
+
+/* Detection result (normalized x-y corner, width & height) */
+typedef struct
+{
+  int   label;
+  float score;
+  float x;
+  float y;
+  float w;
+  float h;
+} box_t;
+
+/* Priority classes of frames, served in this order */
+enum
+{
+  PRIORITY_REALTIME = 0,
+  PRIORITY_NORMAL,
+  PRIORITY_BULK,
+  NUM_PRIORITIES
+};
+
+static const char *priority_names[NUM_PRIORITIES] =
+{
+  "realtime", "normal", "bulk"
+};
+
+/* Pixel formats of zero-copy inputs, converted to BGR by the preprocess stage */
+enum
+{
+  RAW_NONE = 0,   // The input is in image
+  RAW_BGR,        // Packed BGR8
+  RAW_RGB,        // Packed RGB8
+  RAW_GRAY,       // 8-bit luma
+  RAW_NV12,       // Y plane followed by the interleaved UV plane (height * 3/2 rows)
+  RAW_I420,       // Y, U & V planes (height * 3/2 rows)
+  RAW_YUYV        // Packed 4:2:2 Y0 U Y1 V (2 channels)
+};
+
+class frame_source;
+
+/*
+ * Unit of work passed between the processing stages.
+ *
+ * A frame owns everything needed to process one image independently of the
+ * model context that executes it: the source image, the quantized input
+ * tensor and a host copy of the output tensors.  This allows the CPU stages
+ * to run on any thread while the DPU works on the next batch.
+ */
+typedef struct
+{
+  int                             stream;     // Input stream index (0 unless several streams are multiplexed)
+  uint64_t                        seq;        // Input sequence number (per stream)
+  std::string                     name;       // Source name (file name, device, ...)
+  cv::Mat                         image;      // Input image, overlays are drawn in place
+  cv::Size                        src_size;   // Size of the original image (larger than image after a reduced decode)
+  cv::Mat                         resized;    // Image resized to the input tensor size
+  std::vector<uchar>              file_data;  // Encoded image data
+
+  std::vector<int8_t>             input;      // Quantized input tensor (HxWx3)
+  std::vector<float>              loc;        // NUM_PRIORS x 4
+  std::vector<float>              conf;       // NUM_PRIORS x NUM_CLASSES
+  std::vector<float>              mask;       // NUM_PRIORS x PROTO_C
+  std::vector<float>              proto;      // PROTO_HW x PROTO_HW x PROTO_C
+
+  std::vector<box_t>              boxes;      // Detections sorted by score
+  std::vector<std::vector<float>> masks;      // Mask coefficients for each detection
+  cv::Mat                         label_mask; // Optional per-pixel detection index (0 = background)
+
+  uint64_t                        t_start;    // Time the frame entered the pipeline (ns)
+  int                             priority;   // Priority class (PRIORITY_*)
+  uint64_t                        deadline_ns;// Time the result is due (ns, 0 = no deadline)
+
+  cv::Mat                         raw;        // Zero-copy view of the input buffer owned by raw_source
+  int                             raw_format; // Format of raw (RAW_NONE = no zero-copy input)
+  frame_source                   *raw_source; // Source the buffer is handed back to after preprocessing
+  uint64_t                        raw_tag;    // Buffer identifier of the source
+} frame_t;
+
+/* Maps a normalized detection to pixel coordinates of the original image */
+static inline cv::Rect box_to_source_rect( const frame_t &frame, const box_t &box )
+{
+  cv::Size size = frame.src_size.empty() ? frame.image.size() : frame.src_size;
+  return cv::Rect(cv::Point((int)(box.x * size.width), (int)(box.y * size.height)),
+                  cv::Point((int)((box.x + box.w) * size.width), (int)((box.y + box.h) * size.height)));
+}
+
+/* Monotonic time in nanoseconds used for frame time stamps */
+static inline uint64_t frame_clock_ns()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+#endif
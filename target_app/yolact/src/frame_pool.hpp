@@ -0,0 +1,91 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FRAME_POOL_HPP_
+#define _FRAME_POOL_HPP_
+
+#include <vector>
+
+#include "frame.hpp"
+#include "bounded_queue.hpp"
+
+/*
+ * Fixed-size pool of recycled frames
+ *
+ * All frames & their tensor buffers are allocated up front.  The pipeline
+ * acquires a frame at the decode stage and releases it after the sink, so
+ * the number of frames in flight is bounded by the pool size and the hot
+ * path performs no heap allocation once the image buffers have reached
+ * their steady-state size.
+ */
+class frame_pool
+{
+  public:
+
+    frame_pool( size_t num_frames,
+                size_t input_size,
+                size_t loc_size,
+                size_t conf_size,
+                size_t mask_size,
+                size_t proto_size ) : frames(num_frames), free_frames(num_frames)
+    {
+      for (auto &frame : frames)
+      {
+        frame.input.resize(input_size);
+        frame.loc.resize(loc_size);
+        frame.conf.resize(conf_size);
+        frame.mask.resize(mask_size);
+        frame.proto.resize(proto_size);
+        frame.priority = PRIORITY_NORMAL;
+        frame.raw_format = RAW_NONE;
+        free_frames.push(&frame);
+      }
+    }
+
+    /* Blocks until a frame is available, returns nullptr once the pool is closed */
+    frame_t *acquire()
+    {
+      frame_t *frame = nullptr;
+      if (!free_frames.pop(frame)) return nullptr;
+      return frame;
+    }
+
+    /* Non-blocking acquire, returns nullptr if all frames are in use */
+    frame_t *try_acquire()
+    {
+      frame_t *frame = nullptr;
+      if (!free_frames.try_pop(frame)) return nullptr;
+      return frame;
+    }
+
+    void release( frame_t *frame )
+    {
+      frame->boxes.clear();
+      frame->masks.clear();
+      free_frames.push(frame);
+    }
+
+    void close() { free_frames.close(); }
+
+    size_t size() { return frames.size(); }
+
+  private:
+
+    std::vector<frame_t>     frames;
+    bounded_queue<frame_t*>  free_frames;
+};
+
+#endif
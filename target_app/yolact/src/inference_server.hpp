@@ -0,0 +1,411 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _INFERENCE_SERVER_HPP_
+#define _INFERENCE_SERVER_HPP_
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Header files for OpenCV
+#include <opencv2/core.hpp>
+
+#include "daemon_protocol.hpp"
+#include "pipeline.hpp"
+#include "decode.hpp"
+#include "bounded_queue.hpp"
+
+/* Set by SIGINT/SIGTERM, stops the daemon */
+static volatile sig_atomic_t daemon_stop_requested = 0;
+
+static void daemon_signal_handler( int )
+{
+  daemon_stop_requested = 1;
+}
+
+/*
+ * Persistent inference daemon
+ *
+ * Keeps the model contexts loaded & a pipeline running, and serves requests
+ * from clients of a Unix domain socket (see daemon_protocol.hpp), so a
+ * request only pays for its own inference instead of the xmodel load &
+ * runner creation of a new process.  Every connection is served by its own
+ * thread, which reads the image (file, passed fd or shared memory) and
+ * waits for the result; requests of all connections share the DPU batches.
+ * SIGINT or SIGTERM stops accepting connections, finishes the requests
+ * already received and returns from run().
+ */
+class inference_server
+{
+  public:
+
+    inference_server( const std::string &path, yolact *models, pipeline_config_t &config ) : path(path), models(models),
+                                                                                            config(config),
+                                                                                            requests(config.queue_depth)
+    {
+      listen_fd = -1;
+      next_seq = 0;
+      served = 0;
+      failed = 0;
+      service_ns = 0;
+    }
+
+    ~inference_server()
+    {
+      if (listen_fd >= 0)
+      {
+        close(listen_fd);
+        unlink(path.c_str());
+      }
+    }
+
+    /* Binds the socket, a stale socket file of a previous daemon is replaced */
+    bool listen()
+    {
+      sockaddr_un addr;
+      if (path.size() >= sizeof(addr.sun_path))
+      {
+        std::cout << "ERROR: socket path " << path << " is too long" << std::endl;
+        return false;
+      }
+
+      if (daemon_connect(path) >= 0)
+      {
+        std::cout << "ERROR: a daemon is already serving " << path << std::endl;
+        return false;
+      }
+      unlink(path.c_str());
+
+      listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      strcpy(addr.sun_path, path.c_str());
+
+      if (listen_fd < 0 || bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(listen_fd, 64) != 0)
+      {
+        std::cout << "ERROR: unable to listen on " << path << ": " << strerror(errno) << std::endl;
+        return false;
+      }
+      return true;
+    }
+
+    /* Serves requests until SIGINT/SIGTERM */
+    void run()
+    {
+      signal(SIGINT, daemon_signal_handler);
+      signal(SIGTERM, daemon_signal_handler);
+
+      std::thread acceptor(&inference_server::accept_loop, this);
+
+      pipe.reset(new pipeline(models, config));
+      pipe->run([this](frame_t &frame) { return read_request(frame); },
+                [this](frame_t &frame) { complete_request(frame); });
+
+      acceptor.join();
+    }
+
+    /* Prints the request statistics, and with verbose the statistics of the pipeline */
+    void print_stats( bool verbose )
+    {
+      char line[128];
+      uint64_t n = served;
+
+      sprintf(line, "Daemon: %llu requests served, %llu failed, average service time %.2f ms",
+              (unsigned long long)n, (unsigned long long)failed,
+              (n > 0) ? (float)service_ns * 1e-6f / (float)n : 0.0f);
+      std::cout << line << std::endl;
+
+      if (verbose && pipe) pipe->print_stats();
+    }
+
+  private:
+
+    typedef struct
+    {
+      daemon_request_t                 hdr;
+      cv::Mat                          image;
+      std::string                      name;
+      std::vector<daemon_detection_t>  detections;
+      std::promise<void>               done;
+    } request_t;
+
+    std::string                   path;
+    yolact                       *models;
+    pipeline_config_t             config;
+    int                           listen_fd;
+    std::unique_ptr<pipeline>     pipe;
+
+    bounded_queue<request_t*>     requests;
+    std::mutex                    mtx;
+    std::map<uint64_t, request_t*> inflight;
+    uint64_t                      next_seq;
+
+    std::mutex                    clients_mtx;
+    std::map<int, std::thread>    clients;
+    std::vector<int>              finished;     // Connections whose thread has returned
+
+    std::atomic<uint64_t>         served;
+    std::atomic<uint64_t>         failed;
+    std::atomic<uint64_t>         service_ns;
+
+    void accept_loop()
+    {
+      pollfd pfd = { listen_fd, POLLIN, 0 };
+
+      while (!daemon_stop_requested)
+      {
+        reap_clients();
+        if (poll(&pfd, 1, 200) <= 0) continue;
+
+        int sock = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (sock < 0) continue;
+
+        std::lock_guard<std::mutex> lock(clients_mtx);
+        clients[sock] = std::thread(&inference_server::client_loop, this, sock);
+      }
+
+      /* Stop reading new requests, the requests in flight are still answered */
+      {
+        std::lock_guard<std::mutex> lock(clients_mtx);
+        for (auto &client : clients)
+        {
+          shutdown(client.first, SHUT_RD);
+        }
+      }
+      for (auto &client : clients)
+      {
+        client.second.join();
+        close(client.first);
+      }
+
+      requests.close();
+    }
+
+    /* Joins the threads of closed connections & releases their sockets */
+    void reap_clients()
+    {
+      std::lock_guard<std::mutex> lock(clients_mtx);
+
+      for (int sock : finished)
+      {
+        clients[sock].join();
+        clients.erase(sock);
+        close(sock);
+      }
+      finished.clear();
+    }
+
+    void client_loop( int sock )
+    {
+      request_t req;
+      std::string payload;
+      int fd;
+
+      while (daemon_recv_request(sock, req.hdr, payload, fd))
+      {
+        uint64_t t_start = frame_clock_ns();
+        daemon_response_t resp = { 0, STATUS_OK, 0, 0, 0 };
+        std::string json;
+
+        resp.status = read_input(req, payload, fd);
+        if (fd >= 0) close(fd);
+
+        if (resp.status == STATUS_OK)
+        {
+          req.done = std::promise<void>();
+          std::future<void> result = req.done.get_future();
+          request_t *p = &req;
+
+          if (requests.push(p))
+          {
+            result.wait();
+          }
+          else
+          {
+            resp.status = STATUS_SHUTTING_DOWN;
+          }
+        }
+
+        const void *data = nullptr;
+        if (resp.status == STATUS_OK)
+        {
+          resp.count = req.detections.size();
+          if (req.hdr.format == RESULT_JSON)
+          {
+            json = to_json(req);
+            data = json.data();
+            resp.payload = json.size();
+          }
+          else
+          {
+            data = req.detections.data();
+            resp.payload = req.detections.size() * sizeof(daemon_detection_t);
+          }
+          served++;
+        }
+        else
+        {
+          failed++;
+        }
+
+        resp.server_ns = frame_clock_ns() - t_start;
+        service_ns += resp.server_ns;
+        if (!daemon_send_response(sock, resp, data)) break;
+      }
+
+      std::lock_guard<std::mutex> lock(clients_mtx);
+      finished.push_back(sock);
+    }
+
+    /* Reads the image of a request into req.image */
+    uint32_t read_input( request_t &req, const std::string &payload, int fd )
+    {
+      daemon_request_t &hdr = req.hdr;
+      req.name = (hdr.type == REQ_IMAGE_PATH) ? payload : std::string();
+
+      switch (hdr.type)
+      {
+        case REQ_IMAGE_PATH:
+        {
+          std::vector<uchar> file_data;
+          return decode_image_file(payload, file_data, req.image) ? STATUS_OK : STATUS_INPUT_FAILED;
+        }
+
+        case REQ_RAW_FD:
+          if (fd < 0) return STATUS_BAD_REQUEST;
+          return map_raw_frame(fd, req) ? STATUS_OK : STATUS_INPUT_FAILED;
+
+        case REQ_SHM:
+        {
+          int shm_fd = shm_open(payload.c_str(), O_RDONLY, 0);
+          if (shm_fd < 0) return STATUS_INPUT_FAILED;
+          bool valid = map_raw_frame(shm_fd, req);
+          close(shm_fd);
+          return valid ? STATUS_OK : STATUS_INPUT_FAILED;
+        }
+
+        default:
+          return STATUS_BAD_REQUEST;
+      }
+    }
+
+    /* Copies a BGR8 frame out of a file descriptor.  The geometry comes from the client, so the frame
+     * must fit the file without any of the size computations overflowing.
+     */
+    static bool map_raw_frame( int fd, request_t &req )
+    {
+      daemon_request_t &hdr = req.hdr;
+      size_t stride = (hdr.stride > 0) ? hdr.stride : (size_t)hdr.width * 3;
+      struct stat st;
+
+      if (hdr.width == 0 || hdr.height == 0 || hdr.width > DAEMON_MAX_DIM || hdr.height > DAEMON_MAX_DIM ||
+          stride < (size_t)hdr.width * 3 || fstat(fd, &st) != 0 || st.st_size <= 0)
+      {
+        return false;
+      }
+
+      size_t file_size = (size_t)st.st_size;
+      if (hdr.offset > file_size || stride > (file_size - hdr.offset) / hdr.height)
+      {
+        return false;
+      }
+      size_t size = hdr.offset + stride * hdr.height;
+
+      void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED) return false;
+
+      cv::Mat(hdr.height, hdr.width, CV_8UC3, (char *)data + hdr.offset, stride).copyTo(req.image);
+      munmap(data, size);
+      return true;
+    }
+
+    /* Pipeline source: the next request of any client */
+    bool read_request( frame_t &frame )
+    {
+      request_t *req;
+      if (!requests.pop(req)) return false;
+
+      std::lock_guard<std::mutex> lock(mtx);
+      frame.seq = next_seq++;
+      frame.name = req->name;
+      frame.image = req->image;
+      frame.src_size = cv::Size();
+      inflight[frame.seq] = req;
+      return true;
+    }
+
+    /* Pipeline sink: hands the detections back to the waiting client thread */
+    void complete_request( frame_t &frame )
+    {
+      request_t *req;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = inflight.find(frame.seq);
+        req = it->second;
+        inflight.erase(it);
+      }
+
+      req->detections.clear();
+      for (auto &box : frame.boxes)
+      {
+        if (box.score < req->hdr.score_thresh) continue;
+
+        cv::Rect rect = box_to_source_rect(frame, box);
+        req->detections.push_back(daemon_detection_t{box.label, box.score, rect.x, rect.y, rect.width, rect.height});
+      }
+
+      req->done.set_value();
+    }
+
+    static std::string to_json( const request_t &req )
+    {
+      std::string json;
+      char item[192];
+
+      sprintf(item, "{\"width\":%d,\"height\":%d,\"detections\":[", req.image.cols, req.image.rows);
+      json = item;
+
+      for (size_t d = 0; d < req.detections.size(); d++)
+      {
+        const daemon_detection_t &det = req.detections[d];
+        const char *label = (det.label >= 0 && det.label < 81) ? coco_labels[det.label].c_str() : "";
+
+        sprintf(item, "%s{\"label\":\"%s\",\"class\":%d,\"score\":%.4f,\"box\":[%d,%d,%d,%d]}",
+                (d > 0) ? "," : "", label, det.label, det.score, det.x, det.y, det.w, det.h);
+        json += item;
+      }
+
+      json += "]}";
+      return json;
+    }
+};
+
+#endif
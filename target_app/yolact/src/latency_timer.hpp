@@ -0,0 +1,270 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LATENCY_TIMER_HPP_
+#define _LATENCY_TIMER_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Low-overhead interval timing
+ *
+ * fast_clock_ticks() reads the raw counter of the CPU (the ARM generic timer
+ * on the MPSoC devices, the invariant TSC on x86) without a system call; the
+ * tick length is read from the counter frequency register or calibrated
+ * against CLOCK_MONOTONIC once per process.  Other architectures fall back to
+ * the vDSO CLOCK_MONOTONIC.  Ticks are only converted to nanoseconds when an
+ * interval is recorded, so start() & stop() together cost a few tens of ns.
+ */
+static inline uint64_t fast_clock_ticks()
+{
+#if defined(__aarch64__)
+  uint64_t t;
+  asm volatile("isb; mrs %0, cntvct_el0" : "=r"(t) : : "memory");
+  return t;
+#elif defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+#endif
+}
+
+/* Nanoseconds per fast_clock_ticks() tick */
+static inline double fast_clock_ns_per_tick()
+{
+  static const double ns_per_tick = []
+  {
+#if defined(__aarch64__)
+    uint64_t freq;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+    return 1e9 / (double)freq;
+#elif defined(__x86_64__) || defined(__i386__)
+    /* Counts TSC ticks over 20 ms of CLOCK_MONOTONIC */
+    timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t c0 = __rdtsc();
+    do
+    {
+      clock_gettime(CLOCK_MONOTONIC, &t1);
+    } while ((t1.tv_sec - t0.tv_sec) * 1000000000ll + (t1.tv_nsec - t0.tv_nsec) < 20000000ll);
+    uint64_t c1 = __rdtsc();
+    double ns = (double)((t1.tv_sec - t0.tv_sec) * 1000000000ll + (t1.tv_nsec - t0.tv_nsec));
+    return ns / (double)(c1 - c0);
+#else
+    return 1.0;
+#endif
+  }();
+
+  return ns_per_tick;
+}
+
+/*
+ * Log-linear latency histogram (HdrHistogram style)
+ *
+ * Values below 64 ns get a bucket each, above that every power of two is
+ * split into 64 linear sub-buckets, so any recorded value is known to
+ * within 1.6% from 64 ns up to 2^47 ns (39 hours) in 22 KB.  Recording is a
+ * few arithmetic instructions and an increment; an instance is meant to be
+ * written by a single thread, histograms of several threads are combined
+ * with merge() once they are done.
+ */
+class latency_histogram
+{
+  public:
+
+    latency_histogram() : counts(NUM_BUCKETS, 0) { reset(); }
+
+    void reset()
+    {
+      std::fill(counts.begin(), counts.end(), 0);
+      count = 0;
+      min_ns = UINT64_MAX;
+      max_ns = 0;
+      sum = 0.0;
+      sum_sq = 0.0;
+    }
+
+    void record( uint64_t ns )
+    {
+      counts[bucket(ns)]++;
+      count++;
+      if (ns < min_ns) min_ns = ns;
+      if (ns > max_ns) max_ns = ns;
+      sum += (double)ns;
+      sum_sq += (double)ns * (double)ns;
+    }
+
+    void merge( const latency_histogram &other )
+    {
+      for (int b = 0; b < NUM_BUCKETS; b++)
+      {
+        counts[b] += other.counts[b];
+      }
+      count += other.count;
+      min_ns = std::min(min_ns, other.min_ns);
+      max_ns = std::max(max_ns, other.max_ns);
+      sum += other.sum;
+      sum_sq += other.sum_sq;
+    }
+
+    uint64_t get_count() const { return count; }
+    uint64_t get_min() const { return (count > 0) ? min_ns : 0; }
+    uint64_t get_max() const { return max_ns; }
+    double get_mean() const { return (count > 0) ? sum / (double)count : 0.0; }
+
+    double get_stddev() const
+    {
+      if (count == 0) return 0.0;
+      double mean = get_mean();
+      return std::sqrt(std::max(sum_sq / (double)count - mean * mean, 0.0));
+    }
+
+    /* Value at or below which pct percent of the samples fall, to within the bucket resolution */
+    uint64_t get_percentile( double pct ) const
+    {
+      if (count == 0) return 0;
+
+      uint64_t rank = (uint64_t)std::ceil(pct / 100.0 * (double)count);
+      rank = std::min(std::max(rank, (uint64_t)1), count);
+
+      uint64_t seen = 0;
+      for (int b = 0; b < NUM_BUCKETS; b++)
+      {
+        seen += counts[b];
+        if (seen >= rank)
+        {
+          /* Midpoint of the bucket, never outside the recorded range */
+          uint64_t mid = bucket_low(b) + (bucket_width(b) - 1) / 2;
+          return std::min(std::max(mid, min_ns), max_ns);
+        }
+      }
+      return max_ns;
+    }
+
+  private:
+
+    static const int SUB_BITS = 6;                     // 64 sub-buckets per power of two
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int MAX_BITS = 47;                    // Largest tracked value 2^47 ns, larger values are clamped
+    static const int NUM_BUCKETS = (MAX_BITS - SUB_BITS + 2) * SUB_COUNT;
+
+    std::vector<uint64_t> counts;
+    uint64_t              count;
+    uint64_t              min_ns;
+    uint64_t              max_ns;
+    double                sum;
+    double                sum_sq;
+
+    static int bucket( uint64_t ns )
+    {
+      if (ns < (uint64_t)SUB_COUNT) return (int)ns;
+
+      int msb = 63 - __builtin_clzll(ns);
+      if (msb >= MAX_BITS) return NUM_BUCKETS - 1;
+
+      int shift = msb - SUB_BITS;
+      return (shift + 1) * SUB_COUNT + (int)((ns >> shift) - SUB_COUNT);
+    }
+
+    static uint64_t bucket_low( int b )
+    {
+      if (b < SUB_COUNT) return b;
+
+      int shift = b / SUB_COUNT - 1;
+      return (uint64_t)(SUB_COUNT + b % SUB_COUNT) << shift;
+    }
+
+    static uint64_t bucket_width( int b )
+    {
+      return (b < SUB_COUNT) ? 1 : 1ull << (b / SUB_COUNT - 1);
+    }
+};
+
+/*
+ * Interval timer: start() / stop() pairs accumulate the busy time and record
+ * every interval into the timer's histogram.  Used per thread, see
+ * latency_histogram.
+ */
+class latency_timer
+{
+  public:
+
+    latency_timer() : t_start(0), tot(0), calls(0) {}
+
+    void reset()
+    {
+      tot = 0;
+      calls = 0;
+      hist.reset();
+    }
+
+    inline void start() { t_start = fast_clock_ticks(); }
+
+    inline void stop()
+    {
+      uint64_t ticks = fast_clock_ticks() - t_start;
+      tot += ticks;
+      calls++;
+      hist.record((uint64_t)((double)ticks * fast_clock_ns_per_tick()));
+    }
+
+    uint64_t get_calls() { return calls; }
+    float secs() { return (float)((double)tot * fast_clock_ns_per_tick() * 1e-9); }
+    float avg_secs() { return (calls > 0) ? secs() / (float)calls : 0.0f; }
+
+    const latency_histogram &histogram() const { return hist; }
+
+  private:
+
+    uint64_t          t_start;
+    uint64_t          tot;
+    uint64_t          calls;
+    latency_histogram hist;
+};
+
+/* Prints the column header of print_latency_row() */
+static inline void print_latency_header( const char *title )
+{
+  char line[128];
+  sprintf(line, "  %-20s %9s %9s %9s %9s %9s %9s %9s", title, "Count", "Min (ms)", "p50", "p90", "p99", "p99.9", "Max");
+  std::cout << line << std::endl;
+}
+
+/* Prints count, min, p50, p90, p99, p99.9 & max of a histogram in milliseconds */
+static inline void print_latency_row( const std::string &name, const latency_histogram &h )
+{
+  char line[128];
+  sprintf(line, "  %-20s %9llu %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f", name.c_str(), (unsigned long long)h.get_count(),
+          h.get_min() * 1e-6, h.get_percentile(50.0) * 1e-6, h.get_percentile(90.0) * 1e-6,
+          h.get_percentile(99.0) * 1e-6, h.get_percentile(99.9) * 1e-6, h.get_max() * 1e-6);
+  std::cout << line << std::endl;
+}
+
+#endif
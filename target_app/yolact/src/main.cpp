@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -28,7 +29,21 @@
 
 // Application Header files
 #include "yolact.hpp"
-#include "lnx_time.hpp"
+#include "pipeline.hpp"
+#include "scheduler.hpp"
+#include "decode.hpp"
+#include "source.hpp"
+#include "result_writer.hpp"
+#include "raw_writer.hpp"
+#include "display.hpp"
+#include "bench_stats.hpp"
+#include "autotune.hpp"
+#include "config_file.hpp"
+#include "inference_server.hpp"
+#include "latency_timer.hpp"
+#include "trace.hpp"
+#include "perf_counters.hpp"
+#include "tensor_recording.hpp"
 
 // Namespaces
 using namespace std;
@@ -39,19 +54,84 @@ using namespace std;
 void print_usage()
 {
   cout << "Usage: ./yolact.exe --image <image-file.jpg> [options]" << endl;
+  cout << "       ./yolact.exe --video <video-file|/dev/videoN> [options]" << endl;
+  cout << "       ./yolact.exe --image_dir <directory> | --image_list <list-file> [options]" << endl;
+  cout << "       ./yolact.exe --daemon <socket-path> [options]" << endl;
   cout << endl;
   cout << "  options:" << endl;
 
   cout << "  --help" << endl;
   cout << "      Prints this menu" << endl;
 
+  cout << "  --config <options-file>" << endl;
+  cout << "      Reads options from a file (e.g. written by --autotune) as if they were given at this position," << endl;
+  cout << "      options that follow on the command line override the file" << endl;
+
+  cout << "  --autotune <options-file>" << endl;
+  cout << "      Calibrates the pipeline on the input images: searches the thread count (up to --threads, default = 4)," << endl;
+  cout << "      the stage worker counts & the in-flight limit for the highest FPS and saves the result for --config." << endl;
+  cout << "      Every trial processes --iter N frames (default = 200)" << endl;
+
+  cout << "  --daemon <socket-path>" << endl;
+  cout << "      Keeps the model contexts loaded and serves inference requests of yolact_client.exe (or any client of" << endl;
+  cout << "      daemon_protocol.hpp) on a Unix domain socket until SIGINT/SIGTERM.  Requests of all clients share the" << endl;
+  cout << "      DPU batches, a partial batch is dispatched after --batch_timeout_ms (default = 1).  Every request is" << endl;
+  cout << "      answered, so the dropping --admission policies & --max_lag_ms are refused" << endl;
+
+  cout << "  --latency_cap_ms N" << endl;
+  cout << "      Only accepts --autotune configurations whose p99 latency is at most N milliseconds (default = no cap)" << endl;
+
+  cout << "  --video <video-file|/dev/videoN|N>" << endl;
+  cout << "      Streams frames from a video file or camera through the pipeline (implies --pipeline)" << endl;
+  cout << "      Frames are decoded on demand, so memory use does not depend on the stream length" << endl;
+
+  cout << "  --v4l2 </dev/videoN>" << endl;
+  cout << "      Captures from a V4L2 camera through mmap'd driver buffers instead of cv::VideoCapture (implies --pipeline)." << endl;
+  cout << "      The NV12/YUYV/BGR24 buffers are read in place & converted by the preprocess stage, which then requeues" << endl;
+  cout << "      them, so there's no extra copy per frame.  Try it with the vivid virtual video driver (modprobe vivid)" << endl;
+
+  cout << "  --v4l2_size WxH" << endl;
+  cout << "      Capture size requested from the --v4l2 camera, the driver may pick the closest size (default = 640x480)" << endl;
+
+  cout << "  --v4l2_format nv12|yuyv|bgr24" << endl;
+  cout << "      Capture pixel format of --v4l2 (default = the first of nv12, yuyv & bgr24 the camera supports)" << endl;
+
+  cout << "  --v4l2_buffers N" << endl;
+  cout << "      Number of --v4l2 driver buffers, frames in decode & preprocess hold one each (default = the" << endl;
+  cout << "      --queue_depth + the preprocess workers + 2, at least 4)" << endl;
+
+  cout << "  --v4l2_stall_ms N" << endl;
+  cout << "      Stops --v4l2 with an error when the camera delivered no frame for N milliseconds, shorter gaps are" << endl;
+  cout << "      waited out (0 = wait forever, default = 10000)" << endl;
+
   cout << "  --iter N" << endl;
   cout << "      Performs processing over N iterations for performance measurement" << endl;
   cout << "      Setting this to a value greater than 1 will turn off visulization of the outputs" << endl;
 
+  cout << "  --warmup N" << endl;
+  cout << "      Excludes the first N frames of --iter from the steady-state FPS & latency (default = one batch per thread)" << endl;
+
+  cout << "  --bench_ring N" << endl;
+  cout << "      Number of preloaded frames cycled by --iter, taken from the --image files (default = 8)" << endl;
+
+  cout << "  --bench_decode" << endl;
+  cout << "      Includes JPEG decoding of the preloaded file data in every --iter iteration" << endl;
+
+  cout << "  --reduced_decode" << endl;
+  cout << "      Decodes JPEG images that are at least twice the model input size at 1/2, 1/4 or 1/8 resolution" << endl;
+  cout << "      (the smallest scale that is still larger than the input tensor) instead of decoding & then downscaling." << endl;
+  cout << "      Annotated images stay at the decoded size, label masks are at the original size" << endl;
+
+  cout << "  --full_size_output" << endl;
+  cout << "      With --reduced_decode, scales the annotated images back to the original image size" << endl;
+
   cout << "  --no_display" << endl;
   cout << "      Turns off display output of processed images" << endl;
 
+  cout << "  --display_fps N" << endl;
+  cout << "      Refresh rate of the live display of --video & --image_dir/--image_list results (default = 60)." << endl;
+  cout << "      The newest processed frame is shown on every refresh, stale frames are dropped" << endl;
+
   cout << "  --score_thresh N" << endl;
   cout << "      Removes detections post NMS processing that fall below the provided N threshold (default = 0.0)" << endl;
 
@@ -67,20 +147,208 @@ void print_usage()
   cout << "  --wait N" << endl;
   cout << "      Specifies the wait time in seconds between output image displays (default = 5 seconds)" << endl;
 
+  cout << "  --pipeline" << endl;
+  cout << "      Processes the images with the staged pipeline (decode -> preprocess -> infer -> postprocess -> render -> sink)" << endl;
+  cout << "      instead of running the complete model on each thread.  The infer stage uses one model context per thread" << endl;
+
+  cout << "  --stage_workers stage=N[,stage=N...]" << endl;
+  cout << "      Specifies the number of worker threads of pipeline stages (default = 1 each)," << endl;
+  cout << "      e.g. --stage_workers decode=2,preprocess=2,postprocess=2" << endl;
+
+  cout << "  --queue_depth N" << endl;
+  cout << "      Specifies the capacity of the queues between pipeline stages (default = 4)" << endl;
+
+  cout << "  --affinity stage=cpus" << endl;
+  cout << "      Pins the workers of a pipeline stage to a CPU list, repeat for several stages," << endl;
+  cout << "      e.g. --affinity infer=1 --affinity preprocess=2-3 --affinity postprocess=2-3 (default = not pinned)" << endl;
+
+  cout << "  --infer_fifo N" << endl;
+  cout << "      Runs the infer workers, which submit the DPU jobs, with SCHED_FIFO priority N (1-99, needs root" << endl;
+  cout << "      or CAP_SYS_NICE).  -v reports the service time stddev & percentiles of every stage (default = off)" << endl;
+
+  cout << "  --shm_ring <name>" << endl;
+  cout << "      Reads BGR or NV12 frames from the POSIX shared-memory ring of a capture process (see shm_ring.hpp and" << endl;
+  cout << "      shm_producer.exe, implies --pipeline).  Frames are read in place and only copied & converted by the" << endl;
+  cout << "      preprocess stage; frames the producer overwrites before they are read are lost.  Ctrl-C ends the" << endl;
+  cout << "      stream, a producer that exits without closing the ring stops the run with an error" << endl;
+
+  cout << "  --shm_timeout_ms N" << endl;
+  cout << "      Stops --shm_ring with an error when no frame was published for N milliseconds (default = 0, wait as" << endl;
+  cout << "      long as the producer is alive)" << endl;
+
+  cout << "  --stdin_raw WxH:fmt" << endl;
+  cout << "      Reads WxH rawvideo frames from stdin, e.g. piped from \"ffmpeg -f rawvideo\" (implies --pipeline)." << endl;
+  cout << "      fmt is the ffmpeg pix_fmt: bgr24, rgb24, gray, nv12 or yuv420p" << endl;
+
+  cout << "  --stdout_raw" << endl;
+  cout << "      Writes the annotated frames in input order to stdout as bgr24 rawvideo at the input size, e.g. for" << endl;
+  cout << "      \"ffmpeg -f rawvideo -pix_fmt bgr24 -s WxH -i -\" (implies --pipeline & --no_display).  Console output" << endl;
+  cout << "      goes to stderr.  Every frame is written, so the dropping --admission policies & --max_lag_ms are refused." << endl;
+  cout << "      A single input stream of fixed-size frames is required, --stream and mixed image sizes are refused" << endl;
+
+  cout << "  --stdout_ids" << endl;
+  cout << "      Like --stdout_raw, but writes instance-ID maps as gray rawvideo (pixel = detection index, 0 = background)" << endl;
+
+  cout << "  --synthetic WxH@FPS" << endl;
+  cout << "      Streams synthetic WxH frames produced at FPS frames/sec like a free-running camera (implies --pipeline)." << endl;
+  cout << "      Frames that aren't read in time are lost; --iter N sets the number of frames (default = 1000)" << endl;
+
+  cout << "  --stream <source>" << endl;
+  cout << "      Adds a live stream, repeat for several streams (implies --pipeline).  <source> is a video file, camera" << endl;
+  cout << "      device or index, or synthetic:WxH@FPS.  Frames of all streams share the DPU batches and every stream is" << endl;
+  cout << "      delivered in order through a reorder buffer; -v reports the FPS & latency of each stream" << endl;
+
+  cout << "  --reorder_wait_ms N" << endl;
+  cout << "      Maximum time a --stream frame waits for its predecessors before they are skipped (default = 100)" << endl;
+
+  cout << "  --reorder_frames N" << endl;
+  cout << "      Maximum number of --stream frames held for reordering (default = 16)" << endl;
+
+  cout << "  --priority S=realtime|normal|bulk[:D]" << endl;
+  cout << "      Sets the priority class of --stream S (counted from 0) and optionally a deadline of D milliseconds" << endl;
+  cout << "      after capture.  Decode reads the more urgent streams first and preprocess & the DPU serve frames by" << endl;
+  cout << "      class & earliest deadline, so realtime streams preempt bulk streams at the next decode & batch," << endl;
+  cout << "      frames that missed their deadline are shed, and -v reports the deadline" << endl;
+  cout << "      hit rate per class (default = all streams normal without deadline)" << endl;
+
+  cout << "  --batch_timeout_ms N" << endl;
+  cout << "      Dispatches a partial DPU batch once its first frame has waited N milliseconds for the batch to fill," << endl;
+  cout << "      frames of all streams are batched together (default = 20 for live inputs, otherwise wait for a full batch)" << endl;
+
+  cout << "  --admission block|drop_newest|drop_oldest|keep_latest" << endl;
+  cout << "      What the pipeline input does with new frames when the pipeline falls behind (default = block):" << endl;
+  cout << "      wait for room, drop the new frame, drop the oldest waiting frame, or only keep the newest frame" << endl;
+
+  cout << "  --max_lag_ms N" << endl;
+  cout << "      Skips frames that are older than N milliseconds when they reach preprocessing (default = off)" << endl;
+
+  cout << "  --image_dir <directory>" << endl;
+  cout << "      Streams all jpg/png/bmp images of a directory through the pipeline (implies --pipeline)" << endl;
+
+  cout << "  --image_list <list-file>" << endl;
+  cout << "      Streams the images listed in a text file, one path per line, through the pipeline (implies --pipeline)" << endl;
+  cout << "      Streamed images are decoded in parallel (default = 2 decode workers) & unreadable files are skipped" << endl;
+
+  cout << "  --readahead N" << endl;
+  cout << "      Prefetches streamed image files N files ahead of the decoders into the page cache (default = 8)" << endl;
+
+  cout << "  --inflight N" << endl;
+  cout << "      Limits the number of frames in flight in the pipeline (default = enough to fill every queue)" << endl;
+
+  cout << "  --output_dir <directory>" << endl;
+  cout << "      Saves the annotated images to a directory (implies --pipeline).  Images are encoded & written by a" << endl;
+  cout << "      pool of writer threads, so saving results doesn't stall the pipeline" << endl;
+
+  cout << "  --output_format jpg|png" << endl;
+  cout << "      Image format of the saved results (default = jpg)" << endl;
+
+  cout << "  --output_masks" << endl;
+  cout << "      Also saves a <name>_mask.png label mask per image (pixel value = detection index, 0 = background)" << endl;
+
+  cout << "  --dump_tensors <directory>" << endl;
+  cout << "      Saves the output tensors of every frame as NumPy .npy files (implies --pipeline), the recordings are" << endl;
+  cout << "      inputs of kernel_bench.exe & golden_detect.py.  Written by the sink, so this slows down the pipeline" << endl;
+
+  cout << "  --output_workers N" << endl;
+  cout << "      Number of encode/write threads of --output_dir (default = 2)" << endl;
+
+  cout << "  --output_queue N" << endl;
+  cout << "      Number of results queued for writing (default = 8)" << endl;
+
+  cout << "  --output_policy block|drop" << endl;
+  cout << "      Blocks the pipeline or drops results when the output queue is full (default = block)" << endl;
+
+  cout << "  --trace <file.json>" << endl;
+  cout << "      Records begin/end events of every processing step (decode, preprocess, DPU sync/execute/copy, scan," << endl;
+  cout << "      NMS, mask, overlay, sink) per thread & frame and writes them as Chrome trace JSON, which can be opened" << endl;
+  cout << "      in ui.perfetto.dev or chrome://tracing" << endl;
+
+  cout << "  --trace_events N" << endl;
+  cout << "      Events buffered per thread by --trace, later events are dropped (default = 262144, 32 bytes each)" << endl;
+
+  cout << "  --perf_counters" << endl;
+  cout << "      Counts CPU cycles, instructions, cache misses & branch misses of the preprocess, scan, NMS, mask &" << endl;
+  cout << "      overlay steps with perf_event_open and prints them per frame with the IPC (adds a few us per step)" << endl;
+
+  cout << "  --report_interval N" << endl;
+  cout << "      Reports pipeline throughput & end-to-end latency every N seconds (default = 1 for streams, otherwise off)" << endl;
+
   cout << "  --verbose or -v" << endl;
   cout << "      Prints status & performance information" << endl;
   cout << endl;
 }
 
+/*
+ * Parses a --priority argument: <stream>=<class>[:<deadline_ms>]
+ */
+static bool parse_priority( const char *arg, int &stream, int &priority, float &deadline_ms )
+{
+  char name[16];
+  deadline_ms = 0.0f;
+
+  int n = sscanf(arg, "%d=%15[a-z]:%f", &stream, name, &deadline_ms);
+  if (n < 2 || stream < 0 || deadline_ms < 0.0f)
+  {
+    return false;
+  }
+
+  for (priority = 0; priority < NUM_PRIORITIES; priority++)
+  {
+    if (!strcmp(name, priority_names[priority])) return true;
+  }
+  return false;
+}
+
+/*
+ * Opens a --stream input: a video file/camera, or synthetic:WxH@FPS
+ */
+static frame_source *open_stream( const string &spec, uint64_t max_frames )
+{
+  if (spec.compare(0, 10, "synthetic:") == 0)
+  {
+    int width = 0, height = 0;
+    float fps = 0.0f;
+    if (sscanf(spec.c_str() + 10, "%dx%d@%f", &width, &height, &fps) != 3 || width < 1 || height < 1 || fps < 0.0f)
+    {
+      return nullptr;
+    }
+    return new synthetic_source(width, height, fps, (max_frames > 0) ? max_frames : 1000);
+  }
+
+  video_source *video = new video_source(spec, max_frames);
+  if (!video->is_opened())
+  {
+    delete video;
+    return nullptr;
+  }
+  return video;
+}
+
 /*
  * Main entry point of application.
  *
  */
 int main( int argc, char *argv[] )
 {
-  lnx_timer init_timer;
-  lnx_timer run_timer;
+  latency_timer init_timer;
+  latency_timer run_timer;
   vector<string> img_files;
+  string video_input;
+  string shm_name;
+  float shm_timeout_ms = 0.0f;
+  string v4l2_device;
+  cv::Size v4l2_size(640, 480);
+  uint32_t v4l2_format = 0;
+  int v4l2_buffers = 0;
+  float v4l2_stall_ms = 10000.0f;
+  string stdin_spec;
+  int stdout_mode = 0;
+  vector<string> stream_inputs;
+  cv::Size synthetic_size;
+  float synthetic_fps = 0.0f;
+  vector<string> stream_files;
+  int stream_input = 0;
+  int readahead = 8;
   float score_thresh = 0.0f;
   float nms_thresh = -1.0f;
   float nms_conf_thresh = -1.0f;
@@ -90,7 +358,54 @@ int main( int argc, char *argv[] )
   int verbose = 0;
   int display = 1;
   int num_threads = 1;
+  bool threads_set = false;
   int disp_wait = 5000;
+  float display_fps = 60.0f;
+  int use_pipeline = 0;
+  int warmup = -1;
+  int bench_ring = 8;
+  bool bench_decode = false;
+  bool reduced_decode = false;
+  float report_interval = -1.0f;
+  float batch_timeout = -1.0f;
+  vector<int> priority_streams, priority_classes;
+  vector<float> priority_deadlines;
+  string output_dir;
+  string output_format = "jpg";
+  bool output_masks = false;
+  string tensor_dir;
+  int output_workers = 2;
+  int output_queue = 8;
+  write_policy_t output_policy = WRITE_BLOCK;
+  string autotune_file;
+  string daemon_socket;
+  string trace_file;
+  size_t trace_events = 262144;
+  bool perf_counters = false;
+  float latency_cap_ms = 0.0f;
+  pipeline_config_t pipe_config;
+
+  pipeline_default_config(pipe_config);
+  pipe_config.workers[STAGE_DECODE] = 0;
+  pipe_config.workers[STAGE_INFER] = 0;
+
+  /* Options files are expanded in place */
+  vector<string> args;
+  if (!expand_config_args(argc, argv, args))
+  {
+    return -1;
+  }
+
+  vector<char *> arg_ptrs;
+  for (auto &arg : args)
+  {
+    arg_ptrs.push_back(&arg[0]);
+  }
+  argc = arg_ptrs.size();
+
+  /* Keeps the argv[argc] == NULL terminator of the original arguments */
+  arg_ptrs.push_back(nullptr);
+  argv = arg_ptrs.data();
 
   /* Process input arguments */
   {
@@ -153,6 +468,11 @@ int main( int argc, char *argv[] )
         display = 0;
         i++;
       }
+      else if (!strcmp(argv[i], "--display_fps"))
+      {
+        display_fps = atof(argv[i+1]);
+        i+=2;
+      }
       else if (!strcmp(argv[i], "--wait"))
       {
         disp_wait = (int)(atof(argv[i+1]) * 1000);
@@ -161,197 +481,1193 @@ int main( int argc, char *argv[] )
       else if (!strcmp(argv[i], "--threads"))
       {
         num_threads = atoi(argv[i+1]);
+        threads_set = true;
         i+=2;
       }
-      else
+      else if (!strcmp(argv[i], "--pipeline"))
       {
-        cout << "ERROR: input argument " << argv[i] << " not recognized." << endl;
-        print_usage();
-        return -1;
+        use_pipeline = 1;
+        i++;
       }
-    }
-  }
-  cout << endl;
-
-  if (img_cnt < 1)
-  {
-    cout << "ERROR: please provide input image as argument" << endl;
-    print_usage();
-    return -1;
-  }
-
-  auto nproc = std::thread::hardware_concurrency();
-  if (num_threads > nproc)
-  {
-    cout << "WARNING: You are using " << num_threads
-         << " threads, but your machine only has " << nproc << " processors." << endl;
-    cout << " Consider lowering the thread-count to " << nproc << " to prevent lock-ups" << endl << endl;
-  }
-
-  /* Display input parameters */
-  if (verbose)
-  {
-    cout << "Input files:" << endl;
-    for (auto &img_file : img_files)
-    {
-      cout << img_file << endl;
-    }
-
-    cout << endl;
-    cout << "Input image count:        " << img_files.size() << endl;
-    cout << "Score threshold:          " << score_thresh << endl;
-    cout << "NMS confidence threshold: " << ((nms_conf_thresh < 0) ? NMS_CONF_THRESH : nms_conf_thresh) << endl;
-    cout << "NMS IoU threshold:        " << ((nms_thresh < 0) ? NMS_THRESH : nms_thresh) << endl;
-    cout << "Display output:           " << ((display == 1) ? "ON" : "OFF") << endl;
-    cout << "Test iterations:          " << test_iter << endl;
-    cout << "Processing threads:       " << num_threads << endl;
-    cout << endl;
-  }
-
-  /* Reset run timers */
-  init_timer.reset();
-  run_timer.reset();
-
-  /* Model initialization */
-  init_timer.start();
-
-  yolact yolact_model[num_threads];
-  int batch_size = yolact_model[0].create("model/yolact.xmodel");
-
-  for (int i = 1; i < num_threads; i++)
-  {
-    yolact_model[i].create("model/yolact.xmodel");
-  }
-
-  init_timer.stop();
-
-  /* Read frame from file */
-  if (verbose) cout << "Reading image" << endl;
-
-  vector<cv::Mat> frames;
-  for (auto &img_file : img_files)
-  {
-    cv::Mat frame = cv::imread(img_file);
-
-    if (frame.empty())
-    {
-      cout << "ERROR: input file " << img_file << " is empty" << endl;
-      return -1;
-    }
-
-    frames.push_back(frame);
-  }
-
-  /* Compute how many iterations to process based on user input & DPU batch capabilites */
-  if (test_iter > 0)
-  {
-    iter = (test_iter + batch_size * num_threads - 1) / (batch_size * num_threads);
-  }
-  else
-  {
-    iter = (img_cnt + batch_size * num_threads - 1) / (batch_size * num_threads);
-  }
-
-  /* Run the model */
-  if (verbose || test_iter > 0) cout << "Testing model";
-  if (test_iter > 0)
-  {
-    frames.resize(1);  // only use the first input image for performance testing
-    cout << " for " << test_iter << ((test_iter > 1) ? " iterations" : " iteration");
-  }
-
-  cout << endl;
-
-  /* Allocatin and load memory for input/output buffers */
-  vector<vector<cv::Mat>> images(num_threads);
-
-  for (int i = 0; i < iter; i++)
-  {
-    for (int t = 0; t < num_threads; t++)
-    {
-      for (int b = 0; b < batch_size; b++)
+      else if (!strcmp(argv[i], "--stage_workers"))
       {
-        int img_idx = (i*batch_size*num_threads + t*batch_size + b) % frames.size();
-        cv::Mat temp;
-        frames[img_idx].copyTo(temp);
-        images[t].push_back(temp);
+        if ( i+1 >= argc || !pipeline_parse_workers(argv[i+1], pipe_config) )
+        {
+          cout << "ERROR: invalid stage worker list" << endl;
+          print_usage();
+          return -1;
+        }
+        use_pipeline = 1;
+        i+=2;
       }
-    }
-  }
-  frames.clear();
-
-  /* Spawn processing threads */
-  run_timer.start();
-  std::vector<thread> threads(num_threads);
-
-  for (int t = 0; t < num_threads; t++)
-  {
-    threads[t] = thread( &yolact::run,
-                         &yolact_model[t],
-                          std::ref(images[t]),
-                          nms_conf_thresh,
-                          nms_thresh,
-                          score_thresh
-                       );
-  }
-
-  /* Wait for thread completions */
-  for (int t = 0; t < num_threads; t++)
-  {
-    threads[t].join();
-  }
-
-  run_timer.stop();
-
-  /* Display timing results */
-  if (verbose || test_iter > 0)
-  {
-    char time_str[20];
-    char fps_str[20];
-    sprintf(time_str, "%1.3f", init_timer.avg_secs());
-    cout << "Initialization time took " << time_str << endl;
-    float avg_proc_time = run_timer.avg_secs() / (float)(batch_size * num_threads * iter);
-    sprintf(time_str, "%1.3f", avg_proc_time);
-    sprintf(fps_str, "%.1f", 1.0f / avg_proc_time);
-    cout << "Average run time was " << time_str << " seconds/frame (FPS = " << fps_str << ") using " << num_threads
-         << ((num_threads == 1) ? " thread" : " threads") << endl;
-
-    if (verbose)
-    {
-      for (int t = 0; t < num_threads; t++)
+      else if (!strcmp(argv[i], "--queue_depth"))
       {
-        cout << "Thread " << t << ":" << endl;
-        yolact_model[t].print_stats();
+        pipe_config.queue_depth = (i+1 < argc) ? atoi(argv[i+1]) : 0;
+        if (pipe_config.queue_depth < 1)
+        {
+          cout << "ERROR: the queue depth must be at least 1" << endl;
+          print_usage();
+          return -1;
+        }
+        i+=2;
       }
-    }
+      else if (!strcmp(argv[i], "--affinity"))
+      {
+        if ( i+1 >= argc || !pipeline_parse_affinity(argv[i+1], pipe_config) )
+        {
+          cout << "ERROR: please provide the placement as stage=cpus, e.g. infer=1 or postprocess=2-3" << endl;
+          print_usage();
+          return -1;
+        }
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--infer_fifo"))
+      {
+        pipe_config.infer_fifo_priority = std::min(std::max(atoi(argv[i+1]), 0), 99);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--video"))
+      {
+        if ( i+1 >= argc )
+        {
+          cout << "ERROR: please provide input video as argument" << endl;
+          print_usage();
+          return -1;
+        }
 
-    cout << endl;
-  }
+        video_input = argv[i+1];
+        use_pipeline = 1;
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--v4l2"))
+      {
+        if ( i+1 >= argc )
+        {
+          cout << "ERROR: please provide the V4L2 device as argument" << endl;
+          print_usage();
+          return -1;
+        }
 
-  /* Display processed images */
-  if (display)
-  {
-    if (disp_wait == 0)
-    {
-      cout << "Displaying results ... hit any key to advance to the next output image" << endl;
-    }
-    else
-    {
-      cout << "Displaying results for " << (float)disp_wait/1000 << " seconds ... hit any key to close the current display" << endl;
-    }
+        v4l2_device = argv[i+1];
+        use_pipeline = 1;
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--v4l2_size"))
+      {
+        int width, height;
+        if ( i+1 >= argc || sscanf(argv[i+1], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0 )
+        {
+          cout << "ERROR: --v4l2_size expects WxH" << endl;
+          return -1;
+        }
 
-    for (int i = 0; i < iter; i++)
-    {
-      for (int t = 0; t < num_threads; t++)
+        v4l2_size = cv::Size(width, height);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--v4l2_format"))
+      {
+        string fmt = (i+1 < argc) ? argv[i+1] : "";
+        if (fmt == "nv12")
+        {
+          v4l2_format = V4L2_PIX_FMT_NV12;
+        }
+        else if (fmt == "yuyv")
+        {
+          v4l2_format = V4L2_PIX_FMT_YUYV;
+        }
+        else if (fmt == "bgr24")
+        {
+          v4l2_format = V4L2_PIX_FMT_BGR24;
+        }
+        else
+        {
+          cout << "ERROR: --v4l2_format must be nv12, yuyv or bgr24" << endl;
+          return -1;
+        }
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--v4l2_buffers"))
+      {
+        v4l2_buffers = std::max(atoi(argv[i+1]), 2);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--v4l2_stall_ms"))
       {
-        for (int b = 0; b < batch_size; b++)
+        v4l2_stall_ms = (i+1 < argc) ? atof(argv[i+1]) : -1.0f;
+        if (v4l2_stall_ms < 0.0f)
         {
-          if (i*num_threads*batch_size + t*batch_size + b >= img_cnt) break;
-          auto result = images[t][i*batch_size+b];
-          cv::imshow("Result", result);
-          cv::waitKey(disp_wait);
+          cout << "ERROR: the camera stall limit must be at least 0 milliseconds" << endl;
+          print_usage();
+          return -1;
         }
+        i += 2;
       }
+      else if (!strcmp(argv[i], "--shm_ring"))
+      {
+        if ( i+1 >= argc )
+        {
+          cout << "ERROR: please provide the shared memory ring name as argument" << endl;
+          print_usage();
+          return -1;
+        }
+
+        shm_name = argv[i+1];
+        use_pipeline = 1;
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--shm_timeout_ms"))
+      {
+        shm_timeout_ms = (i+1 < argc) ? atof(argv[i+1]) : -1.0f;
+        if (shm_timeout_ms < 0.0f)
+        {
+          cout << "ERROR: the shared memory time-out must be at least 0 milliseconds" << endl;
+          print_usage();
+          return -1;
+        }
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--stdin_raw"))
+      {
+        if ( i+1 >= argc )
+        {
+          cout << "ERROR: please provide the frame size & pixel format as argument, e.g. 1280x720:bgr24" << endl;
+          print_usage();
+          return -1;
+        }
+
+        stdin_spec = argv[i+1];
+        use_pipeline = 1;
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--stdout_raw") || !strcmp(argv[i], "--stdout_ids"))
+      {
+        stdout_mode = !strcmp(argv[i], "--stdout_ids") ? 2 : 1;
+        use_pipeline = 1;
+        display = 0;
+        i++;
+      }
+      else if (!strcmp(argv[i], "--synthetic"))
+      {
+        int width = 0, height = 0;
+        if ( i+1 >= argc || sscanf(argv[i+1], "%dx%d@%f", &width, &height, &synthetic_fps) != 3 ||
+             width < 1 || height < 1 || synthetic_fps < 0.0f )
+        {
+          cout << "ERROR: please provide the synthetic stream as WxH@FPS, e.g. 1280x720@60" << endl;
+          print_usage();
+          return -1;
+        }
+
+        synthetic_size = cv::Size(width, height);
+        use_pipeline = 1;
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--stream"))
+      {
+        if ( i+1 >= argc )
+        {
+          cout << "ERROR: please provide a stream source as argument" << endl;
+          print_usage();
+          return -1;
+        }
+
+        stream_inputs.push_back(argv[i+1]);
+        use_pipeline = 1;
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--reorder_wait_ms"))
+      {
+        pipe_config.reorder_wait_ms = atof(argv[i+1]);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--reorder_frames"))
+      {
+        pipe_config.reorder_frames = std::max(atoi(argv[i+1]), 1);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--priority"))
+      {
+        int stream, priority;
+        float deadline_ms;
+        if ( i+1 >= argc || !parse_priority(argv[i+1], stream, priority, deadline_ms) )
+        {
+          cout << "ERROR: please provide the priority as <stream>=realtime|normal|bulk[:<deadline_ms>], e.g. 0=realtime:50" << endl;
+          print_usage();
+          return -1;
+        }
+
+        priority_streams.push_back(stream);
+        priority_classes.push_back(priority);
+        priority_deadlines.push_back(deadline_ms);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--batch_timeout_ms"))
+      {
+        batch_timeout = atof(argv[i+1]);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--admission"))
+      {
+        pipe_config.admission = (i+1 < argc) ? pipeline_admit_index(argv[i+1]) : -1;
+        if (pipe_config.admission < 0)
+        {
+          cout << "ERROR: admission policy must be block, drop_newest, drop_oldest or keep_latest" << endl;
+          print_usage();
+          return -1;
+        }
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--max_lag_ms"))
+      {
+        pipe_config.max_lag_ms = atof(argv[i+1]);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--image_dir") || !strcmp(argv[i], "--image_list"))
+      {
+        bool is_dir = !strcmp(argv[i], "--image_dir");
+
+        if ( i+1 >= argc )
+        {
+          cout << "ERROR: please provide " << (is_dir ? "an image directory" : "an image list file") << " as argument" << endl;
+          print_usage();
+          return -1;
+        }
+
+        bool valid = is_dir ? list_image_dir(argv[i+1], stream_files) : read_image_list(argv[i+1], stream_files);
+        if (!valid)
+        {
+          cout << "ERROR: unable to read " << argv[i+1] << endl;
+          return -1;
+        }
+
+        stream_input = 1;
+        use_pipeline = 1;
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--readahead"))
+      {
+        readahead = atoi(argv[i+1]);
+        i+=2;
+      }
+      else if (!strcmp(argv[i], "--inflight"))
+      {
+        pipe_config.inflight = atoi(argv[i+1]);
+        i+=2;
+      }
+      else if (!strcmp(argv[i], "--warmup"))
+      {
+        warmup = atoi(argv[i+1]);
+        i+=2;
+      }
+      else if (!strcmp(argv[i], "--bench_ring"))
+      {
+        bench_ring = std::max(atoi(argv[i+1]), 1);
+        i+=2;
+      }
+      else if (!strcmp(argv[i], "--bench_decode"))
+      {
+        bench_decode = true;
+        i++;
+      }
+      else if (!strcmp(argv[i], "--reduced_decode"))
+      {
+        reduced_decode = true;
+        i++;
+      }
+      else if (!strcmp(argv[i], "--full_size_output"))
+      {
+        pipe_config.source_size_output = true;
+        i++;
+      }
+      else if (!strcmp(argv[i], "--output_dir"))
+      {
+        if ( i+1 >= argc )
+        {
+          cout << "ERROR: please provide an output directory as argument" << endl;
+          print_usage();
+          return -1;
+        }
+
+        output_dir = argv[i+1];
+        use_pipeline = 1;
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--output_format"))
+      {
+        output_format = argv[i+1];
+        if (output_format != "jpg" && output_format != "png")
+        {
+          cout << "ERROR: output format must be jpg or png" << endl;
+          return -1;
+        }
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--output_masks"))
+      {
+        output_masks = true;
+        i++;
+      }
+      else if (!strcmp(argv[i], "--dump_tensors"))
+      {
+        if ( i+1 >= argc )
+        {
+          cout << "ERROR: please provide a tensor directory as argument" << endl;
+          print_usage();
+          return -1;
+        }
+
+        tensor_dir = argv[i+1];
+        use_pipeline = 1;
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--output_workers"))
+      {
+        output_workers = std::max(atoi(argv[i+1]), 1);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--output_queue"))
+      {
+        output_queue = std::max(atoi(argv[i+1]), 1);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--output_policy"))
+      {
+        if (!strcmp(argv[i+1], "block"))
+        {
+          output_policy = WRITE_BLOCK;
+        }
+        else if (!strcmp(argv[i+1], "drop"))
+        {
+          output_policy = WRITE_DROP;
+        }
+        else
+        {
+          cout << "ERROR: output policy must be block or drop" << endl;
+          return -1;
+        }
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--autotune"))
+      {
+        if ( i+1 >= argc )
+        {
+          cout << "ERROR: please provide the options file to write as argument" << endl;
+          print_usage();
+          return -1;
+        }
+
+        autotune_file = argv[i+1];
+        use_pipeline = 1;
+        display = 0;
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--daemon"))
+      {
+        if ( i+1 >= argc )
+        {
+          cout << "ERROR: please provide the socket path as argument" << endl;
+          print_usage();
+          return -1;
+        }
+
+        daemon_socket = argv[i+1];
+        use_pipeline = 1;
+        display = 0;
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--latency_cap_ms"))
+      {
+        latency_cap_ms = atof(argv[i+1]);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--trace"))
+      {
+        if ( i+1 >= argc )
+        {
+          cout << "ERROR: please provide the trace file as argument" << endl;
+          print_usage();
+          return -1;
+        }
+
+        trace_file = argv[i+1];
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--trace_events"))
+      {
+        trace_events = std::max(atoi(argv[i+1]), 1);
+        i += 2;
+      }
+      else if (!strcmp(argv[i], "--perf_counters"))
+      {
+        perf_counters = true;
+        i++;
+      }
+      else if (!strcmp(argv[i], "--report_interval"))
+      {
+        report_interval = atof(argv[i+1]);
+        i+=2;
+      }
+      else
+      {
+        cout << "ERROR: input argument " << argv[i] << " not recognized." << endl;
+        print_usage();
+        return -1;
+      }
+    }
+  }
+
+  /* The frames own stdout, console output is moved to stderr */
+  int raw_out_fd = -1;
+  if (stdout_mode)
+  {
+    cout.flush();
+    raw_out_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+  }
+  cout << endl;
+
+  bool synthetic_input = !synthetic_size.empty();
+  bool multi_stream = !stream_inputs.empty();
+
+  bool daemon_mode = !daemon_socket.empty();
+  bool shm_input = !shm_name.empty();
+  bool stdin_input = !stdin_spec.empty();
+  bool v4l2_input = !v4l2_device.empty();
+
+  if (img_cnt < 1 && video_input.empty() && !stream_input && !synthetic_input && !multi_stream && !daemon_mode &&
+      !shm_input && !stdin_input && !v4l2_input)
+  {
+    cout << "ERROR: please provide input image as argument" << endl;
+    print_usage();
+    return -1;
+  }
+
+  if ((img_cnt > 0) + !video_input.empty() + stream_input + synthetic_input + multi_stream + daemon_mode + shm_input +
+      stdin_input + v4l2_input > 1)
+  {
+    cout << "ERROR: --image, --video, --v4l2, --shm_ring, --stdin_raw, --synthetic, --stream, --daemon and"
+         << " --image_dir/--image_list can not be combined" << endl;
+    return -1;
+  }
+
+  if (stdout_mode && (daemon_mode || !autotune_file.empty()))
+  {
+    cout << "ERROR: --stdout_raw/--stdout_ids can not be combined with --daemon or --autotune" << endl;
+    return -1;
+  }
+
+  /* A dropped frame would leave a hole in the output video */
+  if (stdout_mode && (pipe_config.admission != ADMIT_BLOCK || pipe_config.max_lag_ms > 0.0f))
+  {
+    cout << "ERROR: --stdout_raw/--stdout_ids write every frame, use --admission block without --max_lag_ms" << endl;
+    return -1;
+  }
+
+  /* Rawvideo holds a single sequence of equally sized frames */
+  if (stdout_mode && multi_stream)
+  {
+    cout << "ERROR: --stdout_raw/--stdout_ids write a single stream and can not be combined with --stream" << endl;
+    return -1;
+  }
+
+  /* A dropped request would never be answered & its client would wait forever */
+  if (daemon_mode && (pipe_config.admission != ADMIT_BLOCK || pipe_config.max_lag_ms > 0.0f))
+  {
+    cout << "ERROR: --daemon answers every request, use --admission block without --max_lag_ms" << endl;
+    return -1;
+  }
+
+  if (stream_input && stream_files.empty())
+  {
+    cout << "ERROR: no input images found" << endl;
+    return -1;
+  }
+
+  if (!autotune_file.empty())
+  {
+    if (img_cnt < 1 && !stream_input)
+    {
+      cout << "ERROR: --autotune calibrates on --image or --image_dir/--image_list inputs" << endl;
+      return -1;
+    }
+
+    /* --threads is the largest thread count searched */
+    if (!threads_set) num_threads = std::min(std::max((int)std::thread::hardware_concurrency(), 1), 4);
+    pipe_config.workers[STAGE_INFER] = 0;
+  }
+
+  /* Streamed image files are decoded in parallel, live streams get one reader each, other inputs use a single decode worker */
+  if (pipe_config.workers[STAGE_DECODE] == 0)
+  {
+    pipe_config.workers[STAGE_DECODE] = multi_stream ? (int)stream_inputs.size() : (stream_input ? 2 : 1);
+  }
+
+  if (!output_dir.empty() && !result_writer::create_dir(output_dir))
+  {
+    cout << "ERROR: unable to create output directory " << output_dir << endl;
+    return -1;
+  }
+
+  if (!tensor_dir.empty() && !result_writer::create_dir(tensor_dir))
+  {
+    cout << "ERROR: unable to create tensor directory " << tensor_dir << endl;
+    return -1;
+  }
+
+  /* Open the video stream before loading the model so errors are reported quickly */
+  std::unique_ptr<video_source> video;
+  if (!video_input.empty())
+  {
+    video.reset(new video_source(video_input, test_iter));
+    if (!video->is_opened())
+    {
+      cout << "ERROR: unable to open video input " << video_input << endl;
+      return -1;
+    }
+
+    /* Video frames are read sequentially */
+    if (pipe_config.workers[STAGE_DECODE] > 1)
+    {
+      cout << "WARNING: video input uses a single decode worker" << endl;
+      pipe_config.workers[STAGE_DECODE] = 1;
+    }
+  }
+
+  /* Start capturing, the driver buffers are mapped once */
+  std::unique_ptr<v4l2_source> camera;
+  if (v4l2_input)
+  {
+    /* Driver buffers are dequeued in order */
+    pipe_config.workers[STAGE_DECODE] = 1;
+
+    /* Every frame queued for & in preprocessing holds a buffer, as does the decode worker blocked on a full
+     * queue; one more keeps the driver capturing
+     */
+    if (v4l2_buffers == 0)
+    {
+      v4l2_buffers = std::max(pipe_config.queue_depth + pipe_config.workers[STAGE_PREPROCESS] +
+                              pipe_config.workers[STAGE_DECODE] + 1, 4);
+    }
+
+    camera.reset(new v4l2_source(v4l2_device, v4l2_size.width, v4l2_size.height, v4l2_format, v4l2_buffers, test_iter));
+    if (!camera->is_opened())
+    {
+      cout << "ERROR: " << camera->get_open_error() << endl;
+      return -1;
+    }
+    camera->set_stall_limit(v4l2_stall_ms);
+  }
+
+  /* Attach to the shared memory ring, the producer must have created it */
+  std::unique_ptr<shm_source> shm;
+  if (shm_input)
+  {
+    shm.reset(new shm_source(shm_name, test_iter));
+    if (!shm->is_opened())
+    {
+      cout << "ERROR: no shared memory ring " << shm_name << " (start the producer first)" << endl;
+      return -1;
+    }
+    shm->set_idle_timeout(shm_timeout_ms);
+
+    /* Ctrl-C ends the stream, so the frames in flight are still finished */
+    signal(SIGINT, shm_signal_handler);
+    signal(SIGTERM, shm_signal_handler);
+
+    /* The ring is read in order */
+    pipe_config.workers[STAGE_DECODE] = 1;
+  }
+
+  /* Frames are read from stdin in order */
+  std::unique_ptr<stdin_source> raw_in;
+  if (stdin_input)
+  {
+    int width, height, format;
+    if (!parse_rawvideo_spec(stdin_spec, width, height, format))
+    {
+      cout << "ERROR: --stdin_raw expects WxH:fmt with fmt = bgr24, rgb24, gray, nv12 or yuv420p (even W & H for the"
+           << " 4:2:0 formats)" << endl;
+      return -1;
+    }
+
+    raw_in.reset(new stdin_source(STDIN_FILENO, width, height, format, test_iter));
+    pipe_config.workers[STAGE_DECODE] = 1;
+  }
+
+  /* Open the multiplexed streams */
+  std::unique_ptr<mux_source> mux;
+  if (multi_stream)
+  {
+    mux.reset(new mux_source());
+    for (auto &spec : stream_inputs)
+    {
+      frame_source *stream = open_stream(spec, test_iter);
+      if (stream == nullptr)
+      {
+        cout << "ERROR: unable to open stream " << spec << endl;
+        return -1;
+      }
+      mux->add(stream, spec);
+    }
+
+    pipe_config.num_streams = mux->size();
+  }
+
+  if (!priority_streams.empty())
+  {
+    if (!multi_stream)
+    {
+      cout << "ERROR: --priority applies to --stream inputs" << endl;
+      return -1;
+    }
+
+    for (size_t p = 0; p < priority_streams.size(); p++)
+    {
+      if (priority_streams[p] >= mux->size())
+      {
+        cout << "ERROR: --priority refers to stream " << priority_streams[p] << ", only " << mux->size()
+             << " streams were given" << endl;
+        return -1;
+      }
+      mux->set_priority(priority_streams[p], priority_classes[p], priority_deadlines[p]);
+    }
+    pipe_config.priority_scheduling = true;
+  }
+
+  /* The infer stage uses one model context per worker */
+  if (use_pipeline)
+  {
+    if (pipe_config.workers[STAGE_INFER] > 0)
+    {
+      num_threads = pipe_config.workers[STAGE_INFER];
+    }
+    pipe_config.workers[STAGE_INFER] = num_threads;
+    pipe_config.score_thresh = score_thresh;
+    pipe_config.label_masks = (!output_dir.empty() && output_masks) || stdout_mode == 2;
+    /* Daemon replies only carry the detections, without a consumer of the images nothing is drawn either */
+    pipe_config.render = !daemon_mode && (display || !output_dir.empty() || stdout_mode);
+    pipe_config.report_interval = (report_interval >= 0.0f) ? report_interval :
+                                  ((video || camera || shm || raw_in || stream_input || synthetic_input || multi_stream) ?
+                                   1.0f : 0.0f);
+
+    /* Live inputs can't wait indefinitely for a batch to fill, daemon requests wait even less */
+    pipe_config.batch_timeout_ms = (batch_timeout >= 0.0f) ? batch_timeout :
+                                   (daemon_mode ? 1.0f : ((video || camera || shm || raw_in || synthetic_input || multi_stream) ?
+                                   20.0f : 0.0f));
+  }
+
+  auto nproc = std::thread::hardware_concurrency();
+  if (num_threads > nproc)
+  {
+    cout << "WARNING: You are using " << num_threads
+         << " threads, but your machine only has " << nproc << " processors." << endl;
+    cout << " Consider lowering the thread-count to " << nproc << " to prevent lock-ups" << endl << endl;
+  }
+
+  /* Display input parameters */
+  if (verbose)
+  {
+    if (video)
+    {
+      cout << "Input video:              " << video_input << " (" << video->get_fps() << " FPS)" << endl;
+    }
+    else if (camera)
+    {
+      v4l2_capture &cap = camera->info();
+      cout << "Input camera:             " << v4l2_device << " (" << cap.get_width() << "x" << cap.get_height() << " "
+           << v4l2_capture::fourcc_string(cap.get_format()) << ", " << cap.get_num_buffers() << " buffers)" << endl;
+    }
+    else if (shm)
+    {
+      const shm_ring_info_t &ring = shm->info();
+      cout << "Shared memory ring:       " << shm_name << " (" << ring.width << "x" << ring.height << " "
+           << ((ring.format == SHM_FMT_NV12) ? "NV12" : "BGR") << ", " << ring.num_slots << " slots)" << endl;
+    }
+    else if (raw_in)
+    {
+      cout << "Input rawvideo:           stdin (" << stdin_spec << ", " << raw_in->get_packet_bytes() << " bytes/frame)"
+           << endl;
+    }
+    else if (multi_stream)
+    {
+      for (int st = 0; st < mux->size(); st++)
+      {
+        cout << "Input stream " << st << ":           " << mux->get_name(st) << endl;
+      }
+    }
+    else if (synthetic_input)
+    {
+      cout << "Synthetic input:          " << synthetic_size.width << "x" << synthetic_size.height << " @ "
+           << synthetic_fps << " FPS" << endl;
+    }
+    else if (stream_input)
+    {
+      cout << "Streamed image count:     " << stream_files.size() << endl;
+    }
+    else
+    {
+      cout << "Input files:" << endl;
+      for (auto &img_file : img_files)
+      {
+        cout << img_file << endl;
+      }
+
+      cout << endl;
+      cout << "Input image count:        " << img_files.size() << endl;
+    }
+    cout << "Score threshold:          " << score_thresh << endl;
+    cout << "NMS confidence threshold: " << ((nms_conf_thresh < 0) ? NMS_CONF_THRESH : nms_conf_thresh) << endl;
+    cout << "NMS IoU threshold:        " << ((nms_thresh < 0) ? NMS_THRESH : nms_thresh) << endl;
+    cout << "Display output:           " << ((display == 1) ? "ON" : "OFF") << endl;
+    if (reduced_decode)
+    {
+      cout << "Reduced decode output:    "
+           << (pipe_config.source_size_output ? "original size" : "decoded size, label masks at original size") << endl;
+    }
+    cout << "Test iterations:          " << test_iter << endl;
+    cout << "Processing threads:       " << num_threads << endl;
+    if (use_pipeline)
+    {
+      cout << "Pipeline stage workers:  ";
+      for (int s = 0; s < NUM_STAGES; s++)
+      {
+        cout << " " << stage_names[s] << "=" << pipe_config.workers[s];
+      }
+      cout << endl;
+      cout << "Pipeline queue depth:     " << pipe_config.queue_depth << endl;
+    }
+    cout << endl;
+  }
+
+  /* Reset run timers */
+  init_timer.reset();
+  run_timer.reset();
+
+  /* Model initialization */
+  init_timer.start();
+
+  yolact yolact_model[num_threads];
+  int batch_size = yolact_model[0].create("model/yolact.xmodel");
+
+  for (int i = 1; i < num_threads; i++)
+  {
+    yolact_model[i].create("model/yolact.xmodel");
+  }
+
+  init_timer.stop();
+
+  /* Save threshold values */
+  for (int i = 0; i < num_threads; i++)
+  {
+    yolact_model[i].set_thresholds(nms_conf_thresh, nms_thresh);
+  }
+
+  /* Processed images in input order, kept for display */
+  vector<cv::Mat> results;
+
+  /* Large JPEG images are decoded at the smallest DCT scale that still covers the input tensor */
+  cv::Size min_decode_size = reduced_decode ? yolact_model[0].get_input_dims() : cv::Size();
+
+  /* Calibrate the pipeline on a ring of preloaded frames & save the best configuration */
+  if (!autotune_file.empty())
+  {
+    const vector<string> &files = stream_input ? stream_files : img_files;
+    ring_source frames((test_iter > 0) ? test_iter : 200, bench_decode);
+    frames.set_reduced_decode(min_decode_size);
+    if (!frames.load(files, std::min(files.size(), (size_t)bench_ring))) return -1;
+
+    cout << "Auto-tuning up to " << num_threads << ((num_threads == 1) ? " thread" : " threads") << ", "
+         << frames.size() << " frames per trial";
+    if (latency_cap_ms > 0.0f) cout << ", p99 latency cap " << latency_cap_ms << " ms";
+    cout << endl;
+
+    autotuner tuner(yolact_model, num_threads, pipe_config, frames, latency_cap_ms);
+    tune_result_t best = tuner.run();
+    autotuner::print_result("Best", best);
+
+    if (latency_cap_ms > 0.0f && best.p99_ms > latency_cap_ms)
+    {
+      cout << "WARNING: no configuration met the latency cap, saved the one with the lowest latency" << endl;
+    }
+
+    if (!tuner.save(autotune_file, best))
+    {
+      cout << "ERROR: unable to write " << autotune_file << endl;
+      return -1;
+    }
+    cout << "Saved the configuration to " << autotune_file << ", use it with --config " << autotune_file << endl;
+    return 0;
+  }
+
+  /* Trace the processing, not the model initialization */
+  if (!trace_file.empty()) trace_start(trace_events);
+  if (perf_counters) perf_start();
+
+  /* Serve requests until stopped */
+  if (daemon_mode)
+  {
+    inference_server server(daemon_socket, yolact_model, pipe_config);
+    if (!server.listen()) return -1;
+
+    cout << "Serving requests on " << daemon_socket << " with " << num_threads
+         << ((num_threads == 1) ? " model context" : " model contexts") << " (initialization took "
+         << init_timer.avg_secs() << " seconds), stop with Ctrl-C" << endl;
+    server.run();
+
+    cout << endl;
+    if (!trace_file.empty() && !trace_write(trace_file)) cout << "ERROR: unable to write " << trace_file << endl;
+    if (perf_counters) perf_print_stats();
+    server.print_stats(verbose);
+    cout << "Done." << endl;
+    return 0;
+  }
+
+  /* Steady-state statistics of the test iterations */
+  bench_stats bench((warmup >= 0) ? warmup : batch_size * num_threads);
+
+  if (use_pipeline)
+  {
+    std::unique_ptr<frame_source> source;
+    synthetic_source *synthetic = nullptr;
+    shm_source *shm_reader = shm.get();
+    v4l2_source *camera_reader = camera.get();
+    stdin_source *stdin_reader = raw_in.get();
+
+    if (video)
+    {
+      source = std::move(video);
+    }
+    else if (camera)
+    {
+      source = std::move(camera);
+    }
+    else if (shm)
+    {
+      source = std::move(shm);
+    }
+    else if (raw_in)
+    {
+      source = std::move(raw_in);
+    }
+    else if (mux)
+    {
+      source = std::move(mux);
+    }
+    else if (synthetic_input)
+    {
+      synthetic = new synthetic_source(synthetic_size.width, synthetic_size.height, synthetic_fps,
+                                       (test_iter > 0) ? test_iter : 1000);
+      source.reset(synthetic);
+    }
+    else if (stream_input)
+    {
+      source.reset(new image_source(stream_files, readahead, true));
+    }
+    else if (test_iter > 0)
+    {
+      /* In test mode the decode stage cycles through a small ring of preloaded frames */
+      ring_source *ring = new ring_source(test_iter, bench_decode);
+      source.reset(ring);
+      ring->set_reduced_decode(min_decode_size);
+      if (!ring->load(img_files, std::min(img_cnt, bench_ring))) return -1;
+    }
+    else
+    {
+      source.reset(new image_source(img_files));
+      if (display) results.resize(img_cnt);
+    }
+
+    source->set_reduced_decode(min_decode_size);
+
+    if (verbose || test_iter > 0)
+    {
+      cout << "Testing model";
+      if (test_iter > 0) cout << " for " << test_iter << ((test_iter > 1) ? " iterations" : " iteration");
+      cout << endl;
+    }
+
+    /* Results are encoded & written in the background, repeated & video frames are named by sequence number */
+    std::unique_ptr<result_writer> writer;
+    if (!output_dir.empty())
+    {
+      writer.reset(new result_writer(output_dir, output_format, output_workers, output_queue, output_policy,
+                                     !video_input.empty() || v4l2_input || shm_input || stdin_input || synthetic_input ||
+                                     multi_stream || test_iter > 0));
+      writer->set_stream_names(multi_stream);
+    }
+
+    /* Results piped to stdout, held back by the writer until the frames before them are written */
+    std::unique_ptr<raw_writer> raw_out;
+    if (stdout_mode)
+    {
+      raw_out.reset(new raw_writer(raw_out_fd, stdout_mode == 2, 8));
+    }
+
+    /* Streams are shown live by the display thread, images are kept for display at the end */
+    std::unique_ptr<display_thread> viewer;
+    if (display && results.empty())
+    {
+      viewer.reset(new display_thread("Result", display_fps, std::max(pipe_config.num_streams, 1)));
+    }
+
+    uint64_t tensor_errors = 0;
+    auto sink = [&](frame_t &frame)
+    {
+      if (test_iter > 0) bench.record(frame.t_start, frame_clock_ns());
+      if (writer) writer->submit(frame);
+      if (raw_out) raw_out->submit(frame);
+      if (!tensor_dir.empty() && !save_frame_tensors(tensor_dir, frame, multi_stream)) tensor_errors++;
+
+      if (viewer)
+      {
+        viewer->submit(frame);
+      }
+      else if (display)
+      {
+        results[frame.seq] = frame.image.clone();
+      }
+    };
+
+    pipeline pipe(yolact_model, pipe_config);
+    bench.start();
+    pipe.run([&](frame_t &frame) { return source->read(frame); }, sink);
+
+    /* Wait for the results still queued for writing */
+    if (writer) writer->finish();
+    if (raw_out) raw_out->finish();
+    if (viewer) viewer->stop();
+
+    if (raw_out && raw_out->get_size_errors() > 0)
+    {
+      cv::Size size = raw_out->get_frame_size();
+      cout << "ERROR: --stdout_raw/--stdout_ids need frames of a single size, the output stopped at a frame that isn't "
+           << size.width << "x" << size.height << endl;
+      return -1;
+    }
+
+    if (camera_reader && source->failed())
+    {
+      cout << "ERROR: camera " << v4l2_device << " stopped, " << camera_reader->get_error() << endl;
+    }
+    if (shm_reader && source->failed())
+    {
+      cout << "ERROR: shared memory ring " << shm_name << " stopped, " << shm_reader->get_error() << endl;
+    }
+    if (source->failed()) return -1;
+
+    if (tensor_errors > 0)
+    {
+      cout << "ERROR: unable to write the tensors of " << tensor_errors << " frames to " << tensor_dir << endl;
+    }
+
+    if (stdin_reader && stdin_reader->get_truncated() > 0)
+    {
+      cout << "WARNING: stdin ended with a partial frame of " << stdin_reader->get_truncated() << " bytes, check the"
+           << " --stdin_raw frame size & format" << endl;
+    }
+
+    uint64_t num_frames = pipe.get_frame_count();
+
+    if (verbose || test_iter > 0)
+    {
+      char time_str[20];
+      char fps_str[20];
+      sprintf(time_str, "%1.3f", init_timer.avg_secs());
+      cout << "Initialization time took " << time_str << endl;
+      float avg_proc_time = pipe.get_run_secs() / (float)num_frames;
+      sprintf(time_str, "%1.3f", avg_proc_time);
+      sprintf(fps_str, "%.1f", 1.0f / avg_proc_time);
+      cout << "Average run time was " << time_str << " seconds/frame (FPS = " << fps_str << ") using " << num_threads
+           << ((num_threads == 1) ? " model context" : " model contexts") << endl;
+
+      if (pipe.get_dropped_count() > 0)
+      {
+        cout << "Dropped " << pipe.get_dropped_count() << " frames to keep up with the input (-v shows the reasons)" << endl;
+      }
+
+      if (synthetic)
+      {
+        cout << "Synthetic source missed " << synthetic->get_missed() << " frames that weren't read in time" << endl;
+      }
+
+      if (camera_reader)
+      {
+        cout << "Camera dropped " << camera_reader->get_lost() << " frames while all driver buffers were in use, "
+             << camera_reader->get_timeouts() << " waits of 1 second without a frame" << endl;
+      }
+
+      if (shm_reader)
+      {
+        cout << "Shared memory ring: " << shm_reader->get_lost() << " frames overwritten before they were read, "
+             << shm_reader->get_torn() << " while they were converted" << endl;
+      }
+
+      if (verbose)
+      {
+        pipe.print_stats();
+        source->print_decode_stats();
+        if (viewer) viewer->print_stats();
+      }
+
+      if (test_iter > 0)
+      {
+        bench.print();
+      }
+
+      cout << endl;
+    }
+
+    if (writer)
+    {
+      writer->print_stats();
+      cout << endl;
+    }
+
+    if (raw_out && verbose)
+    {
+      raw_out->print_stats();
+      cout << endl;
+    }
+  }
+  else
+  {
+    /* Compute how many iterations to process based on user input & DPU batch capabilites */
+    if (test_iter > 0)
+    {
+      iter = (test_iter + batch_size * num_threads - 1) / (batch_size * num_threads);
+    }
+    else
+    {
+      iter = (img_cnt + batch_size * num_threads - 1) / (batch_size * num_threads);
+    }
+
+    int num_batches = iter * num_threads;
+
+    /* Read frames from file, in test mode a small ring of frames is reused by every iteration */
+    if (verbose) cout << "Reading image" << endl;
+
+    ring_source frames(num_batches * batch_size, bench_decode);
+    frames.set_reduced_decode(min_decode_size);
+    if (!frames.load(img_files, (test_iter > 0) ? std::min(img_cnt, bench_ring) : img_cnt))
+    {
+      return -1;
+    }
+
+    /* Run the model */
+    if (verbose || test_iter > 0) cout << "Testing model";
+    if (test_iter > 0)
+    {
+      cout << " for " << test_iter << ((test_iter > 1) ? " iterations" : " iteration");
+    }
+
+    cout << endl;
+
+    /* Allocate the input/output buffers, in sequence order.  In test mode each thread
+     * reuses a single batch of buffers so memory doesn't grow with the iteration count.
+     */
+    vector<cv::Mat> images((test_iter > 0) ? num_threads * batch_size : num_batches * batch_size);
+
+    /* Spawn processing threads, idle threads steal batches from busy ones */
+    batch_scheduler scheduler(num_threads, num_batches);
+
+    run_timer.start();
+    bench.start();
+    scheduler.run( [&](int t, int batch)
+    {
+      int first = (test_iter > 0) ? t*batch_size : batch*batch_size;
+      vector<cv::Mat> batch_images(batch_size);
+      vector<cv::Size> src_size(batch_size);
+      uint64_t start_ns = frame_clock_ns();
+
+      for (int b = 0; b < batch_size; b++)
+      {
+        frames.load_frame(batch*batch_size + b, images[first+b], src_size[b]);
+        batch_images[b] = images[first+b];
+      }
+
+      yolact_model[t].run(batch_images, nms_conf_thresh, nms_thresh, score_thresh, src_size,
+                          pipe_config.source_size_output);
+
+      /* The annotated images are new buffers after a reduced decode */
+      for (int b = 0; b < batch_size; b++)
+      {
+        images[first+b] = batch_images[b];
+      }
+      bench.record(start_ns, frame_clock_ns(), batch_size);
+    });
+    run_timer.stop();
+
+    /* Display timing results */
+    if (verbose || test_iter > 0)
+    {
+      char time_str[20];
+      char fps_str[20];
+      sprintf(time_str, "%1.3f", init_timer.avg_secs());
+      cout << "Initialization time took " << time_str << endl;
+      float avg_proc_time = run_timer.avg_secs() / (float)(batch_size * num_threads * iter);
+      sprintf(time_str, "%1.3f", avg_proc_time);
+      sprintf(fps_str, "%.1f", 1.0f / avg_proc_time);
+      cout << "Average run time was " << time_str << " seconds/frame (FPS = " << fps_str << ") using " << num_threads
+           << ((num_threads == 1) ? " thread" : " threads") << endl;
+
+      if (verbose)
+      {
+        for (int t = 0; t < num_threads; t++)
+        {
+          cout << "Thread " << t << ":" << endl;
+          yolact_model[t].print_stats();
+        }
+
+        cout << "Thread load balance:" << endl;
+        scheduler.print_stats();
+        frames.print_decode_stats();
+      }
+
+      if (test_iter > 0)
+      {
+        bench.print();
+      }
+
+      cout << endl;
+    }
+
+    /* Collect the processed images in input order */
+    if (display)
+    {
+      results.assign(images.begin(), images.begin() + img_cnt);
+    }
+  }
+
+  if (perf_counters)
+  {
+    perf_print_stats();
+    cout << endl;
+  }
+
+  if (!trace_file.empty() && !trace_write(trace_file))
+  {
+    cout << "ERROR: unable to write " << trace_file << endl;
+    return -1;
+  }
+
+  /* Display processed images */
+  if (display)
+  {
+    if (disp_wait == 0)
+    {
+      cout << "Displaying results ... hit any key to advance to the next output image" << endl;
+    }
+    else
+    {
+      cout << "Displaying results for " << (float)disp_wait/1000 << " seconds ... hit any key to close the current display" << endl;
+    }
+
+    for (auto &result : results)
+    {
+      /* Frames dropped by the admission policy have no result */
+      if (result.empty()) continue;
+
+      cv::imshow("Result", result);
+      cv::waitKey(disp_wait);
     }
   }
 
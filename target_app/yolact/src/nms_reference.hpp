@@ -0,0 +1,107 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _NMS_REFERENCE_HPP_
+#define _NMS_REFERENCE_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/*
+ * Host replacement of the Vitis AI Library's applyNMS (xnnpp/src/apply_nms.cpp)
+ *
+ * Used by YOLACT_NO_VITIS builds of yolact.hpp so the CPU post-processing
+ * can be benchmarked & validated on machines without the Vitis AI libraries.
+ * Same greedy algorithm & tie-breaking as the library: boxes are visited in
+ * descending score order (stable for equal scores), boxes under the
+ * confidence threshold are skipped and every kept box suppresses the later
+ * boxes whose IoU with it is at least the NMS threshold.
+ */
+
+/* yolact.hpp & coco_labels.hpp use the std names the Vitis AI headers bring into scope */
+using namespace std;
+
+/* Overlap of two segments given as center & length */
+static inline float nms_overlap( float x1, float w1, float x2, float w2 )
+{
+  float left = std::max(x1 - w1 / 2.0f, x2 - w2 / 2.0f);
+  float right = std::min(x1 + w1 / 2.0f, x2 + w2 / 2.0f);
+  return right - left;
+}
+
+/* IoU of two boxes given as center x, center y, width & height */
+static inline float nms_iou( const std::vector<float> &box, const std::vector<float> &truth )
+{
+  float w = nms_overlap(box[0], box[2], truth[0], truth[2]);
+  float h = nms_overlap(box[1], box[3], truth[1], truth[3]);
+  if (w < 0 || h < 0) return 0;
+
+  float inter_area = w * h;
+  float union_area = box[2] * box[3] + truth[2] * truth[3] - inter_area;
+  return inter_area / union_area;
+}
+
+static inline void applyNMS( const std::vector<std::vector<float>> &boxes,
+                             const std::vector<float>              &scores,
+                             const float                            nms,
+                             const float                            conf,
+                             std::vector<size_t>                   &res,
+                             bool                                   stable = true )
+{
+  const size_t count = boxes.size();
+  std::vector<std::pair<float, size_t>> order;
+  for (size_t i = 0; i < count; i++)
+  {
+    order.emplace_back(scores[i], i);
+  }
+
+  auto by_score = [](const std::pair<float, size_t> &ls, const std::pair<float, size_t> &rs) { return ls.first > rs.first; };
+  if (stable)
+  {
+    std::stable_sort(order.begin(), order.end(), by_score);
+  }
+  else
+  {
+    std::sort(order.begin(), order.end(), by_score);
+  }
+
+  std::vector<bool> exist_box(count, true);
+  for (size_t _i = 0; _i < count; _i++)
+  {
+    size_t i = order[_i].second;
+    if (!exist_box[i]) continue;
+    if (scores[i] < conf)
+    {
+      exist_box[i] = false;
+      continue;
+    }
+
+    /* Keep the box & suppress the lower scoring boxes overlapping it */
+    res.push_back(i);
+    for (size_t _j = _i + 1; _j < count; _j++)
+    {
+      size_t j = order[_j].second;
+      if (!exist_box[j]) continue;
+      if (nms_iou(boxes[j], boxes[i]) >= nms) exist_box[j] = false;
+    }
+  }
+}
+
+#endif
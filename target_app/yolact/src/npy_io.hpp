@@ -0,0 +1,152 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _NPY_IO_HPP_
+#define _NPY_IO_HPP_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * Minimal reader & writer of NumPy .npy files
+ *
+ * Only handles what the tensor recordings need: little-endian float32
+ * arrays in C order (numpy.save of a float32 array, torch tensors via
+ * .numpy()).  Used to exchange output tensors & results with the Python
+ * model code.
+ */
+
+/* Writes a float32 array of the given shape, returns false on I/O errors */
+static inline bool npy_write( const std::string &path, const float *data, const std::vector<size_t> &shape )
+{
+  std::string header = "{'descr': '<f4', 'fortran_order': False, 'shape': (";
+  size_t count = 1;
+  for (size_t d = 0; d < shape.size(); d++)
+  {
+    header += std::to_string(shape[d]) + ((shape.size() == 1 || d + 1 < shape.size()) ? "," : "");
+    if (d + 1 < shape.size()) header += " ";
+    count *= shape[d];
+  }
+  header += "), }";
+
+  /* The magic, version, length & header are padded to a multiple of 64 bytes ending with a newline */
+  size_t total = 10 + header.size() + 1;
+  header.append((64 - total % 64) % 64, ' ');
+  header += '\n';
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) return false;
+
+  uint16_t len = (uint16_t)header.size();
+  unsigned char preamble[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0, (unsigned char)(len & 0xff), (unsigned char)(len >> 8) };
+  bool ok = fwrite(preamble, 1, sizeof(preamble), file) == sizeof(preamble) &&
+            fwrite(header.data(), 1, header.size(), file) == header.size() &&
+            fwrite(data, sizeof(float), count, file) == count;
+
+  return (fclose(file) == 0) && ok;
+}
+
+/* Reads a float32 array, returns false with a message in error if the file isn't a supported .npy */
+static inline bool npy_read( const std::string &path, std::vector<float> &data, std::vector<size_t> &shape,
+                             std::string &error )
+{
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr)
+  {
+    error = "unable to open " + path;
+    return false;
+  }
+
+  unsigned char preamble[12];
+  uint32_t len = 0;
+  if (fread(preamble, 1, 8, file) != 8 || memcmp(preamble, "\x93NUMPY", 6) != 0)
+  {
+    error = path + " is not a .npy file";
+    fclose(file);
+    return false;
+  }
+
+  /* Version 1 has a 16-bit header length, versions 2 & 3 a 32-bit one */
+  int len_bytes = (preamble[6] == 1) ? 2 : 4;
+  if (fread(preamble + 8, 1, len_bytes, file) != (size_t)len_bytes)
+  {
+    error = path + " is truncated";
+    fclose(file);
+    return false;
+  }
+  for (int b = len_bytes - 1; b >= 0; b--)
+  {
+    len = (len << 8) | preamble[8 + b];
+  }
+
+  std::string header(len, ' ');
+  if (fread(&header[0], 1, len, file) != len)
+  {
+    error = path + " is truncated";
+    fclose(file);
+    return false;
+  }
+
+  if (header.find("'descr': '<f4'") == std::string::npos || header.find("'fortran_order': False") == std::string::npos)
+  {
+    error = path + " is not a float32 array in C order";
+    fclose(file);
+    return false;
+  }
+
+  /* Parses the shape tuple, e.g. (1, 19248, 4) */
+  size_t pos = header.find("'shape':");
+  size_t open = header.find('(', pos);
+  size_t close = header.find(')', open);
+  if (pos == std::string::npos || open == std::string::npos || close == std::string::npos)
+  {
+    error = path + " has no shape";
+    fclose(file);
+    return false;
+  }
+
+  shape.clear();
+  size_t count = 1;
+  const char *p = header.c_str() + open + 1;
+  const char *end = header.c_str() + close;
+  while (p < end)
+  {
+    char *stop;
+    unsigned long long dim = strtoull(p, &stop, 10);
+    if (stop == p)
+    {
+      p++;
+      continue;
+    }
+    shape.push_back((size_t)dim);
+    count *= (size_t)dim;
+    p = stop;
+  }
+
+  data.resize(count);
+  bool ok = fread(data.data(), sizeof(float), count, file) == count;
+  fclose(file);
+  if (!ok) error = path + " is truncated";
+
+  return ok;
+}
+
+#endif
@@ -0,0 +1,301 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _PERF_COUNTERS_HPP_
+#define _PERF_COUNTERS_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Hardware performance counters per processing step
+ *
+ * Every thread that enters a perf_scope opens its own perf_event group
+ * (cycles, instructions, cache misses & branch misses of user space code,
+ * counting that thread only) and the counter deltas between the start & end
+ * of a scope are added to the step's totals, scaled when the kernel had to
+ * multiplex the counters.  Reading a group is one read() system call, so a
+ * scope costs a few microseconds: only enable this mode to analyze where
+ * the CPU steps spend their cycles.  Counters that can't be opened (no PMU
+ * access in containers or VMs, perf_event_paranoid, unsupported events) are
+ * reported as unavailable and cost nothing.
+ */
+
+/* Instrumented steps */
+enum
+{
+  PERF_PREPROCESS = 0,
+  PERF_SCAN,             // get_multi_class_max_score_index
+  PERF_NMS,
+  PERF_MASK,             // draw_masks
+  PERF_OVERLAY,          // draw_boxes
+  NUM_PERF_STEPS
+};
+
+static const char *perf_step_names[NUM_PERF_STEPS] =
+{
+  "preprocess", "scan", "nms", "mask", "overlay"
+};
+
+enum
+{
+  PERF_CYCLES = 0,
+  PERF_INSTRUCTIONS,
+  PERF_CACHE_MISSES,
+  PERF_BRANCH_MISSES,
+  NUM_PERF_COUNTERS
+};
+
+static const char *perf_counter_names[NUM_PERF_COUNTERS] =
+{
+  "cycles", "instructions", "cache-misses", "branch-misses"
+};
+
+/* Counter group & step totals of one thread, only written by that thread */
+typedef struct
+{
+  int      fds[NUM_PERF_COUNTERS];
+  int      slot[NUM_PERF_COUNTERS];                    // Position in the group read, -1 = unavailable
+  int      num_open = 0;
+  double   totals[NUM_PERF_STEPS][NUM_PERF_COUNTERS] = {};
+  uint64_t calls[NUM_PERF_STEPS] = {};
+} perf_thread_t;
+
+typedef struct
+{
+  std::atomic<bool>                           enabled{false};
+  std::mutex                                  mtx;
+  std::vector<std::unique_ptr<perf_thread_t>> threads;
+  int                                         open_errno[NUM_PERF_COUNTERS] = {};
+} perf_state_t;
+
+static inline perf_state_t &perf_state()
+{
+  static perf_state_t state;
+  return state;
+}
+
+static inline bool perf_enabled() { return perf_state().enabled.load(std::memory_order_relaxed); }
+
+/* Starts counting the perf_scopes of all threads */
+static inline void perf_start() { perf_state().enabled = true; }
+
+/* Opens the counter group of the calling thread on first use */
+static inline perf_thread_t *perf_thread()
+{
+  static thread_local perf_thread_t *self = nullptr;
+  if (self != nullptr) return self;
+
+  static const uint64_t configs[NUM_PERF_COUNTERS] =
+  {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  perf_state_t &state = perf_state();
+  std::unique_ptr<perf_thread_t> t(new perf_thread_t());
+  int leader = -1;
+
+  for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+  {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[c];
+    attr.disabled = (leader < 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    /* This thread on any CPU */
+    int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+    t->fds[c] = fd;
+    t->slot[c] = -1;
+    if (fd < 0)
+    {
+      std::lock_guard<std::mutex> lock(state.mtx);
+      state.open_errno[c] = errno;
+      continue;
+    }
+
+    if (leader < 0) leader = fd;
+    t->slot[c] = t->num_open++;
+  }
+
+  if (leader >= 0) ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+  std::lock_guard<std::mutex> lock(state.mtx);
+  self = t.get();
+  state.threads.push_back(std::move(t));
+  return self;
+}
+
+/*
+ * Adds the counter deltas from construction to destruction to a step
+ */
+class perf_scope
+{
+  public:
+
+    perf_scope( int step ) : step(step), thread(nullptr)
+    {
+      if (!perf_enabled()) return;
+
+      thread = perf_thread();
+      if (thread->num_open == 0 || !read_group(begin))
+      {
+        thread = nullptr;
+      }
+    }
+
+    ~perf_scope()
+    {
+      if (thread == nullptr) return;
+
+      group_read_t end;
+      if (!read_group(end)) return;
+
+      /* Scales for the share of the interval the group was actually counting */
+      uint64_t enabled = end.time_enabled - begin.time_enabled;
+      uint64_t running = end.time_running - begin.time_running;
+      if (running == 0) return;
+      double scale = (double)enabled / (double)running;
+
+      for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+      {
+        int s = thread->slot[c];
+        if (s < 0) continue;
+        thread->totals[step][c] += (double)(end.values[s] - begin.values[s]) * scale;
+      }
+      thread->calls[step]++;
+    }
+
+  private:
+
+    typedef struct
+    {
+      uint64_t nr;
+      uint64_t time_enabled;
+      uint64_t time_running;
+      uint64_t values[NUM_PERF_COUNTERS];
+    } group_read_t;
+
+    int            step;
+    perf_thread_t *thread;
+    group_read_t   begin;
+
+    bool read_group( group_read_t &data )
+    {
+      int leader = -1;
+      for (int c = 0; c < NUM_PERF_COUNTERS && leader < 0; c++)
+      {
+        if (thread->slot[c] >= 0) leader = thread->fds[c];
+      }
+      return read(leader, &data, sizeof(data)) > 0;
+    }
+};
+
+/* Prints the counters per call of every step, summed over all threads */
+static inline void perf_print_stats()
+{
+  perf_state_t &state = perf_state();
+  std::lock_guard<std::mutex> lock(state.mtx);
+  char line[160];
+
+  double totals[NUM_PERF_STEPS][NUM_PERF_COUNTERS] = {};
+  uint64_t calls[NUM_PERF_STEPS] = {};
+  bool available[NUM_PERF_COUNTERS] = {};
+
+  for (auto &t : state.threads)
+  {
+    for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+    {
+      if (t->slot[c] >= 0) available[c] = true;
+    }
+    for (int s = 0; s < NUM_PERF_STEPS; s++)
+    {
+      calls[s] += t->calls[s];
+      for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+      {
+        totals[s][c] += t->totals[s][c];
+      }
+    }
+  }
+
+  std::cout << "Hardware counters (user space, per frame):" << std::endl;
+  for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+  {
+    if (!available[c] && state.open_errno[c] != 0)
+    {
+      std::cout << "  " << perf_counter_names[c] << " unavailable: " << strerror(state.open_errno[c]) << std::endl;
+    }
+  }
+  if (!available[PERF_CYCLES] && !available[PERF_INSTRUCTIONS] && !available[PERF_CACHE_MISSES] &&
+      !available[PERF_BRANCH_MISSES])
+  {
+    std::cout << "  No counters could be opened (no PMU access, check perf_event_paranoid or the container profile)"
+              << std::endl;
+    return;
+  }
+
+  sprintf(line, "  %-12s %8s %14s %14s %6s %14s %14s %8s", "Step", "Frames", "Cycles", "Instructions", "IPC",
+          "Cache misses", "Branch misses", "MPKI");
+  std::cout << line << std::endl;
+
+  for (int s = 0; s < NUM_PERF_STEPS; s++)
+  {
+    if (calls[s] == 0) continue;
+
+    double n = (double)calls[s];
+    const double *v = totals[s];
+    char ipc[16] = "n/a", mpki[16] = "n/a";
+    char cnt[NUM_PERF_COUNTERS][24];
+
+    for (int c = 0; c < NUM_PERF_COUNTERS; c++)
+    {
+      if (available[c]) sprintf(cnt[c], "%.0f", v[c] / n);
+      else strcpy(cnt[c], "n/a");
+    }
+    if (available[PERF_CYCLES] && available[PERF_INSTRUCTIONS] && v[PERF_CYCLES] > 0.0)
+    {
+      sprintf(ipc, "%.2f", v[PERF_INSTRUCTIONS] / v[PERF_CYCLES]);
+    }
+    if (available[PERF_INSTRUCTIONS] && available[PERF_CACHE_MISSES] && v[PERF_INSTRUCTIONS] > 0.0)
+    {
+      sprintf(mpki, "%.2f", v[PERF_CACHE_MISSES] * 1000.0 / v[PERF_INSTRUCTIONS]);
+    }
+
+    sprintf(line, "  %-12s %8llu %14s %14s %6s %14s %14s %8s", perf_step_names[s], (unsigned long long)calls[s],
+            cnt[PERF_CYCLES], cnt[PERF_INSTRUCTIONS], ipc, cnt[PERF_CACHE_MISSES], cnt[PERF_BRANCH_MISSES], mpki);
+    std::cout << line << std::endl;
+  }
+}
+
+#endif
@@ -0,0 +1,1009 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PIPELINE_HPP_
+#define _PIPELINE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Application Header files
+#include "yolact.hpp"
+#include "frame.hpp"
+#include "bounded_queue.hpp"
+#include "spsc_ring.hpp"
+#include "frame_pool.hpp"
+#include "source.hpp"
+#include "reorder_buffer.hpp"
+#include "deadline_queue.hpp"
+#include "affinity.hpp"
+#include "latency_timer.hpp"
+#include "trace.hpp"
+
+/* Pipeline stages, in processing order */
+enum
+{
+  STAGE_DECODE = 0,
+  STAGE_PREPROCESS,
+  STAGE_INFER,
+  STAGE_POSTPROCESS,
+  STAGE_RENDER,
+  STAGE_SINK,
+  NUM_STAGES
+};
+
+static const char *stage_names[NUM_STAGES] =
+{
+  "decode", "preprocess", "infer", "postprocess", "render", "sink"
+};
+
+/* Admission policies of the pipeline input (the decode -> preprocess queue) */
+enum
+{
+  ADMIT_BLOCK = 0,     // Decode waits for room, the source is slowed down to the pipeline rate
+  ADMIT_DROP_NEWEST,   // A new frame is dropped while the input queue is full
+  ADMIT_DROP_OLDEST,   // The oldest waiting frame is dropped to make room for a new one
+  ADMIT_KEEP_LATEST,   // Only the newest frame waits for the pipeline (drop-oldest with a queue of one)
+  NUM_ADMIT_POLICIES
+};
+
+static const char *admit_names[NUM_ADMIT_POLICIES] =
+{
+  "block", "drop_newest", "drop_oldest", "keep_latest"
+};
+
+/* Reasons for dropping a frame before it is processed */
+enum
+{
+  DROP_INPUT_FULL = 0,   // Rejected by drop_newest
+  DROP_EVICTED,          // Replaced by a newer frame (drop_oldest, keep_latest)
+  DROP_LAG,              // Older than max_lag_ms when it reached preprocessing
+  DROP_DEADLINE,         // Deadline already missed when it reached the infer stage
+  DROP_OVERWRITTEN,      // Zero-copy input buffer overwritten by its producer before it was converted
+  NUM_DROP_REASONS
+};
+
+static const char *drop_names[NUM_DROP_REASONS] =
+{
+  "input full", "evicted", "over max lag", "deadline missed", "overwritten"
+};
+
+/* Pipeline configuration */
+typedef struct
+{
+  int   workers[NUM_STAGES];   // Worker threads per stage (infer = number of model contexts)
+  int   queue_depth;           // Capacity of the queue between two stages
+  int   inflight;              // Maximum number of frames in flight (0 = all queues & workers can be full)
+  float score_thresh;          // Score threshold used by the render stage
+  bool  render;                // Render stage draws the overlays (off = frames are delivered with only the detections)
+  bool  label_masks;           // Render stage also fills frame_t::label_mask
+  bool  source_size_output;    // Render stage scales reduced-decode images back to the original size
+  float report_interval;       // Seconds between throughput/latency reports (0 = off)
+  int   admission;             // Admission policy of the pipeline input (ADMIT_*)
+  float max_lag_ms;            // Frames older than this are skipped before preprocessing (0 = off)
+  int   num_streams;           // Multiplexed input streams, delivered per stream in order (0 = single unordered stream)
+  int   reorder_frames;        // Maximum number of frames held by the reorder buffer
+  float reorder_wait_ms;       // Maximum time a frame waits in the reorder buffer for its predecessors
+  float batch_timeout_ms;      // Partial DPU batches are dispatched after waiting this long (0 = wait for a full batch)
+  bool  priority_scheduling;   // Serve the infer stage by priority class & earliest deadline, shed missed deadlines
+  uint64_t cpu_mask[NUM_STAGES];  // CPUs the workers of a stage are pinned to (bit N = CPU N, 0 = not pinned)
+  int   infer_fifo_priority;   // SCHED_FIFO priority of the infer workers (0 = normal scheduling)
+} pipeline_config_t;
+
+static inline void pipeline_default_config( pipeline_config_t &config )
+{
+  for (int s = 0; s < NUM_STAGES; s++)
+  {
+    config.workers[s] = 1;
+    config.cpu_mask[s] = 0;
+  }
+  config.queue_depth     = 4;
+  config.inflight        = 0;
+  config.score_thresh    = 0.0f;
+  config.render          = true;
+  config.label_masks     = false;
+  config.source_size_output = false;
+  config.report_interval = 0.0f;
+  config.admission       = ADMIT_BLOCK;
+  config.max_lag_ms      = 0.0f;
+  config.num_streams     = 0;
+  config.reorder_frames  = 16;
+  config.reorder_wait_ms = 100.0f;
+  config.batch_timeout_ms = 0.0f;
+  config.priority_scheduling = false;
+  config.infer_fifo_priority = 0;
+}
+
+/* Returns the stage index for a stage name or -1 if the name is unknown */
+static inline int pipeline_stage_index( const std::string &name )
+{
+  for (int s = 0; s < NUM_STAGES; s++)
+  {
+    if (name == stage_names[s]) return s;
+  }
+  return -1;
+}
+
+/* Returns the admission policy for a policy name or -1 if the name is unknown */
+static inline int pipeline_admit_index( const std::string &name )
+{
+  for (int p = 0; p < NUM_ADMIT_POLICIES; p++)
+  {
+    if (name == admit_names[p]) return p;
+  }
+  return -1;
+}
+
+/*
+ * Parses a "stage=N,stage=N,..." list of worker counts,
+ * e.g. "decode=2,preprocess=2,postprocess=3"
+ */
+static inline bool pipeline_parse_workers( const char *arg, pipeline_config_t &config )
+{
+  std::string list(arg);
+  size_t pos = 0;
+
+  while (pos < list.size())
+  {
+    size_t end = list.find(',', pos);
+    if (end == std::string::npos) end = list.size();
+
+    std::string item = list.substr(pos, end - pos);
+    size_t eq = item.find('=');
+    if (eq == std::string::npos) return false;
+
+    int stage = pipeline_stage_index(item.substr(0, eq));
+    int workers = atoi(item.substr(eq + 1).c_str());
+    if (stage < 0 || workers < 1) return false;
+
+    config.workers[stage] = workers;
+    pos = end + 1;
+  }
+
+  return true;
+}
+
+/*
+ * Parses a "stage=cpus" thread placement, e.g. "infer=1" or "postprocess=2-3"
+ */
+static inline bool pipeline_parse_affinity( const char *arg, pipeline_config_t &config )
+{
+  std::string item(arg);
+  size_t eq = item.find('=');
+  if (eq == std::string::npos) return false;
+
+  int stage = pipeline_stage_index(item.substr(0, eq));
+  uint64_t mask;
+  if (stage < 0 || !parse_cpu_list(item.substr(eq + 1), mask)) return false;
+
+  config.cpu_mask[stage] = mask;
+  return true;
+}
+
+/*
+ * Staged multi-threaded processing pipeline
+ *
+ *   decode -> preprocess -> infer -> postprocess -> render -> sink
+ *
+ * Every stage runs its own pool of worker threads and is connected to the
+ * next stage by a bounded queue, so a slow stage can be given more cores
+ * without starving the others.  Each infer worker owns one model context
+ * and collects up to batch_size frames per DPU execution from whichever
+ * stream or worker produced them.  A partial batch is dispatched once the
+ * first frame of the batch has waited batch_timeout_ms, which bounds the
+ * latency added by batching when the input rate is low.
+ *
+ * With priority scheduling the infer stage takes frames by priority class
+ * and earliest deadline, so urgent streams preempt bulk work at the next
+ * batch boundary, and frames whose deadline has already passed are shed
+ * instead of occupying the DPU.
+ *
+ * The decode stage calls the user supplied source to fill new frames and
+ * the sink stage hands finished frames to the user supplied sink.  With more
+ * than one worker in a stage frames can reach the sink out of order; the
+ * frame sequence number identifies the input.
+ *
+ * Frames come from a fixed-size frame_pool and are recycled after the sink,
+ * so the sink must copy anything it wants to keep.  Queues between two
+ * single-worker stages are lock-free SPSC rings, all others are mutex based.
+ *
+ * For live sources the admission policy decides what happens when the
+ * pipeline can't keep up: block the source, or drop the newest or oldest
+ * waiting frame so the source is never stalled.  Frames that exceed the
+ * maximum lag are skipped before preprocessing.  Dropped frames never reach
+ * the sink, so the sink may see gaps in the sequence numbers.
+ *
+ * With several multiplexed streams the sink stage passes the frames through
+ * a reorder buffer, so each stream reaches the sink in sequence order even
+ * though frames of all streams share the DPU batches.
+ *
+ * The workers of a stage can be pinned to a set of CPUs and the infer
+ * workers, which submit the DPU jobs, can run with SCHED_FIFO, so the CPU
+ * stages don't migrate onto the cores that serve the DPU.  The service time
+ * of every stage & worker is recorded into latency histograms, whose
+ * standard deviation & percentiles quantify the effect of the placement.
+ */
+class pipeline
+{
+  public:
+
+    typedef std::function<bool(frame_t &)> source_fn;
+    typedef std::function<void(frame_t &)> sink_fn;
+
+    pipeline( yolact *models, pipeline_config_t &config ) : models(models), config(config)
+    {
+      for (int s = 0; s < NUM_STAGES; s++)
+      {
+        busy_timers[s].resize(config.workers[s]);
+        frame_cnt[s] = 0;
+      }
+
+      /* Every worker holds at most one frame (infer workers one batch) on top of the queued frames */
+      size_t pool_frames = (NUM_STAGES-1) * config.queue_depth;
+      for (int s = 0; s < NUM_STAGES; s++)
+      {
+        pool_frames += config.workers[s] * ((s == STAGE_INFER) ? models[0].get_batch_size() : 1);
+      }
+
+      /* Frames held by the reorder buffer */
+      if (config.num_streams > 0)
+      {
+        pool_frames += config.reorder_frames;
+      }
+
+      /* A smaller in-flight window limits read-ahead, but every infer worker must be able to fill a batch */
+      if (config.inflight > 0)
+      {
+        size_t min_frames = config.workers[STAGE_INFER] * models[0].get_batch_size();
+        pool_frames = std::max(std::min(pool_frames, (size_t)config.inflight), min_frames);
+      }
+
+      pool.reset(new frame_pool( pool_frames,
+                                 models[0].get_input_size(),
+                                 NUM_PRIORS*4,
+                                 NUM_PRIORS*NUM_CLASSES,
+                                 NUM_PRIORS*PROTO_C,
+                                 PROTO_SIZE ));
+
+      for (int r = 0; r < NUM_DROP_REASONS; r++)
+      {
+        dropped[r] = 0;
+      }
+
+      batches = 0;
+      partial_batches = 0;
+      placement_failures = 0;
+
+      for (int p = 0; p < NUM_PRIORITIES; p++)
+      {
+        class_delivered[p] = 0;
+        class_deadlines[p] = 0;
+        class_hits[p] = 0;
+        class_shed[p] = 0;
+      }
+
+      if (config.num_streams > 0)
+      {
+        reorder.reset(new reorder_buffer(config.num_streams, config.reorder_frames, config.reorder_wait_ms,
+                                         [this](frame_t *frame) { deliver(frame); },
+                                         [this](frame_t *frame) { pool->release(frame); }));
+        stream_latency.resize(config.num_streams);
+      }
+
+      /* Dropping the oldest frame pops the input queue from the producer side, which needs a mutex queue */
+      bool evict = (config.admission == ADMIT_DROP_OLDEST || config.admission == ADMIT_KEEP_LATEST);
+
+      for (int s = 0; s < NUM_STAGES-1; s++)
+      {
+        size_t depth = (s == STAGE_DECODE && config.admission == ADMIT_KEEP_LATEST) ? 1 : config.queue_depth;
+
+        /* Decoded frames are already preprocessed by priority, so a bulk backlog can't delay the others */
+        if ((s == STAGE_PREPROCESS || (s == STAGE_DECODE && !evict)) && config.priority_scheduling)
+        {
+          queues[s].reset(new deadline_queue(depth));
+          queue_types[s] = "edf";
+        }
+        else if (config.workers[s] == 1 && config.workers[s+1] == 1 && !(s == STAGE_DECODE && evict))
+        {
+          queues[s].reset(new spsc_ring<frame_t*>(depth));
+          queue_types[s] = "spsc";
+        }
+        else
+        {
+          queues[s].reset(new bounded_queue<frame_t*>(depth));
+          queue_types[s] = "mutex";
+        }
+      }
+    }
+
+    /* Runs the pipeline until the source is exhausted & all frames reached the sink */
+    void run( source_fn source, sink_fn sink )
+    {
+      l_source = source;
+      l_sink = sink;
+
+      std::vector<std::thread> threads;
+
+      run_timer.reset();
+      run_timer.start();
+
+      run_start_ns = frame_clock_ns();
+      report_start_ns = run_start_ns;
+      report_frames = 0;
+      report_latency_sum = 0;
+      report_latency_max = 0;
+      latency_sum = 0;
+      latency_max = 0;
+      for (auto &stream : stream_latency)
+      {
+        stream = {0, 0, 0};
+      }
+
+      for (int s = 0; s < NUM_STAGES; s++)
+      {
+        active[s] = config.workers[s];
+
+        for (int w = 0; w < config.workers[s]; w++)
+        {
+          busy_timers[s][w].reset();
+
+          if (s == STAGE_DECODE)
+          {
+            threads.emplace_back(&pipeline::decode_worker, this, w);
+          }
+          else if (s == STAGE_INFER)
+          {
+            threads.emplace_back(&pipeline::infer_worker, this, w);
+          }
+          else
+          {
+            threads.emplace_back(&pipeline::stage_worker, this, s, w);
+          }
+        }
+      }
+
+      for (auto &thread : threads)
+      {
+        thread.join();
+      }
+
+      run_timer.stop();
+    }
+
+    uint64_t get_frame_count() { return frame_cnt[STAGE_SINK]; }
+
+    uint64_t get_dropped_count()
+    {
+      uint64_t total = 0;
+      for (int r = 0; r < NUM_DROP_REASONS; r++)
+      {
+        total += dropped[r];
+      }
+      return total;
+    }
+
+    float get_run_secs() { return run_timer.secs(); }
+
+    /* Service times of all workers of a stage (per batch for the infer stage) */
+    latency_histogram get_service_times( int stage )
+    {
+      latency_histogram service;
+      for (auto &timer : busy_timers[stage])
+      {
+        service.merge(timer.histogram());
+      }
+      return service;
+    }
+
+    size_t get_pool_size() { return pool->size(); }
+
+    /* Share of the run time the workers of a stage were busy */
+    float get_utilization( int stage )
+    {
+      float busy_secs = 0.0f;
+      for (auto &timer : busy_timers[stage])
+      {
+        busy_secs += timer.secs();
+      }
+
+      float wall_secs = run_timer.secs();
+      return (wall_secs > 0.0f) ? busy_secs / (wall_secs * config.workers[stage]) : 0.0f;
+    }
+
+    /* Prints per-stage utilization & queue-depth statistics */
+    void print_stats()
+    {
+      char line[128];
+      float wall_secs = run_timer.secs();
+
+      sprintf(line, "Pipeline: %llu frames in %1.3f seconds (FPS = %.1f)",
+              (unsigned long long)frame_cnt[STAGE_SINK], wall_secs,
+              (wall_secs > 0.0f) ? (float)frame_cnt[STAGE_SINK] / wall_secs : 0.0f);
+      std::cout << line << std::endl;
+
+      sprintf(line, "  %-12s %8s %8s %12s %8s %12s %8s", "Stage", "Workers", "Frames", "Avg (sec)", "Util",
+              "Stddev (ms)", "CPUs");
+      std::cout << line << std::endl;
+
+      for (int s = 0; s < NUM_STAGES; s++)
+      {
+        float busy_secs = 0.0f;
+        for (auto &timer : busy_timers[s])
+        {
+          busy_secs += timer.secs();
+        }
+
+        float avg_secs = (frame_cnt[s] > 0) ? busy_secs / (float)frame_cnt[s] : 0.0f;
+        float util = (wall_secs > 0.0f) ? busy_secs / (wall_secs * config.workers[s]) : 0.0f;
+
+        /* Service time jitter, per batch for the infer stage */
+        latency_histogram service = get_service_times(s);
+        std::string cpus = (config.cpu_mask[s] != 0) ? cpu_list_string(config.cpu_mask[s]) : "any";
+
+        sprintf(line, "  %-12s %8d %8llu %12.4f %7.1f%% %12.3f %8s", stage_names[s], config.workers[s],
+                (unsigned long long)frame_cnt[s], avg_secs, util * 100.0f, service.get_stddev() * 1e-6, cpus.c_str());
+        std::cout << line << std::endl;
+      }
+
+      /* Service time distribution of every stage, and of every worker of stages with several */
+      print_latency_header("Service time");
+      for (int s = 0; s < NUM_STAGES; s++)
+      {
+        print_latency_row(stage_names[s], get_service_times(s));
+        if (config.workers[s] < 2) continue;
+
+        for (int w = 0; w < config.workers[s]; w++)
+        {
+          print_latency_row("  " + std::string(stage_names[s]) + "[" + std::to_string(w) + "]",
+                            busy_timers[s][w].histogram());
+        }
+      }
+
+      sprintf(line, "  %-26s %6s %8s %8s %8s", "Queue", "Type", "Capacity", "Avg", "Max");
+      std::cout << line << std::endl;
+
+      for (int s = 0; s < NUM_STAGES-1; s++)
+      {
+        std::string name = std::string(stage_names[s]) + " -> " + stage_names[s+1];
+        sprintf(line, "  %-26s %6s %8zu %8.2f %8zu", name.c_str(), queue_types[s], queues[s]->get_capacity(),
+                queues[s]->avg_depth(), queues[s]->get_max_depth());
+        std::cout << line << std::endl;
+      }
+
+      std::cout << "  Frame pool: " << pool->size() << " frames" << std::endl;
+
+      if (config.infer_fifo_priority > 0)
+      {
+        sprintf(line, "  Infer workers: SCHED_FIFO priority %d", config.infer_fifo_priority);
+        std::cout << line << std::endl;
+      }
+      if (placement_failures > 0)
+      {
+        sprintf(line, "  Thread placement failed for %d workers (CPU not online or missing CAP_SYS_NICE)",
+                (int)placement_failures);
+        std::cout << line << std::endl;
+      }
+
+      /* Batch fill: share of the DPU batch slots that carried a frame */
+      float infer_busy = 0.0f;
+      for (auto &timer : busy_timers[STAGE_INFER])
+      {
+        infer_busy += timer.secs();
+      }
+      float infer_util = (wall_secs > 0.0f) ? infer_busy / (wall_secs * config.workers[STAGE_INFER]) : 0.0f;
+      float fill = (batches > 0) ? (float)frame_cnt[STAGE_INFER] / (float)(batches * models[0].get_batch_size()) : 0.0f;
+
+      sprintf(line, "  DPU batches: %llu (%llu partial), batch fill %.1f%%, slot utilization %.1f%%",
+              (unsigned long long)batches, (unsigned long long)partial_batches, fill * 100.0f,
+              infer_util * fill * 100.0f);
+      std::cout << line << std::endl;
+
+      sprintf(line, "  Admission policy: %s, max lag: ", admit_names[config.admission]);
+      std::cout << line;
+      if (config.max_lag_ms > 0.0f) std::cout << config.max_lag_ms << " ms" << std::endl;
+      else std::cout << "off" << std::endl;
+
+      for (int r = 0; r < NUM_DROP_REASONS; r++)
+      {
+        sprintf(line, "  Dropped (%s): %llu frames", drop_names[r], (unsigned long long)dropped[r]);
+        std::cout << line << std::endl;
+      }
+
+      uint64_t frames = frame_cnt[STAGE_SINK];
+      sprintf(line, "  End-to-end latency: avg %.1f ms, max %.1f ms",
+              (frames > 0) ? (float)latency_sum * 1e-6f / (float)frames : 0.0f, (float)latency_max * 1e-6f);
+      std::cout << line << std::endl;
+
+      if (config.priority_scheduling)
+      {
+        sprintf(line, "  %-10s %10s %10s %10s %10s %10s", "Class", "Delivered", "Deadlines", "Met", "Shed", "Hit rate");
+        std::cout << line << std::endl;
+
+        for (int p = 0; p < NUM_PRIORITIES; p++)
+        {
+          /* Shed frames count as missed deadlines */
+          uint64_t due = class_deadlines[p] + class_shed[p];
+          sprintf(line, "  %-10s %10llu %10llu %10llu %10llu %9.1f%%", priority_names[p],
+                  (unsigned long long)class_delivered[p], (unsigned long long)due,
+                  (unsigned long long)class_hits[p], (unsigned long long)class_shed[p],
+                  (due > 0) ? (float)class_hits[p] * 100.0f / (float)due : 100.0f);
+          std::cout << line << std::endl;
+        }
+      }
+
+      if (reorder)
+      {
+        sprintf(line, "  %-8s %8s %8s %12s %12s %8s %8s %8s", "Stream", "Frames", "FPS", "Lat avg(ms)", "Lat max(ms)",
+                "Held", "Late", "Gaps");
+        std::cout << line << std::endl;
+
+        for (int st = 0; st < config.num_streams; st++)
+        {
+          stream_latency_t &lat = stream_latency[st];
+          reorder_buffer::stream_stats_t stats = reorder->get_stats(st);
+
+          sprintf(line, "  %-8d %8llu %8.1f %12.1f %12.1f %8zu %8llu %8llu", st, (unsigned long long)lat.frames,
+                  (wall_secs > 0.0f) ? (float)lat.frames / wall_secs : 0.0f,
+                  (lat.frames > 0) ? (float)lat.sum * 1e-6f / (float)lat.frames : 0.0f, (float)lat.max * 1e-6f,
+                  stats.max_held, (unsigned long long)stats.late, (unsigned long long)stats.gaps);
+          std::cout << line << std::endl;
+        }
+      }
+    }
+
+  private:
+
+    yolact                                   *models;
+    pipeline_config_t                         config;
+    source_fn                                 l_source;
+    sink_fn                                   l_sink;
+
+    std::unique_ptr<frame_pool>               pool;
+    std::unique_ptr<blocking_queue<frame_t*>> queues[NUM_STAGES-1];
+    const char                               *queue_types[NUM_STAGES-1];
+    std::vector<latency_timer>                busy_timers[NUM_STAGES];
+    std::atomic<int>                          placement_failures;
+    std::atomic<uint64_t>                     frame_cnt[NUM_STAGES];
+    std::atomic<int>                          active[NUM_STAGES];
+    std::atomic<uint64_t>                     dropped[NUM_DROP_REASONS];
+    std::unique_ptr<reorder_buffer>           reorder;
+    std::atomic<uint64_t>                     batches;
+    std::atomic<uint64_t>                     partial_batches;
+
+    /* Deadline statistics per priority class */
+    std::atomic<uint64_t>                     class_delivered[NUM_PRIORITIES];
+    std::atomic<uint64_t>                     class_deadlines[NUM_PRIORITIES];
+    std::atomic<uint64_t>                     class_hits[NUM_PRIORITIES];
+    std::atomic<uint64_t>                     class_shed[NUM_PRIORITIES];
+    latency_timer                             run_timer;
+
+    /* End-to-end latency (decode to sink) statistics */
+    std::mutex                                report_mtx;
+    uint64_t                                  run_start_ns;
+    uint64_t                                  report_start_ns;
+    uint64_t                                  report_frames;
+    uint64_t                                  report_latency_sum;
+    uint64_t                                  report_latency_max;
+    uint64_t                                  latency_sum;
+    uint64_t                                  latency_max;
+
+    typedef struct
+    {
+      uint64_t frames;
+      uint64_t sum;
+      uint64_t max;
+    } stream_latency_t;
+
+    std::vector<stream_latency_t>             stream_latency;
+
+    /* Accounts a finished frame & periodically reports throughput and latency */
+    void record_latency( frame_t &frame )
+    {
+      uint64_t now = frame_clock_ns();
+      uint64_t latency = now - frame.t_start;
+
+      std::lock_guard<std::mutex> lock(report_mtx);
+
+      latency_sum += latency;
+      latency_max = std::max(latency_max, latency);
+      if (!stream_latency.empty())
+      {
+        stream_latency_t &lat = stream_latency[frame.stream];
+        lat.frames++;
+        lat.sum += latency;
+        lat.max = std::max(lat.max, latency);
+      }
+      report_frames++;
+      report_latency_sum += latency;
+      report_latency_max = std::max(report_latency_max, latency);
+
+      if (config.report_interval > 0.0f && (now - report_start_ns) >= (uint64_t)(config.report_interval * 1e9f))
+      {
+        char line[128];
+        float secs = (float)(now - report_start_ns) * 1e-9f;
+        sprintf(line, "[%8.1fs] %6.1f FPS, latency avg %6.1f ms, max %6.1f ms, %llu frames, %llu dropped",
+                (float)(now - run_start_ns) * 1e-9f, (float)report_frames / secs,
+                (float)report_latency_sum * 1e-6f / (float)report_frames, (float)report_latency_max * 1e-6f,
+                (unsigned long long)frame_cnt[STAGE_SINK] + 1, (unsigned long long)get_dropped_count());
+        std::cout << line << std::endl;
+
+        report_start_ns = now;
+        report_frames = 0;
+        report_latency_sum = 0;
+        report_latency_max = 0;
+      }
+    }
+
+    /* Closes the output queue of a stage once its last worker finishes */
+    void worker_done( int stage )
+    {
+      if (--active[stage] == 0)
+      {
+        if (stage < STAGE_SINK)
+        {
+          queues[stage]->close();
+        }
+        else if (reorder)
+        {
+          /* End of all streams, nothing is missing anymore */
+          reorder->flush();
+        }
+      }
+    }
+
+    /* Hands a finished frame to the sink & recycles it */
+    void deliver( frame_t *frame )
+    {
+      l_sink(*frame);
+      record_latency(*frame);
+
+      if (config.priority_scheduling)
+      {
+        class_delivered[frame->priority]++;
+        if (frame->deadline_ns > 0)
+        {
+          class_deadlines[frame->priority]++;
+          if (frame_clock_ns() <= frame->deadline_ns) class_hits[frame->priority]++;
+        }
+      }
+
+      frame_cnt[STAGE_SINK]++;
+      pool->release(frame);
+    }
+
+    /* Sheds a frame whose deadline has already passed, returns true if it was shed */
+    bool shed( frame_t *frame )
+    {
+      if (!config.priority_scheduling || frame->deadline_ns == 0 || frame_clock_ns() <= frame->deadline_ns)
+      {
+        return false;
+      }
+
+      class_shed[frame->priority]++;
+      drop(frame, DROP_DEADLINE);
+      pool->release(frame);
+      return true;
+    }
+
+    /* Accounts a frame dropped before the sink, so the reorder buffer doesn't wait for it */
+    void drop( frame_t *frame, int reason )
+    {
+      dropped[reason]++;
+      if (reorder) reorder->skip(frame->stream, frame->seq);
+      release_raw(frame);
+    }
+
+    /* Hands a zero-copy input buffer back to its source, returns false if it was overwritten in the meantime */
+    bool release_raw( frame_t *frame )
+    {
+      if (frame->raw_format == RAW_NONE) return true;
+
+      bool intact = frame->raw_source->release_raw(*frame);
+      frame->raw_format = RAW_NONE;
+      frame->raw.release();
+      return intact;
+    }
+
+    /* Scales a zero-copy input into frame.resized at the input size, false if the producer overwrote it
+     * meanwhile.  The full resolution BGR image is only converted when the render stage draws on it,
+     * otherwise the frame keeps just src_size.
+     */
+    bool ingest_raw( frame_t *frame )
+    {
+      if (frame->raw_format == RAW_NONE) return true;
+
+      resize_raw_frame(frame->raw, frame->raw_format, models[0].get_input_dims(), frame->resized);
+      if (config.render)
+      {
+        convert_raw_frame(frame->raw, frame->raw_format, frame->image);
+      }
+      else
+      {
+        frame->image.release();
+      }
+      return release_raw(frame);
+    }
+
+    /* Gets a frame for the source.  With a dropping admission policy the source is never stalled by a
+     * full pipeline: a waiting frame is evicted, or the new frame is read into a scratch frame & dropped.
+     */
+    frame_t *acquire_input( frame_t &scratch )
+    {
+      if (config.admission == ADMIT_BLOCK)
+      {
+        return pool->acquire();
+      }
+
+      frame_t *frame = pool->try_acquire();
+      if (frame != nullptr)
+      {
+        return frame;
+      }
+
+      if (config.admission == ADMIT_DROP_NEWEST)
+      {
+        return &scratch;
+      }
+
+      /* Reuse the oldest frame waiting for preprocessing */
+      if (queues[STAGE_DECODE]->try_pop(frame))
+      {
+        drop(frame, DROP_EVICTED);
+        return frame;
+      }
+
+      /* Every frame is past the input queue, nothing can be dropped */
+      return pool->acquire();
+    }
+
+    /* Passes a new frame to the preprocess stage according to the admission policy */
+    bool admit( frame_t *frame, frame_t &scratch )
+    {
+      if (frame == &scratch)
+      {
+        drop(frame, DROP_INPUT_FULL);
+        return true;
+      }
+
+      switch (config.admission)
+      {
+        case ADMIT_DROP_NEWEST:
+          if (!queues[STAGE_DECODE]->try_push(frame))
+          {
+            drop(frame, DROP_INPUT_FULL);
+            pool->release(frame);
+          }
+          return true;
+
+        case ADMIT_DROP_OLDEST:
+        case ADMIT_KEEP_LATEST:
+          while (!queues[STAGE_DECODE]->try_push(frame))
+          {
+            frame_t *oldest;
+            if (queues[STAGE_DECODE]->try_pop(oldest))
+            {
+              drop(oldest, DROP_EVICTED);
+              pool->release(oldest);
+            }
+          }
+          return true;
+
+        default:
+          return queues[STAGE_DECODE]->push(frame);
+      }
+    }
+
+    /* Applies the CPU affinity & scheduling policy of a stage to the calling worker */
+    void place_thread( int stage )
+    {
+      bool placed = true;
+
+      if (config.cpu_mask[stage] != 0)
+      {
+        placed = pin_current_thread(config.cpu_mask[stage]);
+      }
+      if (stage == STAGE_INFER && config.infer_fifo_priority > 0)
+      {
+        placed = set_current_thread_fifo(config.infer_fifo_priority) && placed;
+      }
+
+      if (!placed) placement_failures++;
+    }
+
+    void decode_worker( int worker )
+    {
+      latency_timer &timer = busy_timers[STAGE_DECODE][worker];
+      frame_t scratch = frame_t();
+
+      place_thread(STAGE_DECODE);
+      trace_set_thread_name("decode/" + std::to_string(worker));
+
+      while (true)
+      {
+        frame_t *frame = acquire_input(scratch);
+        if (frame == nullptr)
+        {
+          break;
+        }
+
+        bool valid;
+        timer.start();
+        {
+          trace_scope trace(TRACE_DECODE);
+          valid = l_source(*frame);
+          trace.set_frame(valid ? (int64_t)frame->seq : -1);
+        }
+        timer.stop();
+
+        if (!valid)
+        {
+          if (frame != &scratch) pool->release(frame);
+          break;
+        }
+
+        frame->t_start = frame_clock_ns();
+        frame_cnt[STAGE_DECODE]++;
+
+        if (!admit(frame, scratch))
+        {
+          pool->release(frame);
+          break;
+        }
+      }
+
+      worker_done(STAGE_DECODE);
+    }
+
+    void infer_worker( int worker )
+    {
+      latency_timer &timer = busy_timers[STAGE_INFER][worker];
+      yolact &model = models[worker];
+      int batch_size = model.get_batch_size();
+      std::vector<frame_t*> batch;
+      frame_t *frame;
+
+      auto timeout = std::chrono::microseconds((int64_t)(config.batch_timeout_ms * 1000.0f));
+
+      place_thread(STAGE_INFER);
+      trace_set_thread_name("infer/" + std::to_string(worker));
+
+      while (queues[STAGE_PREPROCESS]->pop(frame))
+      {
+        if (shed(frame)) continue;
+
+        /* Collect a batch, without a time-out a partial batch is only executed at the end of the stream */
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        batch.clear();
+        batch.push_back(frame);
+        while (batch.size() < batch_size)
+        {
+          bool valid = (config.batch_timeout_ms > 0.0f) ? queues[STAGE_PREPROCESS]->pop_until(frame, deadline)
+                                                        : queues[STAGE_PREPROCESS]->pop(frame);
+          if (!valid) break;
+          if (shed(frame)) continue;
+          batch.push_back(frame);
+        }
+
+        timer.start();
+        model.execute(batch);
+        timer.stop();
+
+        frame_cnt[STAGE_INFER] += batch.size();
+        batches++;
+        if (batch.size() < batch_size) partial_batches++;
+
+        for (auto f : batch)
+        {
+          queues[STAGE_INFER]->push(f);
+        }
+      }
+
+      worker_done(STAGE_INFER);
+    }
+
+    /* Worker for the single-frame CPU stages (preprocess, postprocess, render & sink) */
+    void stage_worker( int stage, int worker )
+    {
+      latency_timer &timer = busy_timers[stage][worker];
+      frame_t *frame;
+
+      uint64_t max_lag_ns = (uint64_t)(config.max_lag_ms * 1e6f);
+
+      place_thread(stage);
+      trace_set_thread_name(std::string(stage_names[stage]) + "/" + std::to_string(worker));
+
+      while (queues[stage-1]->pop(frame))
+      {
+        /* Skip frames that are already too old to be worth processing */
+        if (stage == STAGE_PREPROCESS && max_lag_ns > 0 && frame_clock_ns() - frame->t_start > max_lag_ns)
+        {
+          drop(frame, DROP_LAG);
+          pool->release(frame);
+          continue;
+        }
+
+        bool intact = true;
+        timer.start();
+        switch (stage)
+        {
+          case STAGE_PREPROCESS:
+            if (frame->raw_format == RAW_NONE)
+            {
+              models[0].preprocess(*frame);
+            }
+            else
+            {
+              intact = ingest_raw(frame);
+              if (intact) models[0].preprocess(*frame, true);
+            }
+            break;
+
+          case STAGE_POSTPROCESS:
+            models[0].postprocess(*frame);
+            break;
+
+          case STAGE_RENDER:
+            if (config.render)
+            {
+              models[0].create_overlays(*frame, config.score_thresh, config.label_masks, config.source_size_output);
+            }
+            break;
+
+          case STAGE_SINK:
+          {
+            trace_scope trace(TRACE_SINK, frame->seq);
+            if (reorder)
+            {
+              reorder->push(frame);
+            }
+            else
+            {
+              deliver(frame);
+            }
+            break;
+          }
+        }
+        timer.stop();
+
+        if (!intact)
+        {
+          drop(frame, DROP_OVERWRITTEN);
+          pool->release(frame);
+          continue;
+        }
+
+        if (stage != STAGE_SINK)
+        {
+          frame_cnt[stage]++;
+          queues[stage]->push(frame);
+        }
+      }
+
+      worker_done(stage);
+    }
+};
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _RAW_WRITER_HPP_
+#define _RAW_WRITER_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+// Header files for OpenCV
+#include <opencv2/core.hpp>
+
+#include "frame.hpp"
+
+/*
+ * Rawvideo output to a file descriptor (stdout), e.g. for "ffmpeg -f rawvideo -i -"
+ *
+ * The sink copies every result, the annotated BGR image or the instance-ID
+ * map (8-bit label mask, pixel = 1-based detection index, 0 = background),
+ * into a recycled buffer and a writer thread writes the buffers strictly in
+ * sequence number order, so results that leave the pipeline out of order are
+ * held until their predecessors are written.  submit() only waits while the
+ * writer has `window` frames it can write, so a slow reader back-pressures
+ * the pipeline but a frame that is still being processed never blocks the
+ * frames after it.  Every frame must reach the sink: frames dropped by the
+ * pipeline would leave a gap the output waits for until finish().
+ *
+ * Rawvideo has no frame headers, so all frames must have the size of the
+ * first one and the sequence numbers must come from a single stream.  A frame
+ * of another size breaks the output like a closed reader does.
+ */
+class raw_writer
+{
+  public:
+
+    raw_writer( int fd, bool instance_ids, size_t window ) : fd(fd), instance_ids(instance_ids), window(window),
+                                                             closed(false), next_seq(0), written(0), bytes(0),
+                                                             lost(0), write_ns(0), size_errors(0), broken(false)
+    {
+      /* A reader that goes away shows up as EPIPE instead of killing the process */
+      signal(SIGPIPE, SIG_IGN);
+      fcntl(fd, F_SETPIPE_SZ, 1 << 20);
+
+      start_ns = frame_clock_ns();
+      finish_ns = start_ns;
+      thread = std::thread(&raw_writer::writer_loop, this);
+    }
+
+    ~raw_writer() { finish(); }
+
+    /* Queues the result of a frame for writing, returns false once the output is broken */
+    bool submit( const frame_t &frame )
+    {
+      const cv::Mat &src = instance_ids ? frame.label_mask : frame.image;
+      std::vector<uchar> buf;
+
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        not_full.wait(lock, [this] { return broken || pending.size() < window || !pending.count(next_seq); });
+        if (frame_size.empty())
+        {
+          frame_size = src.size();
+        }
+        else if (src.size() != frame_size && !broken)
+        {
+          size_errors++;
+          broken = true;
+          not_full.notify_all();
+        }
+        if (broken)
+        {
+          lost++;
+          return false;
+        }
+        if (!spare.empty())
+        {
+          buf.swap(spare.back());
+          spare.pop_back();
+        }
+      }
+
+      /* Copies the rows into the packed layout of the output */
+      buf.resize(src.total() * src.elemSize());
+      cv::Mat packed(src.rows, src.cols, src.type(), buf.data());
+      src.copyTo(packed);
+
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending[frame.seq].swap(buf);
+      }
+      ready.notify_one();
+      return true;
+    }
+
+    /* Writes the results still held, in order even if frames are missing, & stops the writer */
+    void finish()
+    {
+      if (!thread.joinable()) return;
+
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+      }
+      ready.notify_one();
+      thread.join();
+
+      finish_ns = frame_clock_ns();
+    }
+
+    /* Frames whose size differed from the first frame, each one breaks the output */
+    uint64_t get_size_errors() { return size_errors; }
+
+    cv::Size get_frame_size() { return frame_size; }
+
+    void print_stats()
+    {
+      char line[160];
+      uint64_t n = written;
+      float secs = (float)(finish_ns - start_ns) * 1e-9f;
+
+      sprintf(line, "Raw output: %llu %s written (%.1f MB), %llu lost to a closed output",
+              (unsigned long long)n, instance_ids ? "instance-ID maps" : "frames", (float)bytes / (1024.0f * 1024.0f),
+              (unsigned long long)lost);
+      std::cout << line << std::endl;
+
+      if (n == 0 || secs <= 0.0f) return;
+
+      sprintf(line, "Average write time = %1.4f seconds, output throughput = %.1f frames/sec (%.1f MB/sec)",
+              (float)write_ns / (float)n * 1e-9f, (float)n / secs, (float)bytes / secs / (1024.0f * 1024.0f));
+      std::cout << line << std::endl;
+    }
+
+  private:
+
+    int                                    fd;
+    bool                                   instance_ids;
+    size_t                                 window;
+
+    std::mutex                             mtx;
+    std::condition_variable                ready;
+    std::condition_variable                not_full;
+    std::map<uint64_t, std::vector<uchar>> pending;   // Results by sequence number
+    std::vector<std::vector<uchar>>        spare;     // Recycled buffers
+    bool                                   closed;
+    uint64_t                               next_seq;
+    std::thread                            thread;
+
+    uint64_t                               written;
+    uint64_t                               bytes;
+    uint64_t                               lost;
+    uint64_t                               write_ns;
+    uint64_t                               size_errors;
+    cv::Size                               frame_size;    // Size of every frame, set by the first one
+    bool                                   broken;
+    uint64_t                               start_ns;
+    uint64_t                               finish_ns;
+
+    void writer_loop()
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+
+      while (true)
+      {
+        ready.wait(lock, [this] { return closed || pending.count(next_seq); });
+
+        auto it = pending.find(next_seq);
+        if (it == pending.end())
+        {
+          /* Closed: whatever is left is written in order, skipping the missing frames */
+          if (pending.empty()) break;
+          it = pending.begin();
+        }
+
+        std::vector<uchar> buf;
+        buf.swap(it->second);
+        next_seq = it->first + 1;
+        pending.erase(it);
+
+        lock.unlock();
+        not_full.notify_all();
+
+        uint64_t t_start = frame_clock_ns();
+        bool ok = !broken && write_fully(buf.data(), buf.size());
+        uint64_t t_written = frame_clock_ns();
+
+        lock.lock();
+        if (ok)
+        {
+          written++;
+          bytes += buf.size();
+          write_ns += t_written - t_start;
+        }
+        else
+        {
+          if (!broken) not_full.notify_all();
+          broken = true;
+          lost++;
+        }
+        spare.push_back(std::move(buf));
+      }
+    }
+
+    bool write_fully( const uchar *data, size_t size )
+    {
+      size_t done = 0;
+      while (done < size)
+      {
+        ssize_t n = ::write(fd, data + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += n;
+      }
+      return true;
+    }
+};
+
+#endif
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _REORDER_BUFFER_HPP_
+#define _REORDER_BUFFER_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "frame.hpp"
+#include "trace.hpp"
+
+/*
+ * Per-stream reorder buffer
+ *
+ * Frames of several streams finish out of order when they are processed by
+ * more than one worker or model context.  Each stream delivers its frames in
+ * sequence order: a frame that arrives early is held until its predecessors
+ * have been delivered.  The wait is bounded: once the oldest held frame of a
+ * stream has waited max_wait_ms, or more than max_frames frames are held in
+ * total, the missing frames are given up on and the stream continues with the
+ * held frames.  A given-up frame that still arrives is discarded as late.
+ * Frames that are known to be dropped can be skipped so nobody waits for them.
+ *
+ * Frames are delivered by a release thread of the buffer, which also wakes up
+ * when the oldest held frame's wait expires, so the bound holds even when no
+ * stream produces another frame.  push() & skip() never deliver themselves
+ * and deliver is never called with the buffer locked.
+ */
+class reorder_buffer
+{
+  public:
+
+    typedef std::function<void(frame_t *)> frame_fn;
+
+    typedef struct
+    {
+      uint64_t delivered;    // Frames delivered in order
+      uint64_t late;         // Frames discarded because a later frame was already delivered
+      uint64_t gaps;         // Sequence numbers given up on after the bounded wait
+      size_t   max_held;     // Maximum number of frames held at once
+    } stream_stats_t;
+
+    reorder_buffer( int       num_streams,
+                    size_t    max_frames,
+                    float     max_wait_ms,
+                    frame_fn  deliver,
+                    frame_fn  discard ) : streams(num_streams), max_frames(max_frames), deliver(deliver),
+                                          discard(discard), held_frames(0), closed(false)
+    {
+      max_wait_ns = (uint64_t)(max_wait_ms * 1e6f);
+      thread = std::thread(&reorder_buffer::release_loop, this);
+    }
+
+    ~reorder_buffer() { flush(); }
+
+    /* Adds a finished frame, it is delivered once it is next in its stream */
+    void push( frame_t *frame )
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stream_t &s = streams[frame->stream];
+
+      if (frame->seq < s.next_seq)
+      {
+        s.stats.late++;
+        discard(frame);
+        return;
+      }
+
+      s.held[frame->seq] = held_t{frame, frame_clock_ns()};
+      held_frames++;
+      s.stats.max_held = std::max(s.stats.max_held, s.held.size());
+      cv.notify_one();
+    }
+
+    /* Marks a frame that will never arrive (e.g. dropped by the admission policy) */
+    void skip( int stream, uint64_t seq )
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stream_t &s = streams[stream];
+
+      if (seq < s.next_seq) return;
+
+      s.skipped.insert(seq);
+      cv.notify_one();
+    }
+
+    /* Delivers all held frames at the end of the stream & stops the release thread */
+    void flush()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+        cv.notify_one();
+      }
+
+      if (thread.joinable()) thread.join();
+    }
+
+    int get_num_streams() { return streams.size(); }
+
+    stream_stats_t get_stats( int stream )
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      return streams[stream].stats;
+    }
+
+  private:
+
+    typedef struct
+    {
+      frame_t  *frame;
+      uint64_t  arrival_ns;
+    } held_t;
+
+    typedef struct
+    {
+      uint64_t                     next_seq = 0;
+      std::map<uint64_t, held_t>   held;
+      std::set<uint64_t>           skipped;
+      stream_stats_t               stats = {0, 0, 0, 0};
+    } stream_t;
+
+    std::mutex               mtx;
+    std::condition_variable  cv;
+    std::thread              thread;
+    std::vector<stream_t>    streams;
+    size_t                   max_frames;
+    uint64_t                 max_wait_ns;
+    frame_fn                 deliver;
+    frame_fn                 discard;
+    size_t                   held_frames;
+    bool                     closed;
+    std::vector<frame_t*>    ready;        // Frames released in order, delivered outside the lock
+
+    /* Releases the frames that are due & delivers them, until flush() */
+    void release_loop()
+    {
+      trace_set_thread_name("reorder");
+      std::unique_lock<std::mutex> lock(mtx);
+
+      while (true)
+      {
+        for (auto &s : streams)
+        {
+          drain(s);
+        }
+        expire();
+
+        if (closed)
+        {
+          /* End of all streams, nothing is missing anymore */
+          for (auto &s : streams)
+          {
+            while (!s.held.empty())
+            {
+              give_up(s);
+            }
+          }
+        }
+
+        if (!ready.empty())
+        {
+          std::vector<frame_t*> batch;
+          batch.swap(ready);
+
+          lock.unlock();
+          for (auto frame : batch)
+          {
+            deliver(frame);
+          }
+          lock.lock();
+          continue;
+        }
+
+        if (closed) break;
+
+        /* Sleep until a frame arrives or the oldest held frame's wait expires */
+        uint64_t deadline = next_expiry();
+        if (deadline == UINT64_MAX)
+        {
+          cv.wait(lock);
+        }
+        else
+        {
+          uint64_t now = frame_clock_ns();
+          if (deadline > now) cv.wait_for(lock, std::chrono::nanoseconds(deadline - now));
+        }
+      }
+    }
+
+    /* Releases the held frames that are next in sequence */
+    void drain( stream_t &s )
+    {
+      while (true)
+      {
+        if (!s.skipped.empty() && *s.skipped.begin() == s.next_seq)
+        {
+          s.skipped.erase(s.skipped.begin());
+          s.next_seq++;
+        }
+        else if (!s.held.empty() && s.held.begin()->first == s.next_seq)
+        {
+          ready.push_back(s.held.begin()->second.frame);
+          s.held.erase(s.held.begin());
+          held_frames--;
+          s.next_seq++;
+          s.stats.delivered++;
+        }
+        else
+        {
+          break;
+        }
+      }
+    }
+
+    /* Stops waiting for the frames missing before the oldest held frame */
+    void give_up( stream_t &s )
+    {
+      uint64_t first = s.held.begin()->first;
+
+      s.stats.gaps += first - s.next_seq;
+      while (!s.skipped.empty() && *s.skipped.begin() < first)
+      {
+        s.stats.gaps--;
+        s.skipped.erase(s.skipped.begin());
+      }
+
+      s.next_seq = first;
+      drain(s);
+    }
+
+    /* Arrival time of the frame that has been held the longest */
+    static uint64_t oldest_arrival( stream_t &s )
+    {
+      uint64_t oldest = UINT64_MAX;
+      for (auto &entry : s.held)
+      {
+        oldest = std::min(oldest, entry.second.arrival_ns);
+      }
+      return oldest;
+    }
+
+    /* Time at which the wait of the oldest held frame expires (UINT64_MAX if nothing is held) */
+    uint64_t next_expiry()
+    {
+      uint64_t deadline = UINT64_MAX;
+      for (auto &s : streams)
+      {
+        if (!s.held.empty()) deadline = std::min(deadline, oldest_arrival(s) + max_wait_ns + 1);
+      }
+      return deadline;
+    }
+
+    /* Enforces the bounded wait & the held frame limit */
+    void expire()
+    {
+      uint64_t now = frame_clock_ns();
+
+      for (auto &s : streams)
+      {
+        while (!s.held.empty() && now - oldest_arrival(s) > max_wait_ns)
+        {
+          give_up(s);
+        }
+      }
+
+      /* Over the limit, release the stream that has been waiting the longest */
+      while (held_frames > max_frames)
+      {
+        stream_t *victim = nullptr;
+        uint64_t victim_arrival = UINT64_MAX;
+        for (auto &s : streams)
+        {
+          if (!s.held.empty() && oldest_arrival(s) < victim_arrival)
+          {
+            victim = &s;
+            victim_arrival = oldest_arrival(s);
+          }
+        }
+        give_up(*victim);
+      }
+    }
+};
+
+#endif
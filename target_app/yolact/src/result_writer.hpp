@@ -0,0 +1,282 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RESULT_WRITER_HPP_
+#define _RESULT_WRITER_HPP_
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Header files for OpenCV
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "frame.hpp"
+#include "bounded_queue.hpp"
+
+/* What submit() does when all write buffers are in use */
+typedef enum
+{
+  WRITE_BLOCK,    // Wait for a buffer, the pipeline slows down to the encode rate
+  WRITE_DROP      // Drop the result, the pipeline keeps its rate
+} write_policy_t;
+
+/*
+ * Asynchronous result sink
+ *
+ * Annotated images (and optionally their label masks) are copied into one of
+ * a fixed set of recycled write buffers and encoded & written to the output
+ * directory by a pool of worker threads, so image encoding and file I/O never
+ * stall the pipeline's sink stage.  The number of write buffers bounds the
+ * memory used by queued results.
+ */
+class result_writer
+{
+  public:
+
+    result_writer( const std::string &dir,
+                   const std::string &format,
+                   int                num_workers,
+                   int                queue_depth,
+                   write_policy_t     policy,
+                   bool               seq_names ) : dir(dir), ext("." + format), policy(policy), seq_names(seq_names),
+                                                    num_workers(num_workers),
+                                                    jobs(queue_depth + num_workers),
+                                                    free_jobs(queue_depth + num_workers), pending(queue_depth + num_workers)
+    {
+      dropped = 0;
+      results = 0;
+      written = 0;
+      errors = 0;
+      bytes = 0;
+      encode_ns = 0;
+      write_ns = 0;
+
+      for (auto &job : jobs)
+      {
+        free_jobs.push(&job);
+      }
+
+      start_ns = frame_clock_ns();
+      finish_ns = start_ns;
+      for (int w = 0; w < num_workers; w++)
+      {
+        threads.emplace_back(&result_writer::worker_loop, this);
+      }
+    }
+
+    ~result_writer() { finish(); }
+
+    /* Prefixes sequence numbered outputs with the stream index */
+    void set_stream_names( bool enable ) { stream_names = enable; }
+
+    /* Creates the output directory if it doesn't exist */
+    static bool create_dir( const std::string &dir )
+    {
+      std::error_code ec;
+      std::filesystem::create_directories(dir, ec);
+      return std::filesystem::is_directory(dir, ec);
+    }
+
+    /* Queues the results of a frame, returns false if they were dropped */
+    bool submit( const frame_t &frame )
+    {
+      write_job_t *job = nullptr;
+
+      if (policy == WRITE_DROP)
+      {
+        if (!free_jobs.try_pop(job))
+        {
+          dropped++;
+          return false;
+        }
+      }
+      else if (!free_jobs.pop(job))
+      {
+        return false;
+      }
+
+      job->name = output_name(frame);
+      frame.image.copyTo(job->image);
+      if (!frame.label_mask.empty())
+      {
+        frame.label_mask.copyTo(job->mask);
+      }
+      else
+      {
+        job->mask.release();
+      }
+
+      pending.push(job);
+      return true;
+    }
+
+    /* Waits until all queued results have been written & stops the workers */
+    void finish()
+    {
+      if (threads.empty()) return;
+
+      pending.close();
+      for (auto &thread : threads)
+      {
+        thread.join();
+      }
+      threads.clear();
+
+      finish_ns = frame_clock_ns();
+    }
+
+    void print_stats()
+    {
+      char line[160];
+      uint64_t n = written;
+      float secs = (float)(finish_ns - start_ns) * 1e-9f;
+
+      std::cout << "Output: " << results << " results (" << n << " files) written to " << dir << ", " << dropped
+                << " results dropped, " << errors << " errors" << std::endl;
+
+      if (n == 0) return;
+
+      sprintf(line, "Average encode time = %1.4f seconds, write time = %1.4f seconds, size = %1.1f KB per file",
+              (float)encode_ns / (float)n * 1e-9f, (float)write_ns / (float)n * 1e-9f,
+              (float)bytes / (float)n / 1024.0f);
+      std::cout << line << std::endl;
+      sprintf(line, "Output throughput = %.1f files/sec using %d writer threads (%.1f MB/sec)",
+              (float)n / secs, num_workers,
+              (float)bytes / secs / (1024.0f * 1024.0f));
+      std::cout << line << std::endl;
+    }
+
+  private:
+
+    typedef struct
+    {
+      std::string        name;     // Output file name without extension
+      cv::Mat            image;    // Annotated image
+      cv::Mat            mask;     // Label mask (empty if not requested)
+      std::vector<uchar> buf;      // Encoded file data
+    } write_job_t;
+
+    std::string               dir;
+    std::string               ext;
+    write_policy_t            policy;
+    bool                      seq_names;
+    bool                      stream_names = false;
+    int                       num_workers;
+
+    std::vector<write_job_t>    jobs;
+    bounded_queue<write_job_t*> free_jobs;
+    bounded_queue<write_job_t*> pending;
+    std::vector<std::thread>    threads;
+
+    std::mutex                      names_mtx;
+    std::unordered_set<std::string> names;   // Output names in use
+
+    std::atomic<uint64_t>     dropped;
+    std::atomic<uint64_t>     results;       // Frames whose outputs were all written
+    std::atomic<uint64_t>     written;       // Files written (images & masks)
+    std::atomic<uint64_t>     errors;
+    std::atomic<uint64_t>     bytes;
+    std::atomic<uint64_t>     encode_ns;
+    std::atomic<uint64_t>     write_ns;
+    uint64_t                  start_ns;
+    uint64_t                  finish_ns;
+
+    /* Names outputs after the input file, or after the sequence number for streams & repeated inputs.
+     * Inputs from different directories may share a file name, later ones get the sequence number appended.
+     */
+    std::string output_name( const frame_t &frame )
+    {
+      if (seq_names || frame.name.empty())
+      {
+        char name[32];
+        if (stream_names)
+        {
+          sprintf(name, "s%02d_%06llu", frame.stream, (unsigned long long)frame.seq);
+        }
+        else
+        {
+          sprintf(name, "%06llu", (unsigned long long)frame.seq);
+        }
+        return name;
+      }
+
+      std::string name = std::filesystem::path(frame.name).stem().string();
+
+      std::lock_guard<std::mutex> lock(names_mtx);
+      if (!names.insert(name).second)
+      {
+        char suffix[32];
+        sprintf(suffix, "_%06llu", (unsigned long long)frame.seq);
+        name += suffix;
+        names.insert(name);
+      }
+      return name;
+    }
+
+    void worker_loop()
+    {
+      write_job_t *job;
+
+      while (pending.pop(job))
+      {
+        bool ok = write_file(*job, job->image, ext, ext);
+        if (!job->mask.empty())
+        {
+          ok = write_file(*job, job->mask, ".png", "_mask.png") && ok;
+        }
+        if (ok) results++;
+
+        free_jobs.push(job);
+      }
+    }
+
+    bool write_file( write_job_t &job, const cv::Mat &image, const std::string &format, const std::string &suffix )
+    {
+      uint64_t t_start = frame_clock_ns();
+      if (!cv::imencode(format, image, job.buf))
+      {
+        errors++;
+        return false;
+      }
+      uint64_t t_encoded = frame_clock_ns();
+
+      std::ofstream out(dir + "/" + job.name + suffix, std::ios::binary);
+      out.write((const char *)job.buf.data(), job.buf.size());
+      if (!out)
+      {
+        errors++;
+        return false;
+      }
+      uint64_t t_written = frame_clock_ns();
+
+      written++;
+      bytes += job.buf.size();
+      encode_ns += t_encoded - t_start;
+      write_ns += t_written - t_encoded;
+      return true;
+    }
+};
+
+#endif
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _SCHEDULER_HPP_
+#define _SCHEDULER_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame.hpp"
+#include "latency_timer.hpp"
+#include "trace.hpp"
+
+/*
+ * Work-stealing batch scheduler
+ *
+ * Batches are identified by their sequence number (batch N holds the frames
+ * N*batch_size ... N*batch_size+batch_size-1), so results can be written
+ * back in input order no matter which worker processed them.  The batches
+ * are dealt round-robin into one deque per worker; a worker takes batches
+ * from the front of its own deque and, once it runs dry, steals from the
+ * back of the peer with the most remaining work.  A worker that hits a slow
+ * batch (e.g. a frame with many detections) therefore no longer holds up
+ * the total run time.
+ */
+class batch_scheduler
+{
+  public:
+
+    typedef std::function<void(int, int)> batch_fn;   // (worker, batch)
+
+    batch_scheduler( int num_workers, int num_batches ) : num_workers(num_workers)
+    {
+      workers.resize(num_workers);
+      for (int w = 0; w < num_workers; w++)
+      {
+        workers[w].reset(new worker_t());
+      }
+
+      for (int b = 0; b < num_batches; b++)
+      {
+        workers[b % num_workers]->batches.push_back(b);
+      }
+    }
+
+    /* Runs fn for every batch on num_workers threads & waits for completion */
+    void run( batch_fn fn )
+    {
+      std::vector<std::thread> threads;
+
+      run_start = frame_clock_ns();
+
+      for (int w = 0; w < num_workers; w++)
+      {
+        threads.emplace_back(&batch_scheduler::worker_loop, this, w, fn);
+      }
+
+      for (auto &thread : threads)
+      {
+        thread.join();
+      }
+    }
+
+    /* Prints the per-thread busy-time report */
+    void print_stats()
+    {
+      char line[128];
+      float busy_sum = 0.0f;
+      float busy_max = 0.0f;
+      uint64_t finish_min = UINT64_MAX;
+      uint64_t finish_max = 0;
+
+      sprintf(line, "  %-8s %8s %8s %12s %12s", "Thread", "Batches", "Stolen", "Busy (sec)", "Done (sec)");
+      std::cout << line << std::endl;
+
+      for (int w = 0; w < num_workers; w++)
+      {
+        worker_t &worker = *workers[w];
+        float busy_secs = worker.busy_timer.secs();
+
+        sprintf(line, "  %-8d %8d %8d %12.3f %12.3f", w, worker.processed, worker.stolen,
+                busy_secs, (float)(worker.finish_ns - run_start) * 1e-9f);
+        std::cout << line << std::endl;
+
+        busy_sum += busy_secs;
+        busy_max = std::max(busy_max, busy_secs);
+        finish_min = std::min(finish_min, worker.finish_ns);
+        finish_max = std::max(finish_max, worker.finish_ns);
+      }
+
+      float busy_avg = busy_sum / (float)num_workers;
+      sprintf(line, "  Tail imbalance: last thread finished %1.3f seconds after the first, max/avg busy = %1.2f",
+              (float)(finish_max - finish_min) * 1e-9f, (busy_avg > 0.0f) ? busy_max / busy_avg : 0.0f);
+      std::cout << line << std::endl;
+
+      print_latency_header("Batch time");
+      for (int w = 0; w < num_workers; w++)
+      {
+        print_latency_row("thread " + std::to_string(w), workers[w]->busy_timer.histogram());
+      }
+    }
+
+  private:
+
+    typedef struct
+    {
+      std::mutex      mtx;
+      std::deque<int> batches;
+      int             processed = 0;
+      int             stolen = 0;
+      latency_timer   busy_timer;
+      uint64_t        finish_ns = 0;
+    } worker_t;
+
+    int                                    num_workers;
+    std::vector<std::unique_ptr<worker_t>> workers;
+    uint64_t                               run_start;
+
+    /* Takes the next batch from the worker's own deque or steals one from a peer */
+    bool next( int worker, int &batch )
+    {
+      {
+        worker_t &self = *workers[worker];
+        std::lock_guard<std::mutex> lock(self.mtx);
+        if (!self.batches.empty())
+        {
+          batch = self.batches.front();
+          self.batches.pop_front();
+          return true;
+        }
+      }
+
+      while (true)
+      {
+        /* Pick the peer with the most queued batches */
+        int victim = -1;
+        size_t victim_size = 0;
+        for (int w = 0; w < num_workers; w++)
+        {
+          if (w == worker) continue;
+
+          std::lock_guard<std::mutex> lock(workers[w]->mtx);
+          if (workers[w]->batches.size() > victim_size)
+          {
+            victim = w;
+            victim_size = workers[w]->batches.size();
+          }
+        }
+
+        if (victim < 0)
+        {
+          return false;
+        }
+
+        std::lock_guard<std::mutex> lock(workers[victim]->mtx);
+        if (!workers[victim]->batches.empty())
+        {
+          batch = workers[victim]->batches.back();
+          workers[victim]->batches.pop_back();
+          workers[worker]->stolen++;
+          return true;
+        }
+      }
+    }
+
+    void worker_loop( int worker, batch_fn fn )
+    {
+      worker_t &self = *workers[worker];
+      int batch;
+
+      self.busy_timer.reset();
+      trace_set_thread_name("worker/" + std::to_string(worker));
+
+      while (next(worker, batch))
+      {
+        self.busy_timer.start();
+        fn(worker, batch);
+        self.busy_timer.stop();
+        self.processed++;
+      }
+
+      self.finish_ns = frame_clock_ns();
+    }
+};
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Reference producer of the shared-memory frame ring (yolact.exe --shm_ring)
+ *
+ * Publishes synthetic BGR or NV12 frames (a box moving over a gray
+ * background) at a fixed rate, the way a capture process would.  Only
+ * depends on the C++ standard library & Linux, build with build.sh or:
+ *   g++ -std=c++17 -O3 -Isrc src/shm_producer.cpp -o shm_producer.exe -lrt
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "shm_ring.hpp"
+
+using namespace std;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void signal_handler( int )
+{
+  stop_requested = 1;
+}
+
+static uint64_t now_ns()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+/* Draws frame n: gray background with an orange box moving left to right */
+static void draw_frame( const shm_ring_info_t &h, uint8_t *data, uint64_t n )
+{
+  uint32_t box = h.height / 4;
+  uint32_t x0 = (uint32_t)((n * 8) % std::max(h.width - box, 1u));
+  uint32_t y0 = h.height / 2 - box / 2;
+
+  if (h.format == SHM_FMT_BGR)
+  {
+    for (uint32_t y = 0; y < h.height; y++)
+    {
+      uint8_t *row = data + (size_t)y * h.stride;
+      memset(row, 96, h.width * 3);
+      if (y < y0 || y >= y0 + box) continue;
+
+      for (uint32_t x = x0; x < x0 + box; x++)
+      {
+        row[x * 3 + 0] = 0;
+        row[x * 3 + 1] = 160;
+        row[x * 3 + 2] = 255;
+      }
+    }
+  }
+  else
+  {
+    /* BT.601 video range: gray Y=97, orange Y=158 U=47 V=186 */
+    uint8_t *uv = data + (size_t)h.stride * h.height;
+    for (uint32_t y = 0; y < h.height; y++)
+    {
+      uint8_t *row = data + (size_t)y * h.stride;
+      memset(row, 97, h.width);
+      if (y >= y0 && y < y0 + box) memset(row + x0, 158, box);
+    }
+    for (uint32_t y = 0; y < h.height / 2; y++)
+    {
+      uint8_t *row = uv + (size_t)y * h.stride;
+      memset(row, 128, h.width);
+      if (y * 2 < y0 || y * 2 >= y0 + box) continue;
+
+      for (uint32_t x = x0 & ~1u; x < x0 + box; x += 2)
+      {
+        row[x + 0] = 47;
+        row[x + 1] = 186;
+      }
+    }
+  }
+}
+
+int main( int argc, char *argv[] )
+{
+  string name = "/yolact_ring";
+  uint32_t width = 1280, height = 720;
+  uint32_t format = SHM_FMT_BGR;
+  uint32_t slots = 4;
+  float fps = 30.0f;
+  uint64_t count = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--name") && i+1 < argc)
+    {
+      name = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--size") && i+1 < argc &&
+             sscanf(argv[i+1], "%ux%u", &width, &height) == 2 && width >= 16 && height >= 16 &&
+             width % 2 == 0 && height % 2 == 0)
+    {
+      i++;
+    }
+    else if (!strcmp(argv[i], "--format") && i+1 < argc &&
+             (!strcmp(argv[i+1], "bgr") || !strcmp(argv[i+1], "nv12")))
+    {
+      format = !strcmp(argv[++i], "nv12") ? SHM_FMT_NV12 : SHM_FMT_BGR;
+    }
+    else if (!strcmp(argv[i], "--slots") && i+1 < argc)
+    {
+      slots = std::max(atoi(argv[++i]), 2);
+    }
+    else if (!strcmp(argv[i], "--fps") && i+1 < argc)
+    {
+      fps = atof(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--count") && i+1 < argc)
+    {
+      count = atoll(argv[++i]);
+    }
+    else
+    {
+      printf("Usage: ./shm_producer.exe [--name /yolact_ring] [--size WxH] [--format bgr|nv12] [--slots N]\n");
+      printf("                          [--fps F] [--count N]\n");
+      printf("       Sizes must be even, --fps 0 publishes as fast as possible, --count 0 runs until Ctrl-C\n");
+      return -1;
+    }
+  }
+
+  unique_ptr<shm_ring> ring(shm_ring::create(name, width, height, format, slots));
+  if (!ring)
+  {
+    printf("ERROR: unable to create shared memory ring %s: %s\n", name.c_str(), strerror(errno));
+    return -1;
+  }
+
+  signal(SIGINT, signal_handler);
+  signal(SIGTERM, signal_handler);
+
+  char rate[32];
+  if (fps > 0.0f) sprintf(rate, "%.1f FPS", fps);
+  else strcpy(rate, "full speed");
+
+  printf("Publishing %ux%u %s frames on %s (%u slots of %llu bytes) at %s\n", width, height,
+         (format == SHM_FMT_NV12) ? "NV12" : "BGR", name.c_str(), slots,
+         (unsigned long long)ring->info().slot_size, rate);
+
+  uint64_t period_ns = (fps > 0.0f) ? (uint64_t)(1e9f / fps) : 0;
+  uint64_t start_ns = now_ns();
+  uint64_t write_ns = 0;
+  uint64_t n = 0;
+
+  for (; !stop_requested && (count == 0 || n < count); n++)
+  {
+    if (period_ns > 0)
+    {
+      uint64_t due = start_ns + n * period_ns;
+      uint64_t now = now_ns();
+      if (now < due) this_thread::sleep_for(chrono::nanoseconds(due - now));
+    }
+
+    uint64_t t0 = now_ns();
+    draw_frame(ring->info(), ring->begin_write(n), n);
+    ring->end_write(n, now_ns());
+    write_ns += now_ns() - t0;
+  }
+
+  ring->close_ring();
+
+  double secs = (now_ns() - start_ns) * 1e-9;
+  printf("Published %llu frames in %.1f seconds (%.1f FPS), average write time %.3f ms\n", (unsigned long long)n,
+         secs, (secs > 0.0) ? n / secs : 0.0, (n > 0) ? write_ns * 1e-6 / n : 0.0);
+  return 0;
+}
@@ -0,0 +1,321 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _SHM_RING_HPP_
+#define _SHM_RING_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Shared-memory frame ring between a capture process and yolact.exe
+ *
+ * A POSIX shared memory object holds a header followed by num_slots fixed
+ * size slots.  The producer writes frame n into slot n % num_slots and never
+ * waits for the consumer: a slow consumer loses the oldest frames instead of
+ * stalling the capture.  Every slot is guarded by a seqlock: its sequence
+ * word is 2n+1 while frame n is being written and 2n+2 once it is complete.
+ * The consumer reads a slot in place (no copy) and validates the sequence
+ * word again when it is done; a changed word means the producer lapped the
+ * consumer and the frame is discarded as torn.
+ *
+ * The consumer sleeps on a futex in the shared header, which the producer
+ * only wakes when somebody is waiting, so publishing a frame costs no system
+ * call while the consumer keeps up.  The producer records its pid, so a
+ * consumer can tell a producer that died without closing the ring from one
+ * that is merely idle.  Only the C++ standard library & Linux are used, so
+ * producers don't need OpenCV.
+ */
+
+#define SHM_RING_MAGIC   0x474e4952u     // "RING"
+#define SHM_RING_VERSION 1
+#define SHM_RING_MAX_DIM 16384           // Largest frame width & height
+
+/* Pixel formats of the frames */
+enum
+{
+  SHM_FMT_BGR = 1,    // Packed BGR8, stride bytes per row
+  SHM_FMT_NV12        // Y plane (stride bytes per row) followed by the interleaved UV plane at half height
+};
+
+typedef struct
+{
+  uint32_t              magic;
+  uint32_t              version;
+  uint32_t              width;
+  uint32_t              height;
+  uint32_t              format;        // SHM_FMT_*
+  uint32_t              stride;        // Bytes per row (of the Y plane for NV12)
+  uint32_t              num_slots;
+  uint32_t              producer_pid;  // Process that created the ring (0 = unknown)
+  uint64_t              slot_size;     // Bytes per slot including its header, multiple of 64
+  uint64_t              frame_bytes;   // Bytes of frame data per slot
+
+  alignas(64)
+  std::atomic<uint64_t> published;     // Number of frames published
+  std::atomic<uint32_t> wake;          // Futex word, changes with every published frame
+  std::atomic<uint32_t> waiters;       // Consumers sleeping on wake
+  std::atomic<uint32_t> closed;        // Set by the producer after its last frame
+} shm_ring_header_t;
+
+typedef struct
+{
+  alignas(64)
+  std::atomic<uint64_t> seq;           // Seqlock: 2n+1 while frame n is written, 2n+2 once complete
+  uint64_t              timestamp_ns;  // Capture time (CLOCK_MONOTONIC)
+} shm_slot_header_t;
+
+/* Ring geometry, copied out of the shared header once it has been validated */
+typedef struct
+{
+  uint32_t              width;
+  uint32_t              height;
+  uint32_t              format;        // SHM_FMT_*
+  uint32_t              stride;        // Bytes per row (of the Y plane for NV12)
+  uint32_t              num_slots;
+  uint64_t              slot_size;     // Bytes per slot including its header
+  uint64_t              frame_bytes;   // Bytes of frame data per slot
+} shm_ring_info_t;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock-free");
+
+class shm_ring
+{
+  public:
+
+    ~shm_ring()
+    {
+      if (header != nullptr) munmap(header, map_size);
+      if (owner) shm_unlink(name.c_str());
+    }
+
+    /* Creates (or replaces) a ring as the producer, returns nullptr on failure */
+    static shm_ring *create( const std::string &name, uint32_t width, uint32_t height, uint32_t format,
+                             uint32_t num_slots )
+    {
+      if (width == 0 || height == 0 || width > SHM_RING_MAX_DIM || height > SHM_RING_MAX_DIM || num_slots == 0 ||
+          (format != SHM_FMT_BGR && format != SHM_FMT_NV12))
+      {
+        return nullptr;
+      }
+
+      uint32_t stride = (format == SHM_FMT_BGR) ? width * 3 : width;
+      uint64_t frame_bytes = (uint64_t)stride * ((format == SHM_FMT_BGR) ? height : height + (height + 1) / 2);
+      uint64_t slot_size = (sizeof(shm_slot_header_t) + frame_bytes + 63) & ~(uint64_t)63;
+      size_t size = sizeof(shm_ring_header_t) + slot_size * num_slots;
+
+      int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0660);
+      if (fd < 0) return nullptr;
+
+      shm_ring *ring = nullptr;
+      if (ftruncate(fd, size) == 0)
+      {
+        ring = map(fd, name, size);
+      }
+      close(fd);
+      if (ring == nullptr) return nullptr;
+
+      shm_ring_header_t *h = ring->header;
+      h->magic = SHM_RING_MAGIC;
+      h->version = SHM_RING_VERSION;
+      h->width = width;
+      h->height = height;
+      h->format = format;
+      h->stride = stride;
+      h->num_slots = num_slots;
+      h->slot_size = slot_size;
+      h->frame_bytes = frame_bytes;
+      h->producer_pid = (uint32_t)getpid();
+      ring->owner = true;
+      ring->geometry = { width, height, format, stride, num_slots, slot_size, frame_bytes };
+      return ring;
+    }
+
+    /* Attaches to an existing ring as the consumer, returns nullptr if it doesn't exist or is invalid */
+    static shm_ring *open( const std::string &name )
+    {
+      int fd = shm_open(name.c_str(), O_RDWR, 0);
+      if (fd < 0) return nullptr;
+
+      struct stat st;
+      shm_ring *ring = nullptr;
+      if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(shm_ring_header_t))
+      {
+        ring = map(fd, name, st.st_size);
+      }
+      close(fd);
+      if (ring == nullptr) return nullptr;
+
+      if (!ring->validate())
+      {
+        delete ring;
+        return nullptr;
+      }
+      return ring;
+    }
+
+    const shm_ring_info_t &info() { return geometry; }
+
+    uint64_t published() { return header->published.load(std::memory_order_acquire); }
+
+    bool is_closed() { return header->closed.load(std::memory_order_acquire) != 0; }
+
+    /* False once the producer process has exited (always true for producers that don't record their pid) */
+    bool producer_alive()
+    {
+      pid_t pid = (pid_t)header->producer_pid;
+      return pid == 0 || kill(pid, 0) == 0 || errno == EPERM;
+    }
+
+    uint8_t *frame_data( uint64_t n ) { return (uint8_t *)(slot(n) + 1); }
+
+    /* Producer: starts writing frame n (= the number of published frames), returns its buffer */
+    uint8_t *begin_write( uint64_t n )
+    {
+      slot(n)->seq.store(2 * n + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      return frame_data(n);
+    }
+
+    /* Producer: publishes frame n & wakes a sleeping consumer */
+    void end_write( uint64_t n, uint64_t timestamp_ns )
+    {
+      slot(n)->timestamp_ns = timestamp_ns;
+      slot(n)->seq.store(2 * n + 2, std::memory_order_release);
+      header->published.store(n + 1, std::memory_order_release);
+      wake_consumers();
+    }
+
+    /* Producer: marks the end of the stream */
+    void close_ring()
+    {
+      header->closed.store(1, std::memory_order_release);
+      wake_consumers();
+    }
+
+    /* Consumer: waits until more than n frames are published or the ring is closed, false on time-out */
+    bool wait_for( uint64_t n, int timeout_ms )
+    {
+      timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+
+      while (published() <= n && !is_closed())
+      {
+        uint32_t word = header->wake.load();
+        if (published() > n || is_closed()) break;
+
+        header->waiters++;
+        long rc = syscall(SYS_futex, (uint32_t *)&header->wake, FUTEX_WAIT, word, &timeout, nullptr, 0);
+        header->waiters--;
+
+        if (rc != 0 && errno == ETIMEDOUT) return published() > n || is_closed();
+      }
+      return true;
+    }
+
+    /* Consumer: true if slot n holds the complete frame n */
+    bool begin_read( uint64_t n )
+    {
+      return slot(n)->seq.load(std::memory_order_acquire) == 2 * n + 2;
+    }
+
+    /* Consumer: true if frame n wasn't overwritten while it was read */
+    bool end_read( uint64_t n )
+    {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return slot(n)->seq.load(std::memory_order_relaxed) == 2 * n + 2;
+    }
+
+    uint64_t timestamp( uint64_t n ) { return slot(n)->timestamp_ns; }
+
+  private:
+
+    std::string         name;
+    shm_ring_header_t  *header = nullptr;
+    shm_ring_info_t     geometry = {};
+    size_t              map_size = 0;
+    bool                owner = false;
+
+    static shm_ring *map( int fd, const std::string &name, size_t size )
+    {
+      void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED) return nullptr;
+
+      shm_ring *ring = new shm_ring();
+      ring->name = name;
+      ring->header = (shm_ring_header_t *)data;
+      ring->map_size = size;
+      return ring;
+    }
+
+    /* Checks the header written by the producer & copies its geometry, so neither a corrupt nor a later
+     * modified header can make a frame reach past its slot or the mapping
+     */
+    bool validate()
+    {
+      const shm_ring_header_t *h = header;
+      shm_ring_info_t g = { h->width, h->height, h->format, h->stride, h->num_slots, h->slot_size, h->frame_bytes };
+
+      if (h->magic != SHM_RING_MAGIC || h->version != SHM_RING_VERSION) return false;
+      if (g.format != SHM_FMT_BGR && g.format != SHM_FMT_NV12) return false;
+      if (g.width == 0 || g.height == 0 || g.width > SHM_RING_MAX_DIM || g.height > SHM_RING_MAX_DIM) return false;
+      if (g.num_slots == 0) return false;
+
+      /* The dimensions are capped, so the frame size can't overflow */
+      uint64_t row_bytes = (g.format == SHM_FMT_BGR) ? (uint64_t)g.width * 3 : g.width;
+      uint64_t rows = (g.format == SHM_FMT_BGR) ? g.height : (uint64_t)g.height + (g.height + 1) / 2;
+      if (g.stride < row_bytes || g.frame_bytes < (uint64_t)g.stride * rows) return false;
+
+      /* Slots are 64-byte aligned & hold their header & frame, all of them fit the mapping */
+      if (g.slot_size % 64 != 0 || g.slot_size < sizeof(shm_slot_header_t) ||
+          g.frame_bytes > g.slot_size - sizeof(shm_slot_header_t))
+      {
+        return false;
+      }
+      if (g.slot_size > (map_size - sizeof(shm_ring_header_t)) / g.num_slots) return false;
+
+      geometry = g;
+      return true;
+    }
+
+    shm_slot_header_t *slot( uint64_t n )
+    {
+      return (shm_slot_header_t *)((uint8_t *)(header + 1) + (n % geometry.num_slots) * geometry.slot_size);
+    }
+
+    void wake_consumers()
+    {
+      header->wake++;
+      if (header->waiters > 0)
+      {
+        syscall(SYS_futex, (uint32_t *)&header->wake, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,903 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _SOURCE_HPP_
+#define _SOURCE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Header files for OpenCV
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "frame.hpp"
+#include "decode.hpp"
+#include "shm_ring.hpp"
+#include "v4l2_capture.hpp"
+
+/*
+ * Input of the pipeline decode stage.  read() fills the next frame & its
+ * sequence number and returns false at the end of the stream or on error.
+ * It is called concurrently by all decode workers.
+ */
+class frame_source
+{
+  public:
+
+    virtual ~frame_source() {}
+
+    virtual bool read( frame_t &frame ) = 0;
+
+    /* Takes back the zero-copy buffer of a frame (frame.raw) once it has been converted or dropped,
+     * returns false if the buffer was overwritten while the frame used it
+     */
+    virtual bool release_raw( frame_t &frame ) { return true; }
+
+    /* True if the source stopped because of an error rather than end-of-stream */
+    bool failed() { return error; }
+
+    /* Decodes JPEG images that exceed min_size at least 2x at a reduced resolution */
+    void set_reduced_decode( cv::Size size ) { min_size = size; }
+
+    void print_decode_stats() { stats.print(); }
+
+  protected:
+
+    std::atomic<bool> error{false};
+    cv::Size          min_size;
+    decode_stats      stats;
+};
+
+/*
+ * Image files, decoded in parallel by the decode workers.
+ *
+ * Every worker claims the next file index and decodes it outside of any
+ * lock.  The kernel is asked to read the file `readahead` positions ahead
+ * into the page cache, so the decode workers rarely block on storage.
+ * The pipeline's frame pool bounds how many decoded frames are in flight.
+ */
+class image_source : public frame_source
+{
+  public:
+
+    image_source( const std::vector<std::string> &files,
+                  int                             readahead = 0,
+                  bool                            skip_errors = false ) : files(files), readahead(readahead),
+                                                                          skip_errors(skip_errors), next(0), skipped(0) {}
+
+    bool read( frame_t &frame )
+    {
+      while (!error)
+      {
+        uint64_t seq = next++;
+        if (seq >= files.size()) return false;
+
+        if (readahead > 0 && seq + readahead < files.size())
+        {
+          prefetch_file(files[seq + readahead]);
+        }
+
+        frame.seq = seq;
+        frame.name = files[seq];
+
+        if (decode_image_file(frame.name, frame.file_data, frame.image, min_size, frame.src_size, &stats))
+        {
+          return true;
+        }
+
+        if (!skip_errors)
+        {
+          std::cout << "ERROR: input file " << frame.name << " is empty" << std::endl;
+          error = true;
+          return false;
+        }
+
+        std::cout << "WARNING: skipping unreadable input file " << frame.name << std::endl;
+        skipped++;
+      }
+
+      return false;
+    }
+
+    uint64_t get_skipped() { return skipped; }
+
+  private:
+
+    std::vector<std::string> files;
+    int                      readahead;
+    bool                     skip_errors;
+    std::atomic<uint64_t>    next;
+    std::atomic<uint64_t>    skipped;
+
+    /* Starts an asynchronous read of the file into the page cache */
+    static void prefetch_file( const std::string &file )
+    {
+      int fd = open(file.c_str(), O_RDONLY);
+      if (fd >= 0)
+      {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+      }
+    }
+};
+
+/*
+ * Collects the image files (jpg, jpeg, png, bmp) of a directory, sorted by name
+ */
+static inline bool list_image_dir( const std::string &dir, std::vector<std::string> &files )
+{
+  std::error_code ec;
+  std::vector<std::string> dir_files;
+
+  for (auto &entry : std::filesystem::directory_iterator(dir, ec))
+  {
+    if (!entry.is_regular_file()) continue;
+
+    std::string ext = entry.path().extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    if (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp")
+    {
+      dir_files.push_back(entry.path().string());
+    }
+  }
+
+  if (ec) return false;
+
+  std::sort(dir_files.begin(), dir_files.end());
+  files.insert(files.end(), dir_files.begin(), dir_files.end());
+  return true;
+}
+
+/*
+ * Reads a list of image files, one path per line (empty lines & lines starting with '#' are ignored)
+ */
+static inline bool read_image_list( const std::string &list, std::vector<std::string> &files )
+{
+  std::ifstream in(list);
+  if (!in) return false;
+
+  std::string line;
+  while (std::getline(in, line))
+  {
+    while (!line.empty() && isspace(line.back())) line.pop_back();
+    if (line.empty() || line[0] == '#') continue;
+    files.push_back(line);
+  }
+  return true;
+}
+
+/*
+ * Benchmark input: a small ring of preloaded frames that is cycled `count`
+ * times.  Each frame is copied from the ring into the caller's buffer, or,
+ * with decode enabled, JPEG decoded from the in-memory file data so that the
+ * benchmark includes the decode cost without touching the file system.
+ * Memory use is independent of the iteration count.
+ */
+class ring_source : public frame_source
+{
+  public:
+
+    ring_source( uint64_t count, bool decode ) : count(count), decode(decode), next(0) {}
+
+    /* Preloads ring_size frames, cycling through the image files */
+    bool load( const std::vector<std::string> &files, size_t ring_size )
+    {
+      ring.resize(ring_size);
+      for (size_t i = 0; i < ring_size; i++)
+      {
+        ring[i].name = files[i % files.size()];
+        if (!decode_image_file(ring[i].name, ring[i].file_data, ring[i].image, min_size, ring[i].src_size, &stats))
+        {
+          std::cout << "ERROR: input file " << ring[i].name << " is empty" << std::endl;
+          return false;
+        }
+      }
+      return true;
+    }
+
+    uint64_t size() { return count; }
+
+    /* Restarts the benchmark sequence, e.g. for another calibration run */
+    void rewind() { next = 0; }
+
+    /* Fills image with frame seq of the benchmark sequence */
+    void load_frame( uint64_t seq, cv::Mat &image, cv::Size &src_size )
+    {
+      auto &entry = ring[seq % ring.size()];
+
+      if (decode)
+      {
+        decode_image_data(entry.file_data, image, min_size, src_size, &stats);
+      }
+      else
+      {
+        entry.image.copyTo(image);
+        src_size = entry.src_size;
+      }
+    }
+
+    bool read( frame_t &frame )
+    {
+      uint64_t seq = next++;
+      if (seq >= count) return false;
+
+      frame.seq = seq;
+      frame.name = ring[seq % ring.size()].name;
+      load_frame(seq, frame.image, frame.src_size);
+      return true;
+    }
+
+  private:
+
+    typedef struct
+    {
+      std::string        name;
+      std::vector<uchar> file_data;
+      cv::Mat            image;
+      cv::Size           src_size;
+    } ring_entry_t;
+
+    std::vector<ring_entry_t> ring;
+    uint64_t                  count;
+    bool                      decode;
+    std::atomic<uint64_t>     next;
+};
+
+/*
+ * Video file or camera read with cv::VideoCapture.  Frames are pulled on
+ * demand by the decode stage, so at most the frames of the frame pool are
+ * held in memory no matter how long the stream is.  Decoding is serialized,
+ * use a single decode worker.
+ */
+class video_source : public frame_source
+{
+  public:
+
+    /* device is a file name, a device path (/dev/videoN) or a camera index */
+    video_source( const std::string &device, uint64_t max_frames ) : device(device), max_frames(max_frames), next(0)
+    {
+      bool is_index = !device.empty();
+      for (char c : device)
+      {
+        if (!isdigit(c)) is_index = false;
+      }
+
+      if (is_index)
+      {
+        cap.open(atoi(device.c_str()));
+      }
+      else
+      {
+        cap.open(device);
+      }
+    }
+
+    bool is_opened() { return cap.isOpened(); }
+
+    double get_fps() { return cap.get(cv::CAP_PROP_FPS); }
+
+    bool read( frame_t &frame )
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+
+      if (max_frames > 0 && next >= max_frames) return false;
+
+      /* cv::VideoCapture reuses the frame's image buffer when the size doesn't change */
+      if (!cap.read(frame.image) || frame.image.empty()) return false;
+
+      frame.seq = next++;
+      frame.name = device;
+      frame.src_size = frame.image.size();
+      return true;
+    }
+
+  private:
+
+    std::mutex       mtx;
+    std::string      device;
+    cv::VideoCapture cap;
+    uint64_t         max_frames;
+    uint64_t         next;
+};
+
+/*
+ * Synthetic live source for exercising the admission policies without a
+ * camera.  Frames (a moving box on a gray background) are produced at a
+ * fixed rate like a free-running sensor: when the pipeline doesn't read a
+ * frame in time it is lost, so a blocking pipeline shows up as missed
+ * frames and sequence number gaps.  fps = 0 produces frames as fast as
+ * they are read.
+ */
+class synthetic_source : public frame_source
+{
+  public:
+
+    synthetic_source( int width, int height, float fps, uint64_t count ) : size(width, height), count(count),
+                                                                           next(0), start_ns(0), missed(0)
+    {
+      period_ns = (fps > 0.0f) ? (uint64_t)(1e9f / fps) : 0;
+    }
+
+    bool read( frame_t &frame )
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+
+      if (next >= count) return false;
+
+      if (period_ns > 0)
+      {
+        uint64_t now = frame_clock_ns();
+        if (next == 0) start_ns = now;
+
+        uint64_t due = start_ns + next * period_ns;
+        if (now < due)
+        {
+          std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+        }
+        else
+        {
+          /* Frames the sensor produced while nobody was reading are gone */
+          uint64_t behind = (now - due) / period_ns;
+          missed += behind;
+          next += behind;
+          if (next >= count) return false;
+        }
+      }
+
+      frame.image.create(size, CV_8UC3);
+      frame.image.setTo(cv::Scalar(96, 96, 96));
+
+      int box = size.height / 4;
+      int x = (int)((next * 8) % (uint64_t)std::max(size.width - box, 1));
+      cv::rectangle(frame.image, cv::Point(x, size.height / 2 - box / 2), cv::Point(x + box, size.height / 2 + box / 2),
+                    cv::Scalar(0, 160, 255), cv::FILLED);
+
+      frame.seq = next++;
+      frame.name = "synthetic";
+      frame.src_size = size;
+      return true;
+    }
+
+    /* Frames lost because the pipeline didn't read them in time */
+    uint64_t get_missed() { return missed; }
+
+  private:
+
+    std::mutex mtx;
+    cv::Size   size;
+    uint64_t   count;
+    uint64_t   next;
+    uint64_t   period_ns;
+    uint64_t   start_ns;
+    uint64_t   missed;
+};
+
+/* Set by SIGINT/SIGTERM while a shared-memory ring is read, ends the stream */
+static volatile sig_atomic_t shm_stop_requested = 0;
+
+static void shm_signal_handler( int )
+{
+  shm_stop_requested = 1;
+}
+
+/*
+ * Frames of a capture process published in a shared-memory ring (see
+ * shm_ring.hpp).  read() attaches the ring slot to the frame as a zero-copy
+ * view; the preprocess stage converts it into the frame's own BGR image and
+ * then checks that the producer didn't overwrite the slot in the meantime.
+ * Reading starts with the next frame the producer publishes.  Frames that
+ * were overwritten before they were read are lost, like the frames of a
+ * free-running camera.  Reading is serialized, use a single decode worker.
+ *
+ * While no frame arrives read() returns false when stop() is called or
+ * shm_stop_requested is set (end of stream), and fails when the producer
+ * died without closing the ring or nothing was published for the idle
+ * time-out (0 = wait as long as the producer lives).
+ */
+class shm_source : public frame_source
+{
+  public:
+
+    shm_source( const std::string &name, uint64_t max_frames ) : name(name), max_frames(max_frames), delivered(0),
+                                                                  lost(0), torn(0), stopping(false), idle_timeout_ns(0)
+    {
+      ring.reset(shm_ring::open(name));
+      if (ring) next = ring->published();
+    }
+
+    bool is_opened() { return ring != nullptr; }
+
+    const shm_ring_info_t &info() { return ring->info(); }
+
+    /* Fails a read that waited longer than timeout_ms for the next frame (0 = no time-out) */
+    void set_idle_timeout( float timeout_ms ) { idle_timeout_ns = (uint64_t)(timeout_ms * 1e6f); }
+
+    /* Ends the stream, a waiting read() returns within 100 ms */
+    void stop() { stopping = true; }
+
+    /* Why the source failed */
+    const std::string &get_error() { return error_msg; }
+
+    bool read( frame_t &frame )
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      const shm_ring_info_t &h = ring->info();
+
+      while (max_frames == 0 || delivered < max_frames)
+      {
+        uint64_t wait_start = frame_clock_ns();
+        while (!ring->wait_for(next, 100))
+        {
+          if (stopping || shm_stop_requested) return false;
+
+          if (!ring->producer_alive())
+          {
+            error_msg = "the producer exited without closing the ring";
+            error = true;
+            return false;
+          }
+
+          if (idle_timeout_ns > 0 && frame_clock_ns() - wait_start > idle_timeout_ns)
+          {
+            error_msg = "no frame was published for " + std::to_string(idle_timeout_ns / 1000000) + " ms";
+            error = true;
+            return false;
+          }
+        }
+
+        uint64_t published = ring->published();
+        if (published <= next) return false;
+
+        /* The slot of the oldest frame may already be rewritten with the next one */
+        uint64_t oldest = (published > h.num_slots) ? published - h.num_slots + 1 : 0;
+        if (next < oldest)
+        {
+          lost += oldest - next;
+          next = oldest;
+        }
+
+        uint64_t n = next++;
+        if (!ring->begin_read(n))
+        {
+          lost++;
+          continue;
+        }
+
+        int rows = (h.format == SHM_FMT_NV12) ? h.height + h.height / 2 : h.height;
+        frame.raw = cv::Mat(rows, h.width, (h.format == SHM_FMT_NV12) ? CV_8UC1 : CV_8UC3, ring->frame_data(n),
+                            h.stride);
+        frame.raw_format = (h.format == SHM_FMT_NV12) ? RAW_NV12 : RAW_BGR;
+        frame.raw_source = this;
+        frame.raw_tag = n;
+        frame.seq = n;
+        frame.name = name;
+        frame.src_size = cv::Size(h.width, h.height);
+        delivered++;
+        return true;
+      }
+
+      return false;
+    }
+
+    bool release_raw( frame_t &frame )
+    {
+      if (ring->end_read(frame.raw_tag)) return true;
+
+      torn++;
+      return false;
+    }
+
+    /* Frames overwritten by the producer before they were read */
+    uint64_t get_lost() { return lost; }
+
+    /* Frames overwritten by the producer while they were converted */
+    uint64_t get_torn() { return torn; }
+
+  private:
+
+    std::mutex                 mtx;
+    std::string                name;
+    std::unique_ptr<shm_ring>  ring;
+    uint64_t                   max_frames;
+    uint64_t                   next = 0;
+    uint64_t                   delivered;
+    uint64_t                   lost;
+    std::atomic<uint64_t>      torn;
+    std::atomic<bool>          stopping;
+    uint64_t                   idle_timeout_ns;
+    std::string                error_msg;
+};
+
+/*
+ * V4L2 camera read through mmap'd driver buffers (see v4l2_capture.hpp),
+ * bypassing cv::VideoCapture's copy & BGR conversion.  read() attaches the
+ * dequeued driver buffer to the frame as a zero-copy view in the camera's
+ * NV12, YUYV or BGR24 format; the preprocess stage converts it into the
+ * frame's own BGR image and then hands it back, which requeues it for the
+ * driver.  Frames the driver drops while the pipeline holds all buffers are
+ * counted as lost.  Reading is serialized, use a single decode worker.
+ *
+ * A camera that delivers no frame for a while (e.g. exposure changes or a
+ * pipeline holding all buffers) is waited for; the source only fails on an
+ * ioctl error or when no frame arrived for the stall limit (0 = no limit).
+ */
+class v4l2_source : public frame_source
+{
+  public:
+
+    v4l2_source( const std::string &device, int width, int height, uint32_t format, int num_buffers,
+                 uint64_t max_frames ) : device(device), max_frames(max_frames), next(0), lost(0), timeouts(0),
+                                         stall_limit_ns(0)
+    {
+      /* Formats the preprocess stage converts directly, preferred in this order */
+      std::vector<uint32_t> formats = { V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_BGR24 };
+      if (format != 0) formats = { format };
+
+      cap.reset(v4l2_capture::open(device, width, height, formats, num_buffers, open_error));
+    }
+
+    bool is_opened() { return cap != nullptr; }
+
+    /* Why the device couldn't be opened */
+    const std::string &get_open_error() { return open_error; }
+
+    v4l2_capture &info() { return *cap; }
+
+    /* Fails a read that waited longer than limit_ms for a frame (0 = wait forever) */
+    void set_stall_limit( float limit_ms ) { stall_limit_ns = (uint64_t)(limit_ms * 1e6f); }
+
+    /* Why the source failed */
+    const std::string &get_error() { return error_msg; }
+
+    bool read( frame_t &frame )
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+
+      if (max_frames > 0 && next >= max_frames) return false;
+
+      v4l2_frame_t buf;
+      uint64_t wait_start = frame_clock_ns();
+      while (true)
+      {
+        int rc = cap->dequeue(1000, buf);
+        if (rc == V4L2_DEQUEUE_OK) break;
+
+        if (rc == V4L2_DEQUEUE_ERROR)
+        {
+          error_msg = std::string("dequeuing a buffer failed: ") + strerror(errno);
+          error = true;
+          return false;
+        }
+
+        timeouts++;
+        if (stall_limit_ns > 0 && frame_clock_ns() - wait_start >= stall_limit_ns)
+        {
+          error_msg = "no frame for " + std::to_string(stall_limit_ns / 1000000) + " ms";
+          error = true;
+          return false;
+        }
+      }
+
+      if (next > 0 && buf.sequence > last_sequence + 1)
+      {
+        lost += buf.sequence - last_sequence - 1;
+      }
+      last_sequence = buf.sequence;
+
+      int rows = cap->get_height();
+      int type = CV_8UC3;
+      switch (cap->get_format())
+      {
+        case V4L2_PIX_FMT_NV12: rows += rows / 2; type = CV_8UC1; frame.raw_format = RAW_NV12; break;
+        case V4L2_PIX_FMT_YUYV: type = CV_8UC2; frame.raw_format = RAW_YUYV; break;
+        default:                frame.raw_format = RAW_BGR; break;
+      }
+
+      frame.raw = cv::Mat(rows, cap->get_width(), type, buf.data, cap->get_stride());
+      frame.raw_source = this;
+      frame.raw_tag = buf.index;
+      frame.seq = next++;
+      frame.name = device;
+      frame.src_size = cv::Size(cap->get_width(), cap->get_height());
+      return true;
+    }
+
+    bool release_raw( frame_t &frame )
+    {
+      if (!cap->requeue((int)frame.raw_tag)) error = true;
+      return true;
+    }
+
+    /* Frames the driver dropped because no buffer was queued */
+    uint64_t get_lost() { return lost; }
+
+    /* 1 second waits that ended without a frame */
+    uint64_t get_timeouts() { return timeouts; }
+
+  private:
+
+    std::mutex                    mtx;
+    std::string                   device;
+    std::string                   open_error;
+    std::unique_ptr<v4l2_capture> cap;
+    uint64_t                      max_frames;
+    uint64_t                      next;
+    uint32_t                      last_sequence = 0;
+    uint64_t                      lost;
+    uint64_t                      timeouts;
+    uint64_t                      stall_limit_ns;
+    std::string                   error_msg;
+};
+
+/* Parses a rawvideo frame spec "WxH:fmt", fmt = bgr24, rgb24, gray, nv12 or yuv420p (ffmpeg pix_fmt names) */
+static inline bool parse_rawvideo_spec( const std::string &spec, int &width, int &height, int &format )
+{
+  static const char *names[] = { "bgr24", "rgb24", "gray", "nv12", "yuv420p" };
+  static const int formats[] = { RAW_BGR, RAW_RGB, RAW_GRAY, RAW_NV12, RAW_I420 };
+  char fmt[16];
+
+  if (sscanf(spec.c_str(), "%dx%d:%15s", &width, &height, fmt) != 3 || width <= 0 || height <= 0) return false;
+
+  for (int f = 0; f < 5; f++)
+  {
+    if (!strcmp(fmt, names[f]))
+    {
+      format = formats[f];
+      /* The chroma planes of 4:2:0 formats need even dimensions */
+      return (format != RAW_NV12 && format != RAW_I420) || (width % 2 == 0 && height % 2 == 0);
+    }
+  }
+  return false;
+}
+
+/*
+ * Fixed-size rawvideo packets read from a file descriptor (stdin), e.g. the
+ * output of "ffmpeg -f rawvideo".  Every packet is read straight into the
+ * buffer of its frame with as few read() calls as the pipe allows (the pipe
+ * buffer is enlarged to 1 MB): BGR frames land in the frame image, other
+ * formats in the frame's file buffer, which the preprocess stage converts
+ * like a zero-copy input.  Reading is serialized, use a single decode worker.
+ */
+class stdin_source : public frame_source
+{
+  public:
+
+    stdin_source( int fd, int width, int height, int format, uint64_t max_frames ) : fd(fd), size(width, height),
+                                                                                    format(format), max_frames(max_frames),
+                                                                                    next(0), truncated(0)
+    {
+      bool planar = (format == RAW_NV12 || format == RAW_I420);
+      rows = planar ? height + height / 2 : height;
+      type = (format == RAW_BGR || format == RAW_RGB) ? CV_8UC3 : CV_8UC1;
+      packet_bytes = (size_t)rows * width * ((type == CV_8UC3) ? 3 : 1);
+
+      /* Fails harmlessly when the input isn't a pipe */
+      fcntl(fd, F_SETPIPE_SZ, 1 << 20);
+    }
+
+    size_t get_packet_bytes() { return packet_bytes; }
+
+    bool read( frame_t &frame )
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+
+      if (max_frames > 0 && next >= max_frames) return false;
+
+      uchar *data;
+      if (format == RAW_BGR)
+      {
+        frame.image.create(size, CV_8UC3);
+        data = frame.image.data;
+      }
+      else
+      {
+        frame.file_data.resize(packet_bytes);
+        data = frame.file_data.data();
+      }
+
+      size_t got = read_fully(data, packet_bytes);
+      if (got < packet_bytes)
+      {
+        /* A partial packet at the end means the frame size doesn't match the stream */
+        if (got > 0) truncated = got;
+        return false;
+      }
+
+      if (format != RAW_BGR)
+      {
+        frame.raw = cv::Mat(rows, size.width, type, data);
+        frame.raw_format = format;
+        frame.raw_source = this;
+      }
+      frame.seq = next++;
+      frame.name = "stdin";
+      frame.src_size = size;
+      return true;
+    }
+
+    /* Size of a partial packet at the end of the input (0 = none) */
+    size_t get_truncated() { return truncated; }
+
+  private:
+
+    std::mutex mtx;
+    int        fd;
+    cv::Size   size;
+    int        format;
+    int        rows;
+    int        type;
+    size_t     packet_bytes;
+    uint64_t   max_frames;
+    uint64_t   next;
+    size_t     truncated;
+
+    size_t read_fully( uchar *data, size_t bytes )
+    {
+      size_t got = 0;
+      while (got < bytes)
+      {
+        ssize_t n = ::read(fd, data + got, bytes - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0)
+        {
+          error = true;
+          break;
+        }
+        if (n == 0) break;
+        got += n;
+      }
+      return got;
+    }
+};
+
+/*
+ * Multiplexes several live streams (cameras, videos, synthetic sources) into
+ * one pipeline.  Decode workers read the streams round-robin, preferring a
+ * stream no other worker is reading, so frames of all streams are interleaved
+ * into the DPU batches.  Streams of a more urgent priority class are served
+ * first whenever they are not already being read, so a bulk stream only gets
+ * the decode time the higher classes leave over.  Every frame is tagged with its stream index and a
+ * gap-free per-stream sequence number, which the pipeline's reorder buffer
+ * uses to deliver each stream in order.  A stream that ends or fails is
+ * retired while the others continue.  Frames also carry the priority class
+ * & deadline of their stream for the pipeline's deadline scheduling.
+ */
+class mux_source : public frame_source
+{
+  public:
+
+    mux_source() : next(0) {}
+
+    /* Adds a stream, the mux takes ownership of the source */
+    void add( frame_source *source, const std::string &name )
+    {
+      streams.emplace_back(new stream_t());
+      streams.back()->source.reset(source);
+      streams.back()->name = name;
+    }
+
+    /* Sets the priority class & the per-frame deadline (0 = none) of a stream */
+    void set_priority( int stream, int priority, float deadline_ms )
+    {
+      streams[stream]->priority = priority;
+      streams[stream]->deadline_ns = (uint64_t)(deadline_ms * 1e6f);
+    }
+
+    int size() { return streams.size(); }
+
+    const std::string &get_name( int stream ) { return streams[stream]->name; }
+
+    bool read( frame_t &frame )
+    {
+      size_t n = streams.size();
+
+      while (true)
+      {
+        size_t start = next++;
+        int wait_id = -1;
+
+        /* Round-robin within a priority class, most urgent class first */
+        for (int p = 0; p < NUM_PRIORITIES; p++)
+        {
+          for (size_t i = 0; i < n; i++)
+          {
+            int id = (start + i) % n;
+            stream_t &s = *streams[id];
+            if (s.done || s.priority != p) continue;
+            if (wait_id < 0) wait_id = id;
+
+            std::unique_lock<std::mutex> lock(s.mtx, std::try_to_lock);
+            if (lock.owns_lock() && read_stream(id, frame))
+            {
+              return true;
+            }
+          }
+        }
+
+        if (wait_id < 0)
+        {
+          return false;
+        }
+
+        /* Every open stream is being read by another worker, wait for the most urgent one */
+        int id = wait_id;
+        std::unique_lock<std::mutex> lock(streams[id]->mtx);
+        if (read_stream(id, frame))
+        {
+          return true;
+        }
+      }
+    }
+
+  private:
+
+    typedef struct
+    {
+      std::mutex                    mtx;
+      std::unique_ptr<frame_source> source;
+      std::string                   name;
+      std::atomic<bool>             done{false};
+      uint64_t                      seq = 0;
+      int                           priority = PRIORITY_NORMAL;
+      uint64_t                      deadline_ns = 0;
+    } stream_t;
+
+    std::vector<std::unique_ptr<stream_t>> streams;
+    std::atomic<uint64_t>                  next;
+
+    /* Reads the next frame of a stream, the caller holds the stream lock */
+    bool read_stream( int id, frame_t &frame )
+    {
+      stream_t &s = *streams[id];
+      if (s.done) return false;
+
+      if (!s.source->read(frame))
+      {
+        if (s.source->failed())
+        {
+          std::cout << "WARNING: stream " << id << " (" << s.name << ") failed" << std::endl;
+        }
+        s.done = true;
+        return false;
+      }
+
+      frame.stream = id;
+      frame.seq = s.seq++;
+      frame.priority = s.priority;
+      frame.deadline_ns = (s.deadline_ns > 0) ? frame_clock_ns() + s.deadline_ns : 0;
+      return true;
+    }
+};
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _SPSC_RING_HPP_
+#define _SPSC_RING_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+
+/* Hint to the CPU that we are busy-waiting */
+static inline void cpu_relax()
+{
+#if defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield" ::: "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+/*
+ * Lock-free single-producer / single-consumer ring buffer
+ *
+ * The producer only writes the tail index and the consumer only writes the
+ * head index, so a hand-off costs one release store and no lock or system
+ * call.  Each side keeps a cached copy of the other side's index to avoid
+ * bouncing the cache line on every operation.  The blocking push()/pop()
+ * spin briefly, then yield and finally sleep, so an idle stage does not burn
+ * a core.
+ *
+ * Must only be used with exactly one producer thread & one consumer thread.
+ */
+template <typename T>
+class spsc_ring : public blocking_queue<T>
+{
+  public:
+
+    spsc_ring( size_t capacity ) : capacity(capacity)
+    {
+      size_t size = 1;
+      while (size < capacity) size <<= 1;
+
+      slots.resize(size);
+      mask = size - 1;
+      head = 0;
+      tail = 0;
+      head_cache = 0;
+      tail_cache = 0;
+      closed = false;
+
+      pushes = 0;
+      depth_sum = 0;
+      max_depth = 0;
+    }
+
+    /* Producer side, fails if the ring is full */
+    bool try_push( const T &item )
+    {
+      size_t t = tail.load(std::memory_order_relaxed);
+
+      if (t - head_cache >= capacity)
+      {
+        head_cache = head.load(std::memory_order_acquire);
+        if (t - head_cache >= capacity) return false;
+      }
+
+      slots[t & mask] = item;
+      tail.store(t + 1, std::memory_order_release);
+
+      /* Sample the queue depth on every push */
+      size_t depth = t + 1 - head_cache;
+      pushes++;
+      depth_sum += depth;
+      if (depth > max_depth) max_depth = depth;
+
+      return true;
+    }
+
+    /* Consumer side, fails if the ring is empty */
+    bool try_pop( T &item )
+    {
+      size_t h = head.load(std::memory_order_relaxed);
+
+      if (h == tail_cache)
+      {
+        tail_cache = tail.load(std::memory_order_acquire);
+        if (h == tail_cache) return false;
+      }
+
+      item = slots[h & mask];
+      head.store(h + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool push( T item )
+    {
+      int spins = 0;
+      while (!try_push(item))
+      {
+        if (closed.load(std::memory_order_acquire)) return false;
+        backoff(spins);
+      }
+      return true;
+    }
+
+    bool pop( T &item )
+    {
+      int spins = 0;
+      while (!try_pop(item))
+      {
+        /* Drain anything pushed before the ring was closed */
+        if (closed.load(std::memory_order_acquire)) return try_pop(item);
+        backoff(spins);
+      }
+      return true;
+    }
+
+    bool pop_until( T &item, std::chrono::steady_clock::time_point deadline )
+    {
+      int spins = 0;
+      while (!try_pop(item))
+      {
+        if (closed.load(std::memory_order_acquire)) return try_pop(item);
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        backoff(spins);
+      }
+      return true;
+    }
+
+    void close() { closed.store(true, std::memory_order_release); }
+
+    size_t get_capacity() { return capacity; }
+    uint64_t get_pushes() { return pushes; }
+    size_t get_max_depth() { return max_depth; }
+    float avg_depth() { return (pushes == 0) ? 0.0f : (float)depth_sum / (float)pushes; }
+
+  private:
+
+    std::vector<T>                  slots;
+    size_t                          capacity;
+    size_t                          mask;
+    std::atomic<bool>               closed;
+
+    alignas(64) std::atomic<size_t> head;         // Written by the consumer
+    alignas(64) size_t              tail_cache;   // Consumer's copy of tail
+    alignas(64) std::atomic<size_t> tail;         // Written by the producer
+    alignas(64) size_t              head_cache;   // Producer's copy of head
+
+    /* Producer statistics */
+    uint64_t                        pushes;
+    uint64_t                        depth_sum;
+    size_t                          max_depth;
+
+    static void backoff( int &spins )
+    {
+      /* Spinning only helps if the other side runs on another core */
+      static const int spin_limit = (std::thread::hardware_concurrency() > 1) ? 256 : 0;
+
+      if (spins < spin_limit)
+      {
+        cpu_relax();
+      }
+      else if (spins < spin_limit + 256)
+      {
+        std::this_thread::yield();
+      }
+      else
+      {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+      spins++;
+    }
+};
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _TENSOR_RECORDING_HPP_
+#define _TENSOR_RECORDING_HPP_
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "frame.hpp"
+#include "npy_io.hpp"
+#include "yolact.hpp"
+
+/*
+ * Recorded output tensors
+ *
+ * yolact.exe --dump_tensors saves the output tensors of every frame as
+ * <name>_loc/conf/mask/proto.npy with a batch dimension of 1, the layout
+ * layers/functions/detection.py takes with is_quant=True.  The host tools
+ * (bench/kernel_bench.cpp, detect_tensors.cpp) load them back into frames.
+ */
+
+static const char *tensor_suffixes[4] = { "_loc.npy", "_conf.npy", "_mask.npy", "_proto.npy" };
+
+/* Saves the output tensors of a frame, named after its sequence number (and stream) */
+static inline bool save_frame_tensors( const std::string &dir, const frame_t &frame, bool stream_names )
+{
+  char name[32];
+  if (stream_names)
+  {
+    sprintf(name, "/s%02d_%06llu", frame.stream, (unsigned long long)frame.seq);
+  }
+  else
+  {
+    sprintf(name, "/%06llu", (unsigned long long)frame.seq);
+  }
+
+  std::string base = dir + name;
+  return npy_write(base + tensor_suffixes[0], frame.loc.data(), {1, NUM_PRIORS, 4}) &&
+         npy_write(base + tensor_suffixes[1], frame.conf.data(), {1, NUM_PRIORS, NUM_CLASSES}) &&
+         npy_write(base + tensor_suffixes[2], frame.mask.data(), {1, NUM_PRIORS, PROTO_C}) &&
+         npy_write(base + tensor_suffixes[3], frame.proto.data(), {1, PROTO_HW, PROTO_HW, PROTO_C});
+}
+
+/* Lists the recorded frames of a directory as sorted paths without the tensor suffix */
+static inline bool list_frame_tensors( const std::string &dir, std::vector<std::string> &bases, std::string &error )
+{
+  std::error_code ec;
+  bases.clear();
+
+  for (auto &entry : std::filesystem::directory_iterator(dir, ec))
+  {
+    std::string path = entry.path().string();
+    size_t len = strlen(tensor_suffixes[0]);
+    if (path.size() > len && path.compare(path.size() - len, len, tensor_suffixes[0]) == 0)
+    {
+      bases.push_back(path.substr(0, path.size() - len));
+    }
+  }
+  if (ec)
+  {
+    error = "unable to read " + dir;
+    return false;
+  }
+  if (bases.empty())
+  {
+    error = "no *" + std::string(tensor_suffixes[0]) + " recordings in " + dir;
+    return false;
+  }
+
+  std::sort(bases.begin(), bases.end());
+  return true;
+}
+
+/* Loads the output tensors of a recorded frame */
+static inline bool load_frame_tensors( const std::string &base, frame_t &frame, std::string &error )
+{
+  const size_t expected[4] = { NUM_PRIORS * 4, NUM_PRIORS * NUM_CLASSES, NUM_PRIORS * PROTO_C, PROTO_SIZE };
+  std::vector<float> *tensors[4] = { &frame.loc, &frame.conf, &frame.mask, &frame.proto };
+
+  for (int t = 0; t < 4; t++)
+  {
+    std::vector<size_t> shape;
+    if (!npy_read(base + tensor_suffixes[t], *tensors[t], shape, error)) return false;
+
+    if (tensors[t]->size() != expected[t])
+    {
+      error = base + tensor_suffixes[t] + " has " + std::to_string(tensors[t]->size()) + " values, expected " +
+              std::to_string(expected[t]);
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
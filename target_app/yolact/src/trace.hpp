@@ -0,0 +1,269 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _TRACE_HPP_
+#define _TRACE_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "latency_timer.hpp"
+
+/*
+ * Per-frame event tracing in Chrome trace format (chrome://tracing, ui.perfetto.dev)
+ *
+ * A trace_scope records the begin & end counter ticks of a processing step
+ * together with the frame sequence number.  Every thread appends its events
+ * to its own preallocated buffer, so recording takes no lock and no system
+ * call: two counter reads and a 32 byte store.  A thread's buffer is
+ * registered (once, under a lock) by its first event; a full buffer drops
+ * further events.  trace_write() converts the buffers to Chrome trace JSON
+ * with one complete ("X") event per step, once the traced threads are idle.
+ * With tracing off a scope costs one load & branch.
+ */
+
+/* Traced steps */
+enum
+{
+  TRACE_DECODE = 0,
+  TRACE_PREPROCESS,
+  TRACE_INPUT_COPY,
+  TRACE_SYNC_FOR_WRITE,
+  TRACE_EXECUTE,
+  TRACE_SYNC_FOR_READ,
+  TRACE_COPY,
+  TRACE_POSTPROCESS,
+  TRACE_SCAN,
+  TRACE_NMS,
+  TRACE_RENDER,
+  TRACE_MASK,
+  TRACE_OVERLAY,
+  TRACE_SINK,
+  NUM_TRACE_EVENTS
+};
+
+static const char *trace_names[NUM_TRACE_EVENTS] =
+{
+  "decode", "preprocess", "input_copy", "sync_for_write", "execute", "sync_for_read", "copy", "postprocess", "scan",
+  "nms", "render", "mask", "overlay", "sink"
+};
+
+/* Frame id of scopes nested in a frame's scope */
+#define TRACE_CURRENT_FRAME  -2
+
+typedef struct
+{
+  uint64_t begin;       // Counter ticks
+  uint64_t end;
+  int64_t  frame;       // Frame sequence number (-1 = none)
+  uint32_t name;        // TRACE_*
+  uint32_t count;       // Frames of a batch
+} trace_event_t;
+
+typedef struct
+{
+  int                        tid;
+  std::string                name;
+  std::vector<trace_event_t> events;  // Preallocated, only written by the owner thread
+  std::atomic<size_t>        used{0};
+  uint64_t                   dropped = 0;
+} trace_buffer_t;
+
+/* Process-wide trace state */
+typedef struct
+{
+  std::atomic<bool>                            enabled{false};
+  size_t                                       capacity = 0;    // Events per thread
+  uint64_t                                     start_ticks = 0;
+  std::mutex                                   mtx;
+  std::vector<std::unique_ptr<trace_buffer_t>> buffers;
+} trace_state_t;
+
+static inline trace_state_t &trace_state()
+{
+  static trace_state_t state;
+  return state;
+}
+
+/* The calling thread's buffer, registered on first use */
+static inline trace_buffer_t *trace_thread_buffer()
+{
+  static thread_local trace_buffer_t *buffer = nullptr;
+
+  if (buffer == nullptr)
+  {
+    trace_state_t &state = trace_state();
+    std::unique_ptr<trace_buffer_t> b(new trace_buffer_t());
+    b->tid = (int)syscall(SYS_gettid);
+    b->events.resize(state.capacity);
+
+    std::lock_guard<std::mutex> lock(state.mtx);
+    buffer = b.get();
+    state.buffers.push_back(std::move(b));
+  }
+  return buffer;
+}
+
+static inline bool trace_enabled() { return trace_state().enabled.load(std::memory_order_relaxed); }
+
+/* Starts recording, events_per_thread bounds the memory used by each traced thread */
+static inline void trace_start( size_t events_per_thread )
+{
+  trace_state_t &state = trace_state();
+  state.capacity = events_per_thread;
+  fast_clock_ns_per_tick();
+  state.start_ticks = fast_clock_ticks();
+  state.enabled = true;
+}
+
+/* Names the calling thread in the trace (e.g. "infer/0") */
+static inline void trace_set_thread_name( const std::string &name )
+{
+  if (trace_enabled()) trace_thread_buffer()->name = name;
+}
+
+static inline int64_t &trace_current_frame()
+{
+  static thread_local int64_t frame = -1;
+  return frame;
+}
+
+/*
+ * Records one event from construction to destruction.  A scope with a frame
+ * id becomes the current frame of the thread for the scopes nested in it,
+ * which pass TRACE_CURRENT_FRAME.
+ */
+class trace_scope
+{
+  public:
+
+    trace_scope( int name, int64_t frame = -1, uint32_t count = 1 ) : active(trace_enabled())
+    {
+      if (!active) return;
+
+      int64_t &current = trace_current_frame();
+      saved = current;
+      if (frame == TRACE_CURRENT_FRAME)
+      {
+        frame = current;
+      }
+      else if (frame >= 0)
+      {
+        current = frame;
+      }
+
+      event.name = name;
+      event.frame = frame;
+      event.count = count;
+      event.begin = fast_clock_ticks();
+    }
+
+    ~trace_scope()
+    {
+      if (!active) return;
+
+      event.end = fast_clock_ticks();
+      trace_current_frame() = saved;
+
+      trace_buffer_t *buffer = trace_thread_buffer();
+      size_t used = buffer->used.load(std::memory_order_relaxed);
+      if (used < buffer->events.size())
+      {
+        buffer->events[used] = event;
+        buffer->used.store(used + 1, std::memory_order_release);
+      }
+      else
+      {
+        buffer->dropped++;
+      }
+    }
+
+    /* Sets the frame once it is known, e.g. after reading it */
+    void set_frame( int64_t frame ) { event.frame = frame; }
+
+  private:
+
+    bool          active;
+    int64_t       saved;
+    trace_event_t event;
+};
+
+/* Stops recording & writes the events as Chrome trace JSON, returns false if the file can't be written */
+static inline bool trace_write( const std::string &path )
+{
+  trace_state_t &state = trace_state();
+  state.enabled = false;
+
+  FILE *out = fopen(path.c_str(), "w");
+  if (out == nullptr) return false;
+
+  double us_per_tick = fast_clock_ns_per_tick() * 1e-3;
+  int pid = (int)getpid();
+  bool first = true;
+  uint64_t events = 0, dropped = 0;
+
+  fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  std::lock_guard<std::mutex> lock(state.mtx);
+  for (auto &buffer : state.buffers)
+  {
+    if (!buffer->name.empty())
+    {
+      fprintf(out, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+              first ? "" : ",\n", pid, buffer->tid, buffer->name.c_str());
+      first = false;
+    }
+
+    size_t used = buffer->used.load(std::memory_order_acquire);
+    for (size_t e = 0; e < used; e++)
+    {
+      const trace_event_t &ev = buffer->events[e];
+      fprintf(out, "%s{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+              first ? "" : ",\n", trace_names[ev.name], pid, buffer->tid,
+              (double)(int64_t)(ev.begin - state.start_ticks) * us_per_tick, (double)(ev.end - ev.begin) * us_per_tick);
+      if (ev.frame >= 0)
+      {
+        fprintf(out, ",\"args\":{\"frame\":%lld,\"frames\":%u}", (long long)ev.frame, ev.count);
+      }
+      fprintf(out, "}");
+      first = false;
+    }
+
+    events += used;
+    dropped += buffer->dropped;
+  }
+
+  fprintf(out, "\n]}\n");
+  bool ok = (fclose(out) == 0);
+
+  /* The path is user supplied & unbounded, so it isn't formatted into a line buffer */
+  std::cout << "Trace: " << events << " events of " << state.buffers.size() << " threads written to " << path;
+  if (dropped > 0) std::cout << ", " << dropped << " events dropped (full thread buffers)";
+  std::cout << std::endl;
+  return ok;
+}
+
+#endif
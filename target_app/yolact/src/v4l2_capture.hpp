@@ -0,0 +1,291 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _V4L2_CAPTURE_HPP_
+#define _V4L2_CAPTURE_HPP_
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * Native V4L2 capture with memory mapped driver buffers
+ *
+ * The driver fills a fixed set of mmap'd buffers.  dequeue() hands out a
+ * filled buffer, which stays owned by the caller (and can't be refilled by
+ * the driver) until requeue() gives it back, so the caller can process the
+ * frame in place.  While all buffers are held the driver drops frames, which
+ * shows up as gaps in the buffer sequence numbers.  Only the C++ standard
+ * library & Linux are used; test with the vivid virtual video driver
+ * (modprobe vivid).
+ */
+
+/* Results of v4l2_capture::dequeue() */
+enum
+{
+  V4L2_DEQUEUE_OK = 0,
+  V4L2_DEQUEUE_TIMEOUT,   // No frame within the time-out, the device is still usable
+  V4L2_DEQUEUE_ERROR      // The ioctl or poll failed, e.g. the device was unplugged
+};
+
+typedef struct
+{
+  int      index;       // Buffer index, passed back to requeue()
+  uint8_t *data;
+  uint32_t bytes;       // Bytes filled by the driver
+  uint32_t sequence;    // Frame counter of the driver
+  uint64_t timestamp_ns;
+} v4l2_frame_t;
+
+class v4l2_capture
+{
+  public:
+
+    ~v4l2_capture()
+    {
+      int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      if (streaming) xioctl(VIDIOC_STREAMOFF, &type);
+
+      for (auto &buf : buffers)
+      {
+        munmap(buf.start, buf.length);
+      }
+      close(fd);
+    }
+
+    /* Opens a capture device, negotiates the first of the pixel formats (V4L2_PIX_FMT_*) that the
+     * driver accepts at width x height, maps num_buffers buffers & starts streaming.  Returns nullptr
+     * with a description in error on failure.
+     */
+    static v4l2_capture *open( const std::string           &device,
+                               int                          width,
+                               int                          height,
+                               const std::vector<uint32_t> &formats,
+                               int                          num_buffers,
+                               std::string                 &error )
+    {
+      int fd = ::open(device.c_str(), O_RDWR | O_NONBLOCK);
+      if (fd < 0)
+      {
+        error = "unable to open " + device + ": " + strerror(errno);
+        return nullptr;
+      }
+
+      v4l2_capture *cap = new v4l2_capture(fd);
+      if (!cap->setup(width, height, formats, num_buffers, error))
+      {
+        error = device + ": " + error;
+        delete cap;
+        return nullptr;
+      }
+      return cap;
+    }
+
+    /* Waits up to timeout_ms for a filled buffer, returns V4L2_DEQUEUE_* */
+    int dequeue( int timeout_ms, v4l2_frame_t &frame )
+    {
+      v4l2_buffer buf;
+
+      while (true)
+      {
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        if (xioctl(VIDIOC_DQBUF, &buf) == 0) break;
+        if (errno != EAGAIN) return V4L2_DEQUEUE_ERROR;
+
+        pollfd pfd = { fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready == 0) return V4L2_DEQUEUE_TIMEOUT;
+        if (ready < 0) return V4L2_DEQUEUE_ERROR;
+        if (pfd.revents & (POLLERR | POLLHUP))
+        {
+          errno = ENODEV;
+          return V4L2_DEQUEUE_ERROR;
+        }
+      }
+
+      frame.index = buf.index;
+      frame.data = (uint8_t *)buffers[buf.index].start;
+      frame.bytes = buf.bytesused;
+      frame.sequence = buf.sequence;
+      frame.timestamp_ns = (uint64_t)buf.timestamp.tv_sec * 1000000000ull + (uint64_t)buf.timestamp.tv_usec * 1000ull;
+      return V4L2_DEQUEUE_OK;
+    }
+
+    /* Gives a dequeued buffer back to the driver */
+    bool requeue( int index )
+    {
+      v4l2_buffer buf;
+      memset(&buf, 0, sizeof(buf));
+      buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      buf.memory = V4L2_MEMORY_MMAP;
+      buf.index = index;
+      return xioctl(VIDIOC_QBUF, &buf) == 0;
+    }
+
+    int get_width() { return width; }
+    int get_height() { return height; }
+    int get_stride() { return stride; }
+    uint32_t get_format() { return format; }
+    int get_num_buffers() { return (int)buffers.size(); }
+
+    /* Four character code of a pixel format, e.g. "NV12" */
+    static std::string fourcc_string( uint32_t fourcc )
+    {
+      std::string s;
+      for (int c = 0; c < 4; c++)
+      {
+        s += (char)((fourcc >> (8 * c)) & 0xff);
+      }
+      return s;
+    }
+
+  private:
+
+    typedef struct
+    {
+      void   *start;
+      size_t  length;
+    } mapping_t;
+
+    int                    fd;
+    bool                   streaming = false;
+    int                    width = 0;
+    int                    height = 0;
+    int                    stride = 0;
+    uint32_t               format = 0;
+    std::vector<mapping_t> buffers;
+
+    v4l2_capture( int fd ) : fd(fd) {}
+
+    int xioctl( unsigned long request, void *arg )
+    {
+      int ret;
+      do
+      {
+        ret = ioctl(fd, request, arg);
+      } while (ret < 0 && errno == EINTR);
+      return ret;
+    }
+
+    bool setup( int req_width, int req_height, const std::vector<uint32_t> &formats, int num_buffers, std::string &error )
+    {
+      v4l2_capability caps;
+      memset(&caps, 0, sizeof(caps));
+      if (xioctl(VIDIOC_QUERYCAP, &caps) < 0)
+      {
+        error = "not a V4L2 device";
+        return false;
+      }
+
+      uint32_t dev_caps = (caps.capabilities & V4L2_CAP_DEVICE_CAPS) ? caps.device_caps : caps.capabilities;
+      if (!(dev_caps & V4L2_CAP_VIDEO_CAPTURE) || !(dev_caps & V4L2_CAP_STREAMING))
+      {
+        error = "no single-planar streaming capture support";
+        return false;
+      }
+
+      /* The driver adjusts the request to what it supports, a different pixel format means it isn't supported */
+      v4l2_format fmt;
+      bool found = false;
+      for (uint32_t pixfmt : formats)
+      {
+        memset(&fmt, 0, sizeof(fmt));
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        fmt.fmt.pix.width = req_width;
+        fmt.fmt.pix.height = req_height;
+        fmt.fmt.pix.pixelformat = pixfmt;
+        fmt.fmt.pix.field = V4L2_FIELD_NONE;
+        if (xioctl(VIDIOC_S_FMT, &fmt) == 0 && fmt.fmt.pix.pixelformat == pixfmt)
+        {
+          found = true;
+          break;
+        }
+      }
+      if (!found)
+      {
+        error = "none of the requested pixel formats is supported";
+        return false;
+      }
+
+      width = fmt.fmt.pix.width;
+      height = fmt.fmt.pix.height;
+      stride = fmt.fmt.pix.bytesperline;
+      format = fmt.fmt.pix.pixelformat;
+
+      v4l2_requestbuffers req;
+      memset(&req, 0, sizeof(req));
+      req.count = num_buffers;
+      req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      req.memory = V4L2_MEMORY_MMAP;
+      if (xioctl(VIDIOC_REQBUFS, &req) < 0 || req.count < 2)
+      {
+        error = "unable to allocate capture buffers";
+        return false;
+      }
+
+      for (uint32_t b = 0; b < req.count; b++)
+      {
+        v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = b;
+        if (xioctl(VIDIOC_QUERYBUF, &buf) < 0)
+        {
+          error = "unable to query capture buffer";
+          return false;
+        }
+
+        void *start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+        if (start == MAP_FAILED)
+        {
+          error = "unable to map capture buffer";
+          return false;
+        }
+        buffers.push_back({ start, buf.length });
+
+        if (!requeue(b))
+        {
+          error = "unable to queue capture buffer";
+          return false;
+        }
+      }
+
+      int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      if (xioctl(VIDIOC_STREAMON, &type) < 0)
+      {
+        error = std::string("unable to start streaming: ") + strerror(errno);
+        return false;
+      }
+      streaming = true;
+      return true;
+    }
+};
+
+#endif
@@ -14,7 +14,13 @@
  * limitations under the License.
  */
 
+#ifndef _YOLACT_HPP_
+#define _YOLACT_HPP_
+
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
 #include "unistd.h"
@@ -24,13 +30,20 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 
-// Header files for Vitis AI
+// Header files for Vitis AI, YOLACT_NO_VITIS builds the CPU processing only (host benchmarks & tools)
+#ifndef YOLACT_NO_VITIS
 #include <vitis/ai/graph_runner.hpp>
 #include <vitis/ai/nnpp/apply_nms.hpp>
+#else
+#include "nms_reference.hpp"
+#endif
 
 // Timer class
-#include "lnx_time.hpp"
+#include "latency_timer.hpp"
+#include "trace.hpp"
+#include "perf_counters.hpp"
 #include "coco_labels.hpp"
+#include "frame.hpp"
 
 // Model constants
 #define PROTO_HW    (138)
@@ -59,21 +72,20 @@ class yolact
 
     yolact()
     {
+      prior_data = nullptr;
       pre_timer.reset();
       exec_timer.reset();
       post_timer.reset();
       overlay_timer.reset();
+      set_thresholds(-1.0f, -1.0f);
     }
 
     ~yolact()
     {
-      free(proto_data);
-      free(loc_data);
-      free(conf_data);
-      free(mask_data);
       free(prior_data);
     }
 
+#ifndef YOLACT_NO_VITIS
     int create( std::string xmodel )
     {
       /* Create the graph runner */
@@ -82,93 +94,274 @@ class yolact
       runner = vitis::ai::GraphRunner::create_graph_runner(graph.get(), attr.get());
       CHECK(runner != nullptr);
 
-      /* Determine batch size */
+      /* Determine batch size & input geometry */
       auto input_tensor_buffer = runner->get_inputs();
-      batch_size = input_tensor_buffer[0]->get_tensor()->get_shape().at(0);
-
-      /* Allocate prototype output buffers */
-      proto_data = (float *)malloc(sizeof(float)*PROTO_SIZE*batch_size); // 138x138x32
+      auto input_tensor = input_tensor_buffer[0]->get_tensor();
 
-      /* Allocate location data output buffer */
-      loc_data = (float *)malloc(sizeof(float)*NUM_PRIORS*4*batch_size);
-
-      /* Allocate confidence data output buffers */
-      conf_data = (float *)malloc(sizeof(float)*NUM_PRIORS*NUM_CLASSES*batch_size);
+      return create_host(input_tensor->get_shape().at(0),
+                         cv::Size(input_tensor->get_shape().at(2), input_tensor->get_shape().at(1)),
+                         get_fix_point(input_tensor));
+    }
+#endif
 
-      /* Allocate mask data output buffers */
-      mask_data = (float *)malloc(sizeof(float)*NUM_PRIORS*PROTO_C*batch_size);
+    /* Sets up the model constants without a model (used by create() & host-side tools), the
+     * input fix point is the fix_point attribute of the quantized input tensor.
+     */
+    int create_host( int batch, cv::Size input_dims, int input_fix_point )
+    {
+      batch_size = batch;
+      in_height  = input_dims.height;
+      in_width   = input_dims.width;
+      input_fixed_scale = std::exp2f(1.0f * (float)input_fix_point);
 
       /* Compute prior boxes */
-      prior_data = (box_t *)malloc(sizeof(box_t)*NUM_PRIORS*batch_size);
+      free(prior_data);
+      prior_data = (box_t *)malloc(sizeof(box_t)*NUM_PRIORS);
       create_priors(prior_data);
 
+      /* Allocate the frames used by run() */
+      work_frames.resize(batch_size);
+
       return batch_size;
     }
 
-    void run( std::vector<cv::Mat> &img,
-              float                 nms_conf_thresh,
-              float                 nms_thresh,
-              float                 score_thresh )
+    /* Sets the detection thresholds, negative values select the defaults */
+    void set_thresholds( float nms_conf_thresh,
+                         float nms_thresh )
     {
-      /* Save threshold values */
       l_nms_thresh = (nms_thresh < 0.0f) ? NMS_THRESH : nms_thresh;
       l_nms_conf_thresh = (nms_conf_thresh < 0.0f) ? NMS_CONF_THRESH : nms_conf_thresh;
+    }
 
-      /* Get the input/output tensor buffer handles */
-      auto l_runner = runner.get();
-      auto in_tensor_buff = l_runner->get_inputs();
-      auto out_tensor_buff = l_runner->get_outputs();
+    int get_batch_size() { return batch_size; }
+
+    /* Width & height of the input tensor */
+    cv::Size get_input_dims() { return cv::Size(in_width, in_height); }
+
+    /* Size of the quantized input tensor of one frame */
+    size_t get_input_size() { return in_height * in_width * 3; }
 
-      /* Process input data */
+#ifndef YOLACT_NO_VITIS
+    /* src_size optionally holds the original size of each image after a reduced decode, with source_size
+     * the annotated images are returned at that size (see create_overlays)
+     */
+    void run( std::vector<cv::Mat>         &img,
+              float                         nms_conf_thresh,
+              float                         nms_thresh,
+              float                         score_thresh,
+              const std::vector<cv::Size>  &src_size = std::vector<cv::Size>(),
+              bool                          source_size = false )
+    {
+      /* Save threshold values */
+      set_thresholds(nms_conf_thresh, nms_thresh);
+
+      /* Process input data, the last batch may be partial */
       int iter = 0;
       while (iter < img.size())
       {
-        std::vector<cv::Mat> img_buff;
-        for (int b = 0; b < batch_size; b++)
+        int count = std::min(batch_size, (int)img.size() - iter);
+        std::vector<frame_t*> frame_buff;
+        for (int b = 0; b < count; b++)
         {
-          img_buff.push_back(img[iter+b]);
+          work_frames[b].image = img[iter+b];
+          work_frames[b].src_size = (iter+b < (int)src_size.size()) ? src_size[iter+b] : cv::Size();
+          work_frames[b].seq = iter+b;
+          frame_buff.push_back(&work_frames[b]);
         }
 
         /* Pre-process the data */
         pre_timer.start();
-        preprocess(img_buff, in_tensor_buff);
-
-        /* Sync input tensor buffers */
-        for (auto& input : in_tensor_buff)
+        for (auto frame : frame_buff)
         {
-          input->sync_for_write(0, input->get_tensor()->get_data_size() / input->get_tensor()->get_shape()[0]);
+          preprocess(*frame);
         }
         pre_timer.stop();
 
         /* Execute the graph */
         exec_timer.start();
-        auto v = l_runner->execute_async(in_tensor_buff, out_tensor_buff);
-        auto status = l_runner->wait((int)v.first, -1);
-        CHECK_EQ(status, 0) << "failed to run the graph";
+        execute(frame_buff);
         exec_timer.stop();
 
-        /* Sync output tensor buffers */
+        /* Post-process that data */
         post_timer.start();
-        for (auto output : out_tensor_buff)
+        for (auto frame : frame_buff)
         {
-          output->sync_for_read(0, output->get_tensor()->get_data_size() / output->get_tensor()->get_shape()[0]);
+          postprocess(*frame);
         }
-
-        /* Post-process that data */
-        postprocess(out_tensor_buff);
         post_timer.stop();
 
         /* Create graphic overlays */
         overlay_timer.start();
-        create_overlays(img_buff, score_thresh);
-
-        for (int b = 0; b < batch_size; b++)
+        for (int b = 0; b < count; b++)
         {
-          img[iter+b] = img_buff[b];
+          create_overlays(work_frames[b], score_thresh, false, source_size);
+          img[iter+b] = work_frames[b].image;
         }
         overlay_timer.stop();
 
-        iter += batch_size;
+        iter += count;
+      }
+    }
+#endif
+
+    /* This function modified from
+     * Vitis-AI/demo/Vitis-AI-Library/samples/graph_runner/resnet50_graph_runner/resnet50_graph_runner.cpp
+     *
+     * Resizes & quantizes the frame image into the frame's input tensor.  Only reads model constants,
+     * so it may be called from any thread.
+     */
+    /* With resized set, frame.resized already holds the image at the input size */
+    void preprocess( frame_t &frame, bool resized = false )
+    {
+      trace_scope trace(TRACE_PREPROCESS, frame.seq);
+      perf_scope perf(PERF_PREPROCESS);
+      auto size = cv::Size(in_width, in_height);
+
+      /* Resize into the frame's buffer so recycled frames don't allocate */
+      const cv::Mat *resize_image = &frame.image;
+      if (resized)
+      {
+        resize_image = &frame.resized;
+      }
+      else if (size != frame.image.size())
+      {
+        cv::resize(frame.image, frame.resized, size);
+        resize_image = &frame.resized;
+      }
+
+      frame.input.resize(get_input_size());
+      set_input_image(*resize_image, (void*)frame.input.data(), input_fixed_scale);
+    }
+
+#ifndef YOLACT_NO_VITIS
+    /* Executes up to batch_size pre-processed frames on the DPU and copies the output tensors to
+     * the frames.  Uses the runner's tensor buffers, so a context must only execute one batch at a time.
+     * The unused slots of a partial batch are zeroed & their outputs are ignored.
+     */
+    void execute( std::vector<frame_t*> &frames )
+    {
+      /* Get the input/output tensor buffer handles */
+      auto l_runner = runner.get();
+      auto in_tensor_buff = l_runner->get_inputs();
+      auto out_tensor_buff = l_runner->get_outputs();
+
+      int64_t first_frame = frames.empty() ? -1 : (int64_t)frames[0]->seq;
+
+      /* Copy the input tensors */
+      {
+        trace_scope trace(TRACE_INPUT_COPY, first_frame, frames.size());
+        auto input_tensor = in_tensor_buff[0]->get_tensor();
+        for (int b = 0; b < frames.size(); b++)
+        {
+          uint64_t data_in = 0u;
+          size_t size_in = 0u;
+          auto idx = get_index_zeros(input_tensor);
+          idx[0] = b;
+          std::tie(data_in, size_in) = in_tensor_buff[0]->data(idx);
+          memcpy((void *)data_in, frames[b]->input.data(), frames[b]->input.size());
+        }
+
+        for (int b = frames.size(); b < batch_size; b++)
+        {
+          uint64_t data_in = 0u;
+          size_t size_in = 0u;
+          auto idx = get_index_zeros(input_tensor);
+          idx[0] = b;
+          std::tie(data_in, size_in) = in_tensor_buff[0]->data(idx);
+          memset((void *)data_in, 0, get_input_size());
+        }
+      }
+
+      /* Sync input tensor buffers */
+      {
+        trace_scope trace(TRACE_SYNC_FOR_WRITE, first_frame, frames.size());
+        for (auto& input : in_tensor_buff)
+        {
+          input->sync_for_write(0, input->get_tensor()->get_data_size() / input->get_tensor()->get_shape()[0]);
+        }
+      }
+
+      /* Execute the graph */
+      {
+        trace_scope trace(TRACE_EXECUTE, first_frame, frames.size());
+        auto v = l_runner->execute_async(in_tensor_buff, out_tensor_buff);
+        auto status = l_runner->wait((int)v.first, -1);
+        CHECK_EQ(status, 0) << "failed to run the graph";
+      }
+
+      /* Sync output tensor buffers */
+      {
+        trace_scope trace(TRACE_SYNC_FOR_READ, first_frame, frames.size());
+        for (auto output : out_tensor_buff)
+        {
+          output->sync_for_read(0, output->get_tensor()->get_data_size() / output->get_tensor()->get_shape()[0]);
+        }
+      }
+
+      /* Copy tensor output data to host memory */
+      trace_scope trace(TRACE_COPY, first_frame, frames.size());
+      copy_outputs(out_tensor_buff, frames);
+    }
+#endif
+
+    /* Runs detection on the output tensors of a frame.  Only reads model constants,
+     * so it may be called from any thread.
+     */
+    void postprocess( frame_t &frame )
+    {
+      trace_scope trace(TRACE_POSTPROCESS, frame.seq);
+      frame.boxes.clear();
+      frame.masks.clear();
+
+      detect( frame.loc.data(),
+              frame.conf.data(),
+              frame.mask.data(),
+              frame.boxes,
+              frame.masks );
+
+      // Sort the results based on score so colors look the same as running the model on dev. machine
+      sort_results(frame.boxes, frame.masks, 0, frame.boxes.size());
+    }
+
+    /* Draws the masks & boxes on the frame image.  With label_mask set, frame.label_mask is also
+     * filled with the 1-based index of the detection covering each pixel (0 = background).
+     *
+     * After a reduced decode the overlays are drawn at the decoded size, which the image keeps unless
+     * source_size is set; the label mask is always returned at the original size (frame.src_size).
+     */
+    void create_overlays( frame_t &frame, float score_thresh, bool label_mask = false, bool source_size = false )
+    {
+      trace_scope trace(TRACE_RENDER, frame.seq);
+      int num_det = frame.boxes.size();
+      cv::Mat *labels = nullptr;
+
+      if (label_mask)
+      {
+        frame.label_mask.create(frame.image.size(), CV_8UC1);
+        frame.label_mask.setTo(cv::Scalar(0));
+        labels = &frame.label_mask;
+      }
+
+      {
+        trace_scope trace_mask(TRACE_MASK, TRACE_CURRENT_FRAME);
+        perf_scope perf_mask(PERF_MASK);
+        draw_masks( frame.image, frame.boxes, frame.masks, 0, num_det, frame.proto.data(), score_thresh, labels );
+      }
+      trace_scope trace_overlay(TRACE_OVERLAY, TRACE_CURRENT_FRAME);
+      perf_scope perf_overlay(PERF_OVERLAY);
+      draw_boxes( frame.image, frame.boxes, 0, num_det, score_thresh );
+
+      /* Instance IDs are in the coordinates of box_to_source_rect, the full size image is opt-in */
+      if (!frame.image.empty() && !frame.src_size.empty() && frame.src_size != frame.image.size())
+      {
+        if (label_mask)
+        {
+          cv::resize(frame.label_mask, frame.label_mask, frame.src_size, 0, 0, cv::INTER_NEAREST);
+        }
+        if (source_size)
+        {
+          cv::resize(frame.image, frame.image, frame.src_size, 0, 0, cv::INTER_LINEAR);
+        }
       }
     }
 
@@ -183,49 +376,43 @@ class yolact
       std::cout << "Average post-processing time (CPU)       = " << time_str << " seconds" << std::endl;
       sprintf(time_str, "%1.3f", overlay_timer.avg_secs() / (float)batch_size);
       std::cout << "Average graphic overlay time (CPU)       = " << time_str << " seconds" << std::endl;
+
+      print_latency_header("Per batch");
+      print_latency_row("Pre-processing", pre_timer.histogram());
+      print_latency_row("Graph execution", exec_timer.histogram());
+      print_latency_row("Post-processing", post_timer.histogram());
+      print_latency_row("Graphic overlays", overlay_timer.histogram());
     }
 
   private:
 
-    /*************************************************************************
-     *  Data types                                                           *
-     *************************************************************************/
-    typedef struct
-    {
-      int   label;
-      float score;
-      float x;
-      float y;
-      float w;
-      float h;
-    } box_t;
+    /* Times the CPU kernels in isolation, see bench/kernel_bench.cpp */
+    friend class kernel_bench;
 
     /*************************************************************************
      * Local variables & constants                                           *
      *************************************************************************/
+#ifndef YOLACT_NO_VITIS
     std::unique_ptr<xir::Graph> graph;
     std::unique_ptr<xir::Attrs> attr;
     std::unique_ptr<vart::RunnerExt> runner;
-    float *loc_data;
-    float *conf_data;
-    float *mask_data;
-    float *proto_data;
+#endif
     box_t *prior_data;
-    std::map<int, std::vector<float>> decoded_bboxes;
-    std::map<int, std::vector<float>> masks;
-    std::vector<box_t> box_results;
-    std::vector<std::vector<float>> mask_results;
-    std::vector<int> batch_index;
+    std::vector<frame_t> work_frames;
     int batch_size;
+    int in_height;
+    int in_width;
+    float input_fixed_scale;
     float l_nms_conf_thresh;
     float l_nms_thresh;
 
-    lnx_timer pre_timer, exec_timer, post_timer, overlay_timer;
+    latency_timer pre_timer, exec_timer, post_timer, overlay_timer;
 
     /*************************************************************************
      * Functions                                                             *
      *************************************************************************/
 
+#ifndef YOLACT_NO_VITIS
     /* This function taken from
      * Vitis-AI/demo/Vitis-AI-Library/samples/graph_runner/resnet50_graph_runner/resnet50_graph_runner.cpp
      */
@@ -246,6 +433,7 @@ class yolact
       std::fill(ret.begin(), ret.end(), 0);
       return ret;
     }
+#endif
 
     /* Create prior boxes */
     void create_priors(box_t *prior_data)
@@ -291,44 +479,6 @@ class yolact
 
     }
 
-    /* This function modified from
-     * Vitis-AI/demo/Vitis-AI-Library/samples/graph_runner/resnet50_graph_runner/resnet50_graph_runner.cpp
-     */
-    void preprocess( std::vector<cv::Mat>             &img,
-                     std::vector<vart::TensorBuffer*> &input_tensor_buffers)
-    {
-      auto input_tensor = input_tensor_buffers[0]->get_tensor();
-      auto batch = input_tensor->get_shape().at(0);
-      auto height = input_tensor->get_shape().at(1);
-      auto width = input_tensor->get_shape().at(2);
-
-      int fixpos = get_fix_point(input_tensor);
-      float input_fixed_scale = std::exp2f(1.0f * (float)fixpos);
-
-      auto size = cv::Size(width, height);
-
-      for (int index = 0; index < batch; ++index)
-      {
-        cv::Mat resize_image;
-        cv::Mat frame = img[index];
-        if (size != frame.size())
-        {
-          cv::resize(frame, resize_image, size);
-        }
-        else
-        {
-          frame.copyTo(resize_image);
-        }
-
-        uint64_t data_in = 0u;
-        size_t size_in = 0u;
-        auto idx = get_index_zeros(input_tensor);
-        idx[0] = (int)index;
-        std::tie(data_in, size_in) = input_tensor_buffers[0]->data(idx);
-        set_input_image(resize_image, (void*)data_in, input_fixed_scale);
-      }
-    }
-
     /* This function modified from
      * Vitis-AI/demo/Vitis-AI-Library/samples/graph_runner/resnet50_graph_runner/resnet50_graph_runner.cpp
      * The mean & scale values are taken from yolact/data/config.py and are slightly different
@@ -464,7 +614,8 @@ class yolact
                      int                              batch_start,
                      int                              batch_end,
                      float                           *proto_data,
-                     float                            score_thresh )
+                     float                            score_thresh,
+                     cv::Mat                         *labels = nullptr )
     {
       int c_idx = 0;
 
@@ -523,6 +674,8 @@ class yolact
               {
                 img.at<cv::Vec3b>(h,w)[c] = img.at<cv::Vec3b>(h,w)[c] * MASK_ALPHA + color[c] * (1.0f - MASK_ALPHA);
               }
+
+              if (labels) labels->at<uchar>(h,w) = (uchar)std::min(i - batch_start + 1, 255);
             }
           }
         }
@@ -573,8 +726,9 @@ class yolact
     }
 
     // This function modified from Vitis-AI/tools/Vitis-AI-Library/xnnpp/src/ssd/ssd_detector.cpp
-    void decode_bbox( float *bbox_ptr,
-                      int    idx )
+    void decode_bbox( float                              *bbox_ptr,
+                      int                                 idx,
+                      std::map<int, std::vector<float>>  &decoded_bboxes )
     {
       const float var[2] = {0.1f, 0.2f};
       std::vector<float> bbox(4);
@@ -650,11 +804,13 @@ class yolact
     }
 
     // This function modified from Vitis-AI/tools/Vitis-AI-Library/xnnpp/src/ssd/ssd_detector.cpp
-    void apply_one_class_nms( float                           *loc_data,
-                              float                           *mask_data,
-                              int                              label,
-                              std::vector<pair<float, int>>   &score_index_vec,
-                              std::vector<int>                *indices )
+    void apply_one_class_nms( float                              *loc_data,
+                              float                              *mask_data,
+                              int                                 label,
+                              std::vector<pair<float, int>>      &score_index_vec,
+                              std::vector<int>                   *indices,
+                              std::map<int, std::vector<float>>  &decoded_bboxes,
+                              std::map<int, std::vector<float>>  &masks )
     {
       std::vector<size_t>        results;
       std::vector<vector<float>> boxes;
@@ -673,7 +829,7 @@ class yolact
         {
           if ( idx < NUM_PRIORS )
           {
-            decode_bbox( &loc_data[idx*4], idx );
+            decode_bbox( &loc_data[idx*4], idx, decoded_bboxes );
 
             for (int c = 0; c < PROTO_C; c++)
             {
@@ -702,28 +858,30 @@ class yolact
     void detect( float                           *loc_data,
                  float                           *conf_data,
                  float                           *mask_data,
-                 box_t                           *prior_data,
-                 float                           *proto_data,
                  std::vector<box_t>               &box_result,
-                 std::vector<std::vector<float>>  &mask_result,
-                 std::vector<int>                 &batch_index )
+                 std::vector<std::vector<float>>  &mask_result )
     {
-
-      decoded_bboxes.clear();
-      masks.clear();
+      std::map<int, std::vector<float>> decoded_bboxes;
+      std::map<int, std::vector<float>> masks;
 
       int num_det = 0;
       vector<vector<int>> indices(NUM_CLASSES);
       vector<vector<pair<float, int>>> score_index_vec(NUM_CLASSES);
 
       // Get top_k scores (with corresponding indices).
-      get_multi_class_max_score_index(conf_data, 1, NUM_CLASSES-1, score_index_vec);
+      {
+        trace_scope trace(TRACE_SCAN, TRACE_CURRENT_FRAME);
+        perf_scope perf(PERF_SCAN);
+        get_multi_class_max_score_index(conf_data, 1, NUM_CLASSES-1, score_index_vec);
+      }
 
       // Skip the background class by starting at 1 instead of 0
+      trace_scope trace(TRACE_NMS, TRACE_CURRENT_FRAME);
+      perf_scope perf(PERF_NMS);
       for (int c = 1; c < NUM_CLASSES; c++)
       {
         // Perform NMS for one class
-        apply_one_class_nms( loc_data, mask_data, c, score_index_vec[c], &(indices[c]) );
+        apply_one_class_nms( loc_data, mask_data, c, score_index_vec[c], &(indices[c]), decoded_bboxes, masks );
         num_det += indices[c].size();
       }
 
@@ -759,16 +917,6 @@ class yolact
         }
       }
 
-      int b_idx = 0;
-      if (batch_index.empty())
-      {
-        batch_index.push_back(b_idx);
-      }
-      else
-      {
-        b_idx = batch_index.back();
-      }
-
       for (auto label = 1u; label < indices.size(); ++label)
       {
         for (auto idx : indices[label])
@@ -785,98 +933,76 @@ class yolact
           box_res.h = bbox[3];
           box_result.emplace_back(box_res);
           mask_result.emplace_back(mask);
-          b_idx++;
         }
       }
-      batch_index.push_back(b_idx);
-    }
-
-    /* Copies data from tensor output buffer to host memory */
-    void copy_data( float *input,
-                    float *output,
-                    size_t size,
-                    int    batch,
-                    int    elements,
-                    int    channels )
-    {
-      int offset = 0;
-      for (int i = 0; i < batch; i++)
-      {
-        memcpy( &output[offset], &input[i*elements], size );
-        offset += (NUM_PRIORS * channels);
-      }
     }
 
-    void postprocess( const std::vector<vart::TensorBuffer*>& output_tensor_buffer )
+#ifndef YOLACT_NO_VITIS
+    /* Copies the output tensors of a batch to the host buffers of its frames */
+    void copy_outputs( const std::vector<vart::TensorBuffer*> &output_tensor_buffer,
+                       std::vector<frame_t*>                  &frames )
     {
       uint64_t data_out = 0;
       size_t size_out = 0;
-      int batch = 1;
 
-      /* Copy tensor output data to host memory */
       for (auto &tensor_buffer : output_tensor_buffer)
       {
         auto output_tensor = tensor_buffer->get_tensor();
-        std::string tensor_name = output_tensor->get_name();
         auto idx = get_index_zeros(output_tensor);
         idx[0] = 0;
         std::tie(data_out, size_out) = tensor_buffer->data(idx);
         auto shape = output_tensor->get_shape();
-        batch = shape.front();
+        int batch = shape.front();
         int num_elements = output_tensor->get_element_num() / batch;
-        int num_channels = shape.back();
         size_out /= batch;
 
-        /* Prototype output */
-        if (shape[2] == PROTO_HW) // Prototype output
+        for (int b = 0; b < frames.size(); b++)
         {
-          memcpy(proto_data, (float *)data_out, size_out*batch);
+          std::vector<float> *host_data;
 
-#ifdef SHOW_PROTO_IMAGES
-          show_prototypes(proto_data);
-#endif
+          /* Prototype output */
+          if (shape[2] == PROTO_HW)
+          {
+            host_data = &frames[b]->proto;
+          }
 
-#ifdef DUMP_PROTO_DATA
-          dump_prototypes(proto_data);
-#endif
-        }
+          /* Mask data */
+          else if (shape[2] == PROTO_C)
+          {
+            host_data = &frames[b]->mask;
+          }
 
-        /* Copy mask data to host memory */
-        else if (shape[2] == PROTO_C)
-        {
-          copy_data( (float *)data_out, mask_data, size_out, batch, num_elements, num_channels );
-        }
+          /* Confidence data */
+          else if (shape[2] == NUM_CLASSES)
+          {
+            host_data = &frames[b]->conf;
+          }
 
-        /* Copy confidence data to host memory */
-        else if (shape[2] == NUM_CLASSES)
-        {
-          copy_data( (float *)data_out, conf_data, size_out, batch, num_elements, num_channels );
-        }
+          /* Location data */
+          else if (shape[2] == 4)
+          {
+            host_data = &frames[b]->loc;
+          }
 
-        /* Copy location data to host memory */
-        else if (shape[2] == 4)
-        {
-          copy_data( (float *)data_out, loc_data, size_out, batch, num_elements, num_channels );
+          else
+          {
+            continue;
+          }
+
+          host_data->resize(num_elements);
+          memcpy(host_data->data(), &((float *)data_out)[b*num_elements], size_out);
         }
-      }
 
-      /* Process detections */
-      box_results.clear();
-      mask_results.clear();
-      batch_index.clear();
-
-      for (int b = 0; b < batch; b++)
-      {
-        detect( &loc_data[NUM_PRIORS*4*b],
-                &conf_data[NUM_PRIORS*NUM_CLASSES*b],
-                &mask_data[NUM_PRIORS*PROTO_C*b],
-                &prior_data[NUM_PRIORS*4*b],
-                &proto_data[PROTO_SIZE*b],
-                 box_results,
-                 mask_results,
-                 batch_index );
+#ifdef SHOW_PROTO_IMAGES
+        if (shape[2] == PROTO_HW) show_prototypes(frames[0]->proto.data());
+#endif
+
+#ifdef DUMP_PROTO_DATA
+        if (shape[2] == PROTO_HW) dump_prototypes(frames[0]->proto.data());
+#endif
       }
     }
+#endif
 
     /* Mask & box color look-up */
     cv::Scalar get_color(int label)
@@ -893,20 +1019,6 @@ class yolact
       return colors[(label*5)%19];
     }
 
-    void create_overlays( std::vector<cv::Mat> &img, float score_thresh )
-    {
-      /* Draw output image overlay */
-      for (int i = 0; i < img.size(); i++)
-      {
-        int batch_start = batch_index[i];
-        int batch_end   = batch_index[i+1];
-
-        // Sort the results based on score so colors look the same as running the model on dev. machine
-        sort_results(box_results, mask_results, batch_start, batch_end);
-
-        draw_masks( img[i], box_results, mask_results, batch_start, batch_end, &proto_data[PROTO_SIZE*i], score_thresh );
-        draw_boxes( img[i], box_results, batch_start, batch_end, score_thresh );
-      }
-    }
-
 };
+
+#endif
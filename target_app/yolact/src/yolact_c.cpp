@@ -0,0 +1,294 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * C interface of the staged pipeline, built as libyolact.so (see yolact_c.h)
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "yolact_c.h"
+#include "yolact.hpp"
+#include "pipeline.hpp"
+#include "source.hpp"
+
+#define YOLACT_EXPORT extern "C" __attribute__((visibility("default")))
+
+/* A submitted frame waiting for the pipeline */
+typedef struct
+{
+  const void *pixels;
+  int         width;
+  int         height;
+  size_t      stride;
+  int         format;
+  uint64_t    tag;
+  uint64_t    submit_ns;
+} submission_t;
+
+/*
+ * Pipeline source fed by yolact_submit().  The borrowed pixels are attached
+ * to the frames as zero-copy views and handed back to the caller through the
+ * release callback by release_raw().
+ */
+class submit_source : public frame_source
+{
+  public:
+
+    submit_source( int queue_depth, yolact_release_fn release, void *user ) : queue(queue_depth), release(release),
+                                                                              user(user), next_seq(0) {}
+
+    bool submit( const submission_t &sub ) { return queue.push(sub); }
+
+    void close() { queue.close(); }
+
+    bool read( frame_t &frame )
+    {
+      submission_t sub;
+      if (!queue.pop(sub)) return false;
+
+      static const int raw_formats[] = { RAW_BGR, RAW_RGB, RAW_GRAY, RAW_NV12, RAW_I420, RAW_YUYV };
+      static const int types[] = { CV_8UC3, CV_8UC3, CV_8UC1, CV_8UC1, CV_8UC1, CV_8UC2 };
+      bool planar = (sub.format == YOLACT_FMT_NV12 || sub.format == YOLACT_FMT_I420);
+
+      frame.raw = cv::Mat(planar ? sub.height + sub.height / 2 : sub.height, sub.width, types[sub.format],
+                          (void *)sub.pixels, sub.stride);
+      frame.raw_format = raw_formats[sub.format];
+      frame.raw_source = this;
+      frame.raw_tag = sub.tag;
+      frame.src_size = cv::Size(sub.width, sub.height);
+
+      std::lock_guard<std::mutex> lock(mtx);
+      frame.seq = next_seq++;
+      inflight[frame.seq] = sub;
+      return true;
+    }
+
+    bool release_raw( frame_t &frame )
+    {
+      if (release) release(frame.raw.data, frame.raw_tag, user);
+      return true;
+    }
+
+    /* Removes the submission of a completed frame */
+    submission_t complete( const frame_t &frame )
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      auto it = inflight.find(frame.seq);
+      submission_t sub = it->second;
+      inflight.erase(it);
+      return sub;
+    }
+
+  private:
+
+    bounded_queue<submission_t>      queue;
+    yolact_release_fn                release;
+    void                            *user;
+    std::mutex                       mtx;
+    uint64_t                         next_seq;
+    std::map<uint64_t, submission_t> inflight;
+};
+
+struct yolact_context
+{
+  std::unique_ptr<yolact[]>      models;
+  pipeline_config_t              config;
+  std::unique_ptr<submit_source> source;
+  std::unique_ptr<pipeline>      pipe;
+  std::thread                    thread;
+
+  yolact_result_fn               result;
+  void                          *user;
+  int                            outputs;
+  float                          score_thresh;
+
+  std::mutex                     mtx;
+  std::condition_variable        done;
+  uint64_t                       submitted = 0;
+  uint64_t                       delivered = 0;
+  bool                           closing = false;
+
+  /* Pipeline sink: reports the detections above the score threshold, which are a prefix of the sorted boxes */
+  void deliver( frame_t &frame )
+  {
+    submission_t sub = source->complete(frame);
+    std::vector<yolact_detection_t> detections;
+
+    for (auto &box : frame.boxes)
+    {
+      if (box.score < score_thresh) break;
+
+      cv::Rect rect = box_to_source_rect(frame, box);
+      detections.push_back(yolact_detection_t{ box.label, coco_labels[box.label].c_str(), box.score,
+                                               rect.x, rect.y, rect.width, rect.height });
+    }
+
+    yolact_result_t res = {};
+    res.tag = sub.tag;
+    res.width = sub.width;
+    res.height = sub.height;
+    res.num_detections = (int)detections.size();
+    res.detections = detections.data();
+    if (outputs & YOLACT_WANT_ANNOTATED)
+    {
+      res.annotated = frame.image.data;
+      res.annotated_stride = frame.image.step;
+    }
+    if ((outputs & YOLACT_WANT_IDS) && !frame.label_mask.empty())
+    {
+      res.instance_ids = frame.label_mask.data;
+      res.ids_stride = frame.label_mask.step;
+    }
+    res.latency_ms = (float)(frame_clock_ns() - sub.submit_ns) * 1e-6f;
+
+    if (result) result(&res, user);
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      delivered++;
+    }
+    done.notify_all();
+  }
+};
+
+YOLACT_EXPORT void yolact_default_options( yolact_options_t *options )
+{
+  options->model = "model/yolact.xmodel";
+  options->threads = 1;
+  options->score_thresh = 0.3f;
+  options->nms_conf_thresh = -1.0f;
+  options->nms_thresh = -1.0f;
+  options->queue_depth = 4;
+  options->outputs = 0;
+}
+
+YOLACT_EXPORT yolact_context_t *yolact_create( const yolact_options_t *options,
+                                               yolact_result_fn        result,
+                                               yolact_release_fn       release,
+                                               void                   *user )
+{
+  yolact_options_t opt;
+  yolact_default_options(&opt);
+  if (options) opt = *options;
+
+  /* The model loader aborts on a missing file, so check it first */
+  if (opt.model == nullptr || access(opt.model, R_OK) != 0 || opt.threads < 1 || opt.queue_depth < 1) return nullptr;
+
+  yolact_context_t *ctx = new yolact_context_t();
+  ctx->result = result;
+  ctx->user = user;
+  ctx->outputs = opt.outputs;
+  ctx->score_thresh = opt.score_thresh;
+
+  ctx->models.reset(new yolact[opt.threads]);
+  for (int t = 0; t < opt.threads; t++)
+  {
+    ctx->models[t].create(opt.model);
+    ctx->models[t].set_thresholds(opt.nms_conf_thresh, opt.nms_thresh);
+  }
+
+  pipeline_default_config(ctx->config);
+  ctx->config.workers[STAGE_INFER] = opt.threads;
+  ctx->config.score_thresh = opt.score_thresh;
+  ctx->config.label_masks = (opt.outputs & YOLACT_WANT_IDS) != 0;
+  ctx->config.render = (opt.outputs & (YOLACT_WANT_ANNOTATED | YOLACT_WANT_IDS)) != 0;
+  ctx->config.batch_timeout_ms = 1.0f;
+
+  ctx->source.reset(new submit_source(opt.queue_depth, release, user));
+  ctx->pipe.reset(new pipeline(ctx->models.get(), ctx->config));
+  ctx->thread = std::thread([ctx]
+  {
+    ctx->pipe->run([ctx](frame_t &frame) { return ctx->source->read(frame); },
+                   [ctx](frame_t &frame) { ctx->deliver(frame); });
+  });
+
+  return ctx;
+}
+
+YOLACT_EXPORT int yolact_submit( yolact_context_t *ctx,
+                                 const void       *pixels,
+                                 int               width,
+                                 int               height,
+                                 size_t            stride,
+                                 yolact_format_t   format,
+                                 uint64_t          tag )
+{
+  static const int bytes_per_pixel[] = { 3, 3, 1, 1, 1, 2 };
+
+  if (ctx == nullptr || pixels == nullptr || width <= 0 || height <= 0 ||
+      format < YOLACT_FMT_BGR24 || format > YOLACT_FMT_YUYV || stride < (size_t)width * bytes_per_pixel[format])
+  {
+    return YOLACT_EINVAL;
+  }
+  if ((format == YOLACT_FMT_NV12 || format == YOLACT_FMT_I420 || format == YOLACT_FMT_YUYV) && (width % 2 != 0))
+  {
+    return YOLACT_EINVAL;
+  }
+  if ((format == YOLACT_FMT_NV12 || format == YOLACT_FMT_I420) && (height % 2 != 0))
+  {
+    return YOLACT_EINVAL;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(ctx->mtx);
+    if (ctx->closing) return YOLACT_ECLOSED;
+    ctx->submitted++;
+  }
+
+  submission_t sub = { pixels, width, height, stride, (int)format, tag, frame_clock_ns() };
+  if (!ctx->source->submit(sub))
+  {
+    std::lock_guard<std::mutex> lock(ctx->mtx);
+    ctx->submitted--;
+    return YOLACT_ECLOSED;
+  }
+  return YOLACT_OK;
+}
+
+YOLACT_EXPORT int yolact_flush( yolact_context_t *ctx )
+{
+  if (ctx == nullptr) return YOLACT_EINVAL;
+
+  std::unique_lock<std::mutex> lock(ctx->mtx);
+  uint64_t target = ctx->submitted;
+  ctx->done.wait(lock, [ctx, target] { return ctx->delivered >= target; });
+  return YOLACT_OK;
+}
+
+YOLACT_EXPORT void yolact_destroy( yolact_context_t *ctx )
+{
+  if (ctx == nullptr) return;
+
+  {
+    std::lock_guard<std::mutex> lock(ctx->mtx);
+    ctx->closing = true;
+  }
+
+  /* The pipeline drains the queued frames & stops at the end of the input */
+  ctx->source->close();
+  ctx->thread.join();
+  delete ctx;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _YOLACT_C_H_
+#define _YOLACT_C_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * C interface of libyolact.so
+ *
+ * A context owns the model contexts and a running pipeline.  Frames are
+ * submitted as borrowed pixel buffers: the library reads them in place and
+ * calls the release callback once it no longer needs the pixels (right
+ * after the preprocess stage converted them), from then on the caller may
+ * reuse or free the buffer.  Every submitted frame produces exactly one call
+ * of the result callback with the caller's tag.  The callbacks run on the
+ * pipeline threads; everything a yolact_result_t points to is owned by the
+ * library and only valid until the result callback returns.
+ *
+ * Functions return YOLACT_OK or a negative YOLACT_E* code.  A context may be
+ * used from any number of threads; yolact_destroy() must not race with other
+ * calls on the same context.
+ */
+
+#define YOLACT_OK             0
+#define YOLACT_EINVAL        -1   /* Invalid argument */
+#define YOLACT_ECLOSED       -2   /* The context is being destroyed */
+
+/* Pixel formats of submitted frames */
+typedef enum
+{
+  YOLACT_FMT_BGR24 = 0,   /* Packed B, G, R */
+  YOLACT_FMT_RGB24,       /* Packed R, G, B */
+  YOLACT_FMT_GRAY8,       /* Luma only */
+  YOLACT_FMT_NV12,        /* Y plane followed by the interleaved UV plane, both with the same stride */
+  YOLACT_FMT_I420,        /* Y plane followed by the U & V planes, stored as height/2 rows of the same stride */
+  YOLACT_FMT_YUYV         /* Packed 4:2:2 Y0 U Y1 V */
+} yolact_format_t;
+
+/* Optional outputs of yolact_result_t */
+#define YOLACT_WANT_ANNOTATED  0x1   /* BGR24 frame with masks, boxes & labels drawn */
+#define YOLACT_WANT_IDS        0x2   /* 8-bit instance-ID map */
+
+typedef struct
+{
+  const char *model;          /* xmodel file (default "model/yolact.xmodel") */
+  int         threads;        /* DPU model contexts (default 1) */
+  float       score_thresh;   /* Detections below this score are not reported (default 0.3) */
+  float       nms_conf_thresh;/* < 0 = model default */
+  float       nms_thresh;     /* < 0 = model default */
+  int         queue_depth;    /* Frames queued between submit & the pipeline (default 4) */
+  int         outputs;        /* YOLACT_WANT_* flags (default 0 = detections only) */
+} yolact_options_t;
+
+typedef struct
+{
+  int         label;          /* COCO class index */
+  const char *name;           /* COCO class name, static storage */
+  float       score;
+  int         x, y;           /* Box in pixels of the submitted frame */
+  int         width, height;
+} yolact_detection_t;
+
+typedef struct
+{
+  uint64_t                  tag;            /* Tag given to yolact_submit() */
+  int                       width, height;  /* Size of the submitted frame */
+  int                       num_detections;
+  const yolact_detection_t *detections;     /* Sorted by score */
+  const uint8_t            *annotated;      /* YOLACT_WANT_ANNOTATED, otherwise NULL */
+  size_t                    annotated_stride;
+  const uint8_t            *instance_ids;   /* YOLACT_WANT_IDS: pixel = index in detections + 1, 0 = background */
+  size_t                    ids_stride;
+  float                     latency_ms;     /* From yolact_submit() to the result */
+} yolact_result_t;
+
+typedef struct yolact_context yolact_context_t;
+
+/* Called once per frame with its results, on a pipeline thread */
+typedef void (*yolact_result_fn)( const yolact_result_t *result, void *user );
+
+/* Called once per frame when the library is done with its pixels, on a pipeline thread */
+typedef void (*yolact_release_fn)( const void *pixels, uint64_t tag, void *user );
+
+/* Fills options with the defaults */
+void yolact_default_options( yolact_options_t *options );
+
+/* Loads the model & starts the pipeline, returns NULL on failure.  release may be NULL. */
+yolact_context_t *yolact_create( const yolact_options_t *options,
+                                 yolact_result_fn        result,
+                                 yolact_release_fn       release,
+                                 void                   *user );
+
+/* Submits a frame of the given format, stride = bytes per row (of the Y plane for the YUV formats).
+ * The pixels stay borrowed until the release callback.  Blocks while the submit queue is full.
+ */
+int yolact_submit( yolact_context_t *ctx,
+                   const void       *pixels,
+                   int               width,
+                   int               height,
+                   size_t            stride,
+                   yolact_format_t   format,
+                   uint64_t          tag );
+
+/* Waits until the results of all frames submitted so far have been delivered */
+int yolact_flush( yolact_context_t *ctx );
+
+/* Finishes the submitted frames, stops the pipeline & frees the context */
+void yolact_destroy( yolact_context_t *ctx );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * Copyright 2019 Xilinx Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Command line client of the inference daemon (yolact.exe --daemon)
+ *
+ * Sends images to the daemon and prints the detections.  Only depends on the
+ * C++ standard library & POSIX, build with build.sh or:
+ *   g++ -std=c++17 -O3 -Isrc src/yolact_client.cpp -o yolact_client.exe
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "coco_labels.hpp"
+#include "daemon_protocol.hpp"
+
+void print_usage()
+{
+  cout << "Usage: ./yolact_client.exe [options] --image <image-file> [--image <image-file> ...]" << endl;
+  cout << "       ./yolact_client.exe [options] --raw <bgr-file> WxH" << endl;
+  cout << "       ./yolact_client.exe [options] --shm <shm-name> WxH" << endl;
+  cout << endl;
+  cout << "  options:" << endl;
+
+  cout << "  --socket <socket-path>" << endl;
+  cout << "      Socket of the daemon (default = " << DAEMON_DEFAULT_SOCKET << ")" << endl;
+
+  cout << "  --image <image-file>" << endl;
+  cout << "      Image file decoded by the daemon, can be repeated" << endl;
+
+  cout << "  --raw <bgr-file> WxH" << endl;
+  cout << "      Raw BGR8 frame of WxH pixels, the file descriptor is passed to the daemon" << endl;
+
+  cout << "  --shm <shm-name> WxH" << endl;
+  cout << "      Raw BGR8 frame of WxH pixels in a POSIX shared memory object (e.g. /frame0)" << endl;
+
+  cout << "  --score_thresh N" << endl;
+  cout << "      Only returns detections scoring at least N (default = 0.5)" << endl;
+
+  cout << "  --json" << endl;
+  cout << "      Prints the JSON result of the daemon instead of the binary result" << endl;
+
+  cout << "  --repeat N" << endl;
+  cout << "      Sends every request N times over the same connection & reports the round-trip times" << endl;
+  cout << endl;
+}
+
+typedef struct
+{
+  daemon_request_t req;
+  string           payload;   // Image path or shm name
+  string           raw_file;  // Raw frame file passed as a file descriptor
+} job_t;
+
+static uint64_t now_ns()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+static bool parse_size( const char *arg, daemon_request_t &req )
+{
+  return sscanf(arg, "%ux%u", &req.width, &req.height) == 2 && req.width > 0 && req.height > 0;
+}
+
+static void print_detections( const daemon_response_t &resp, const string &payload )
+{
+  const daemon_detection_t *det = (const daemon_detection_t *)payload.data();
+  char line[128];
+
+  for (uint32_t d = 0; d < resp.count; d++)
+  {
+    sprintf(line, "  %-16s %6.3f  x %5d  y %5d  w %5d  h %5d",
+            (det[d].label >= 0 && det[d].label < 81) ? coco_labels[det[d].label].c_str() : "?",
+            det[d].score, det[d].x, det[d].y, det[d].w, det[d].h);
+    cout << line << endl;
+  }
+}
+
+int main( int argc, char *argv[] )
+{
+  string socket_path = DAEMON_DEFAULT_SOCKET;
+  vector<job_t> jobs;
+  float score_thresh = 0.5f;
+  uint32_t format = RESULT_BINARY;
+  int repeat = 1;
+
+  for (int i = 1; i < argc; i++)
+  {
+    job_t job;
+    memset(&job.req, 0, sizeof(job.req));
+
+    if (!strcmp(argv[i], "--socket") && i+1 < argc)
+    {
+      socket_path = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--image") && i+1 < argc)
+    {
+      /* The daemon may run in another directory */
+      char path[PATH_MAX];
+      if (realpath(argv[i+1], path) == nullptr)
+      {
+        cout << "ERROR: input file " << argv[i+1] << " does not exist" << endl;
+        return -1;
+      }
+
+      job.req.type = REQ_IMAGE_PATH;
+      job.payload = path;
+      jobs.push_back(job);
+      i++;
+    }
+    else if ((!strcmp(argv[i], "--raw") || !strcmp(argv[i], "--shm")) && i+2 < argc)
+    {
+      if (!parse_size(argv[i+2], job.req))
+      {
+        cout << "ERROR: please provide the frame size as WxH, e.g. 1280x720" << endl;
+        return -1;
+      }
+
+      if (!strcmp(argv[i], "--raw"))
+      {
+        job.req.type = REQ_RAW_FD;
+        job.raw_file = argv[i+1];
+      }
+      else
+      {
+        job.req.type = REQ_SHM;
+        job.payload = argv[i+1];
+      }
+      jobs.push_back(job);
+      i += 2;
+    }
+    else if (!strcmp(argv[i], "--score_thresh") && i+1 < argc)
+    {
+      score_thresh = atof(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--json"))
+    {
+      format = RESULT_JSON;
+    }
+    else if (!strcmp(argv[i], "--repeat") && i+1 < argc)
+    {
+      repeat = std::max(atoi(argv[++i]), 1);
+    }
+    else
+    {
+      print_usage();
+      return -1;
+    }
+  }
+
+  if (jobs.empty())
+  {
+    print_usage();
+    return -1;
+  }
+
+  int sock = daemon_connect(socket_path);
+  if (sock < 0)
+  {
+    cout << "ERROR: no daemon is serving " << socket_path << " (start it with yolact.exe --daemon)" << endl;
+    return -1;
+  }
+
+  for (auto &job : jobs)
+  {
+    const string &name = job.raw_file.empty() ? job.payload : job.raw_file;
+    vector<uint64_t> round_trip;
+
+    job.req.format = format;
+    job.req.score_thresh = score_thresh;
+
+    int fd = -1;
+    if (!job.raw_file.empty() && (fd = open(job.raw_file.c_str(), O_RDONLY | O_CLOEXEC)) < 0)
+    {
+      cout << "ERROR: unable to open " << job.raw_file << endl;
+      return -1;
+    }
+
+    daemon_response_t resp;
+    string payload;
+    for (int r = 0; r < repeat; r++)
+    {
+      uint64_t t0 = now_ns();
+      if (!daemon_send_request(sock, job.req, job.payload, fd) || !daemon_recv_response(sock, resp, payload))
+      {
+        cout << "ERROR: connection to the daemon was lost" << endl;
+        return -1;
+      }
+      round_trip.push_back(now_ns() - t0);
+    }
+    if (fd >= 0) close(fd);
+
+    if (resp.status != STATUS_OK)
+    {
+      static const char *status_names[] = { "ok", "bad request", "input can not be read", "daemon is shutting down" };
+      cout << name << ": ERROR: " << ((resp.status <= STATUS_SHUTTING_DOWN) ? status_names[resp.status] : "unknown")
+           << endl;
+      continue;
+    }
+
+    if (format == RESULT_JSON)
+    {
+      cout << payload << endl;
+    }
+    else
+    {
+      cout << name << ": " << resp.count << ((resp.count == 1) ? " detection" : " detections") << endl;
+      print_detections(resp, payload);
+    }
+
+    if (repeat > 1)
+    {
+      char line[160];
+      sort(round_trip.begin(), round_trip.end());
+      size_t n = round_trip.size();
+      sprintf(line, "Round trip over %zu requests: p50 %.2f ms, p99 %.2f ms, daemon service time %.2f ms (last)",
+              n, round_trip[n * 50 / 100] * 1e-6, round_trip[n * 99 / 100] * 1e-6, resp.server_ns * 1e-6);
+      cout << line << endl;
+    }
+  }
+
+  close(sock);
+  return 0;
+}